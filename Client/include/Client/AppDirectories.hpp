@@ -26,6 +26,7 @@ public:
 		MatchesDir = (AppDir / "Matches").make_preferred();
 		ScreenshotsDir = (AppDir / "Screenshots").make_preferred();
 		ReplayVersionsDir = (AppDir / "ReplayVersions").make_preferred();
+		ReplayCacheDir = (AppDir / "ReplayCache").make_preferred();
 		ConfigFile = (AppDir / "config.json").make_preferred();
 		LogFile = (AppDir / fmt::format("{}.log", AppName)).make_preferred();
 		DatabaseFile = (MatchesDir / "match_history.db").make_preferred();
@@ -33,6 +34,7 @@ public:
 		CreateAppDir(MatchesDir);
 		CreateAppDir(ScreenshotsDir);
 		CreateAppDir(ReplayVersionsDir);
+		CreateAppDir(ReplayCacheDir);
 	}
 
 	std::string_view AppName;
@@ -41,6 +43,7 @@ public:
 	std::filesystem::path MatchesDir;
 	std::filesystem::path ScreenshotsDir;
 	std::filesystem::path ReplayVersionsDir;
+	std::filesystem::path ReplayCacheDir;
 	std::filesystem::path ConfigFile;
 	std::filesystem::path LogFile;
 	std::filesystem::path DatabaseFile;
@@ -9,7 +9,11 @@
 #include "ReplayParser/ReplayParser.hpp"
 
 #include <expected>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <vector>
 
 
 using PotatoAlert::Core::Result;
@@ -91,12 +95,16 @@ public:
 	[[nodiscard]] SqlResult<std::optional<std::string>> GetMatchJson(std::string_view hash) const;
 	[[nodiscard]] SqlResult<void> SetMatchReplaySummary(uint32_t id, const ReplaySummary& replaySummary) const;
 	[[nodiscard]] SqlResult<void> SetMatchReplaySummary(std::string_view hash, const ReplaySummary& replaySummary) const;
+	// sets all summaries in a single transaction, returns the id of the match of each summary if there is one
+	[[nodiscard]] SqlResult<std::vector<std::optional<uint32_t>>> SetMatchReplaySummaries(std::span<const ReplaySummary> replaySummaries) const;
 	[[nodiscard]] SqlResult<bool> MatchExists(uint32_t id) const;
 	[[nodiscard]] SqlResult<bool> MatchExists(std::string_view hash) const;
 
 private:
 	static constexpr Version m_currentVersion = Version(1, 0);
 	Core::SQLite& m_db;
+	// the connection is shared by every thread, this keeps statements of different threads out of each other's transactions
+	mutable std::recursive_mutex m_mutex;
 	static constexpr std::string_view matchTable = "matches";
 };
 
@@ -4,17 +4,29 @@
 #include "Client/ServiceProvider.hpp"
 
 #include "Core/ThreadPool.hpp"
+#include "Core/TimerWheel.hpp"
 
+#include "ReplayParser/ReplayCache.hpp"
 #include "ReplayParser/ReplayParser.hpp"
 #include "GameFileUnpack/GameFileUnpack.hpp"
 
 #include <QFileSystemWatcher>
 #include <QString>
+#include <QTimer>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
 #include <unordered_set>
 #include <string>
+#include <vector>
 
 
 namespace fs = std::filesystem;
@@ -28,17 +40,41 @@ Q_DECLARE_METATYPE(ReplaySummary);
 
 namespace PotatoAlert::Client {
 
+struct BatchAnalysisOptions
+{
+	// how many replays are analyzed at the same time
+	size_t MaxConcurrency = std::max(1u, std::thread::hardware_concurrency() / 2);
+	// estimated memory of all replays in flight, a single replay is always allowed to exceed it
+	size_t MemoryBudget = 1024 * 1024 * 1024;
+	// how many summaries are written to the database in one transaction
+	size_t WriteBatchSize = 64;
+	// where the decoded packet streams are kept, so analyzing a replay again skips decrypting and inflating it
+	std::optional<std::filesystem::path> CacheDirectory;
+	uint64_t CacheSize = 2ull * 1024 * 1024 * 1024;
+};
+
+// what a replay file looked like the last time it was checked
+struct ReplayFileState
+{
+	uint64_t Size;
+	int64_t LastModified;
+	size_t TailHash;
+
+	bool operator==(const ReplayFileState&) const = default;
+};
+
 class ReplayAnalyzer : public QObject
 {
 	Q_OBJECT
 
 public:
-	ReplayAnalyzer(const ServiceProvider& serviceProvider, const fs::path& gameFilePath)
-		: m_services(serviceProvider), m_gameFilePath(gameFilePath)
-	{
-		qRegisterMetaType<uint32_t>("uint32_t");
-		qRegisterMetaType<ReplaySummary>("ReplaySummary");
-	}
+	ReplayAnalyzer(const ServiceProvider& serviceProvider, const fs::path& gameFilePath, const BatchAnalysisOptions& batchOptions = {});
+
+	ReplayAnalyzer(const ReplayAnalyzer&) = delete;
+	ReplayAnalyzer(ReplayAnalyzer&&) = delete;
+	ReplayAnalyzer& operator=(const ReplayAnalyzer&) = delete;
+	ReplayAnalyzer& operator=(ReplayAnalyzer&&) = delete;
+	~ReplayAnalyzer() override;
 
 	void AnalyzeDirectory(const std::filesystem::path& directory);
 	void OnFileChanged(const std::filesystem::path& file);
@@ -46,13 +82,51 @@ public:
 	static GameFileUnpack::UnpackResult<void> UnpackGameFiles(const std::filesystem::path& dst, const std::filesystem::path& pkgPath, const std::filesystem::path& idxPath);
 
 private:
-	void AnalyzeReplay(const std::filesystem::path& path, std::chrono::seconds readDelay = std::chrono::seconds(0));
+	struct BatchJob
+	{
+		std::filesystem::path Path;
+		size_t Cost;
+	};
+
+	struct PendingFile
+	{
+		std::optional<ReplayFileState> State;
+		uint32_t StableChecks = 0;
+		uint32_t Checks = 0;
+	};
+
+	void AnalyzeReplay(const std::filesystem::path& path);
+	void CheckReadiness(const std::filesystem::path& file);
+	void RunBatch();
+	void StartBatchJob(BatchJob job);
+	bool CanStartBatchJob(const BatchJob& job) const;
+	void WriteSummaries(std::span<const ReplaySummary> summaries) const;
 
 	const ServiceProvider& m_services;
-	Core::ThreadPool m_threadPool;
+	std::unique_ptr<ReplayParser::ReplayCache> m_cache;
 	std::unordered_map<std::filesystem::path::string_type, std::future<void>> m_futures;
 	fs::path m_gameFilePath;
 
+	// replays the game is possibly still writing, they are checked on the timer wheel until they stop changing
+	Core::TimerWheel m_readinessWheel;
+	QTimer m_readinessTimer;
+	std::unordered_map<std::filesystem::path::string_type, PendingFile> m_pendingFiles;
+
+	BatchAnalysisOptions m_batchOptions;
+	std::mutex m_batchMutex;
+	std::condition_variable m_batchCondition;
+	std::thread m_batchThread;
+	bool m_batchRunning = false;
+	bool m_batchStopping = false;
+	std::deque<BatchJob> m_batchQueue;
+	std::unordered_set<std::filesystem::path::string_type> m_batchQueued;
+	size_t m_batchInFlight = 0;
+	size_t m_batchCostInFlight = 0;
+	std::vector<ReplaySummary> m_batchResults;
+
+	// declared last, so its workers are joined before anything they use is destroyed
+	Core::ThreadPool m_threadPool;
+
 signals:
 	void ReplaySummaryReady(uint32_t id, const ReplaySummary& summary) const;
 };
@@ -12,6 +12,7 @@
 #include "Core/Version.hpp"
 
 #include <cstdint>
+#include <mutex>
 #include <optional>
 #include <span>
 #include <string>
@@ -194,6 +195,7 @@ DatabaseManager::~DatabaseManager()
 
 SqlResult<void> DatabaseManager::CreateTables() const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view matchesStmt = PA_DB_CREATE_TABLE_WITH_ID(matches, MATCH_FIELDS);
 	if (!m_db.Execute(matchesStmt))
 	{
@@ -211,6 +213,7 @@ SqlResult<void> DatabaseManager::CreateTables() const
 
 SqlResult<void> DatabaseManager::MigrateTables() const
 {
+	std::scoped_lock lock(m_mutex);
 	SQLite::Statement versionStmt(m_db, PA_DB_SELECT_WITH_ID(SCHEMAINFO_FIELDS) " FROM schemaInfo");
 	if (!versionStmt)
 	{
@@ -304,6 +307,7 @@ SqlResult<void> DatabaseManager::MigrateTables() const
 
 SqlResult<void> DatabaseManager::AddMatch(Match& match) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view insertQuery = "INSERT INTO matches ("
 		PA_DB_COLUMNS(MATCH_FIELDS) ") VALUES (" PA_DB_COLUMNS_VALUES(MATCH_FIELDS) ")";
 
@@ -331,6 +335,7 @@ SqlResult<void> DatabaseManager::AddMatch(Match& match) const
 
 SqlResult<void> DatabaseManager::DeleteMatch(std::string_view hash) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view deleteQuery = "DELETE FROM matches WHERE Hash = :Hash";
 
 	SQLite::Statement stmt(m_db, deleteQuery);
@@ -353,6 +358,7 @@ SqlResult<void> DatabaseManager::DeleteMatch(std::string_view hash) const
 
 SqlResult<void> DatabaseManager::DeleteMatch(uint32_t id) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view deleteQuery = "DELETE FROM matches WHERE Id = :Id";
 
 	SQLite::Statement stmt(m_db, deleteQuery);
@@ -375,6 +381,7 @@ SqlResult<void> DatabaseManager::DeleteMatch(uint32_t id) const
 
 SqlResult<void> DatabaseManager::DeleteMatches(std::span<uint32_t> ids) const
 {
+	std::scoped_lock lock(m_mutex);
 	std::stringstream ss;
 	std::ranges::copy(ids, std::ostream_iterator<int>(ss, ", "));
 	const std::string idString = ss.str();
@@ -399,6 +406,7 @@ SqlResult<void> DatabaseManager::DeleteMatches(std::span<uint32_t> ids) const
 
 SqlResult<std::optional<Match>> DatabaseManager::GetMatch(std::string_view hash) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view selectQuery =
 			PA_DB_SELECT_WITH_ID(MATCH_FIELDS) " FROM matches WHERE Hash = :Hash";
 
@@ -422,6 +430,7 @@ SqlResult<std::optional<Match>> DatabaseManager::GetMatch(std::string_view hash)
 
 SqlResult<std::optional<Match>> DatabaseManager::GetMatch(uint32_t id) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view selectQuery =
 			PA_DB_SELECT_WITH_ID(MATCH_FIELDS) " FROM matches WHERE Id = :Id";
 
@@ -445,6 +454,7 @@ SqlResult<std::optional<Match>> DatabaseManager::GetMatch(uint32_t id) const
 
 SqlResult<std::vector<Match>> DatabaseManager::GetMatches() const
 {
+	std::scoped_lock lock(m_mutex);
 	PA_PROFILE_FUNCTION();
 
 	std::vector<Match> matches;
@@ -473,6 +483,7 @@ SqlResult<std::vector<Match>> DatabaseManager::GetMatches() const
 
 SqlResult<void> DatabaseManager::UpdateMatch(uint32_t id, const Match& match) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view updateStatement = "UPDATE matches SET " PA_DB_COLUMNS_VALUES_UPDATE(MATCH_FIELDS) " WHERE Id = :Id";
 
 	SQLite::Statement stmt(m_db, updateStatement);
@@ -498,6 +509,7 @@ SqlResult<void> DatabaseManager::UpdateMatch(uint32_t id, const Match& match) co
 
 SqlResult<void> DatabaseManager::UpdateMatch(std::string_view hash, const Match& match) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view updateStatement = "UPDATE matches SET " PA_DB_COLUMNS_VALUES_UPDATE(MATCH_FIELDS) " WHERE Hash = :Hash";
 
 	SQLite::Statement stmt(m_db, updateStatement);
@@ -523,6 +535,7 @@ SqlResult<void> DatabaseManager::UpdateMatch(std::string_view hash, const Match&
 
 SqlResult<void> DatabaseManager::SetMatchNonAnalyzed(uint32_t id) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view updateStatement = "UPDATE matches SET Analyzed = false WHERE Id = :Id";
 
 	SQLite::Statement stmt(m_db, updateStatement);
@@ -545,6 +558,7 @@ SqlResult<void> DatabaseManager::SetMatchNonAnalyzed(uint32_t id) const
 
 SqlResult<void> DatabaseManager::SetMatchNonAnalyzed(std::string_view hash) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view updateStatement = "UPDATE matches SET Analyzed = false WHERE Hash = :Hash";
 
 	SQLite::Statement stmt(m_db, updateStatement);
@@ -567,6 +581,7 @@ SqlResult<void> DatabaseManager::SetMatchNonAnalyzed(std::string_view hash) cons
 
 SqlResult<std::vector<NonAnalyzedMatch>> DatabaseManager::GetNonAnalyzedMatches() const
 {
+	std::scoped_lock lock(m_mutex);
 	std::vector<NonAnalyzedMatch> matches;
 
 	static constexpr std::string_view selectQuery = "SELECT Hash, ReplayName FROM matches WHERE Analyzed = false";
@@ -596,6 +611,7 @@ SqlResult<std::vector<NonAnalyzedMatch>> DatabaseManager::GetNonAnalyzedMatches(
 
 SqlResult<std::optional<Match>> DatabaseManager::GetLatestMatch() const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view selectQuery = PA_DB_SELECT_WITH_ID(MATCH_FIELDS) " FROM matches ORDER BY Id DESC LIMIT 1";
 
 	SQLite::Statement stmt(m_db, selectQuery);
@@ -615,6 +631,7 @@ SqlResult<std::optional<Match>> DatabaseManager::GetLatestMatch() const
 
 SqlResult<std::optional<std::string>> DatabaseManager::GetMatchJson(uint32_t id) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view selectQuery = "SELECT Json FROM matches WHERE Id = :Id";
 
 	SQLite::Statement stmt(m_db, selectQuery);
@@ -642,6 +659,7 @@ SqlResult<std::optional<std::string>> DatabaseManager::GetMatchJson(uint32_t id)
 
 SqlResult<std::optional<std::string>> DatabaseManager::GetMatchJson(std::string_view hash) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view selectQuery = "SELECT Json FROM matches WHERE Hash = :Hash";
 
 	SQLite::Statement stmt(m_db, selectQuery);
@@ -669,6 +687,7 @@ SqlResult<std::optional<std::string>> DatabaseManager::GetMatchJson(std::string_
 
 SqlResult<void> DatabaseManager::SetMatchReplaySummary(uint32_t id, const ReplaySummary& replaySummary) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view updateStatement = "UPDATE matches SET Analyzed = TRUE, ReplaySummary = :ReplaySummary WHERE Id = :Id";
 
 	SQLite::Statement stmt(m_db, updateStatement);
@@ -695,6 +714,7 @@ SqlResult<void> DatabaseManager::SetMatchReplaySummary(uint32_t id, const Replay
 
 SqlResult<void> DatabaseManager::SetMatchReplaySummary(std::string_view hash, const ReplaySummary& replaySummary) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view updateStatement = "UPDATE matches SET Analyzed = TRUE, ReplaySummary = :ReplaySummary WHERE Hash = :Hash";
 
 	SQLite::Statement stmt(m_db, updateStatement);
@@ -718,8 +738,82 @@ SqlResult<void> DatabaseManager::SetMatchReplaySummary(std::string_view hash, co
 	return {};
 }
 
+SqlResult<std::vector<std::optional<uint32_t>>> DatabaseManager::SetMatchReplaySummaries(std::span<const ReplaySummary> replaySummaries) const
+{
+	std::scoped_lock lock(m_mutex);
+	PA_PROFILE_FUNCTION();
+
+	static constexpr std::string_view updateStatement = "UPDATE matches SET Analyzed = TRUE, ReplaySummary = :ReplaySummary WHERE Hash = :Hash";
+	static constexpr std::string_view selectQuery = "SELECT Id FROM matches WHERE Hash = :Hash";
+
+	if (!m_db.Execute("BEGIN TRANSACTION"))
+	{
+		return PA_SQL_ERROR("Failed to begin transaction: {}", m_db.GetLastError());
+	}
+
+	// the statements have to be finalized before the transaction ends
+	SqlResult<std::vector<std::optional<uint32_t>>> ids = [this, replaySummaries]() -> SqlResult<std::vector<std::optional<uint32_t>>>
+	{
+		SQLite::Statement updateStmt(m_db, updateStatement);
+		SQLite::Statement selectStmt(m_db, selectQuery);
+		if (!updateStmt || !selectStmt)
+		{
+			return PA_SQL_ERROR("Failed to prepare SQL statement: {}", m_db.GetLastError());
+		}
+
+		std::vector<std::optional<uint32_t>> ids;
+		ids.reserve(replaySummaries.size());
+		for (const ReplaySummary& replaySummary : replaySummaries)
+		{
+			rapidjson::StringBuffer buffer;
+			rapidjson::Writer writer(buffer);
+			PA_TRYV(ToJson(writer, replaySummary));
+
+			updateStmt.Reset();
+			updateStmt.Bind(":Hash", replaySummary.Hash);
+			updateStmt.Bind(":ReplaySummary", buffer.GetString());
+			updateStmt.ExecuteStep();
+			if (!updateStmt.IsDone())
+			{
+				return PA_SQL_ERROR("Failed to set ReplaySummary: {}", m_db.GetLastError());
+			}
+
+			selectStmt.Reset();
+			selectStmt.Bind(":Hash", replaySummary.Hash);
+			selectStmt.ExecuteStep();
+			int32_t id;
+			if (selectStmt.HasRow() && selectStmt.GetInt(0, id))
+			{
+				ids.emplace_back(static_cast<uint32_t>(id));
+			}
+			else
+			{
+				ids.emplace_back(std::nullopt);
+			}
+		}
+		return ids;
+	}();
+
+	if (!ids)
+	{
+		if (!m_db.Execute("ROLLBACK"))
+		{
+			LOG_ERROR("Failed to rollback transaction: {}", m_db.GetLastError());
+		}
+		return ids;
+	}
+
+	if (!m_db.Execute("COMMIT"))
+	{
+		return PA_SQL_ERROR("Failed to commit transaction: {}", m_db.GetLastError());
+	}
+
+	return ids;
+}
+
 SqlResult<bool> DatabaseManager::MatchExists(uint32_t id) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view existsQuery = "SELECT 1 FROM matches WHERE Id = :Id";
 
 	SQLite::Statement stmt(m_db, existsQuery);
@@ -736,6 +830,7 @@ SqlResult<bool> DatabaseManager::MatchExists(uint32_t id) const
 
 SqlResult<bool> DatabaseManager::MatchExists(std::string_view hash) const
 {
+	std::scoped_lock lock(m_mutex);
 	static constexpr std::string_view existsQuery = "SELECT EXISTS(SELECT 1 FROM matches WHERE Hash = :Hash)";
 
 	SQLite::Statement stmt(m_db, existsQuery);
@@ -5,29 +5,119 @@
 
 #include "Core/Encoding.hpp"
 #include "Core/File.hpp"
+#include "Core/Hash.hpp"
 #include "Core/Log.hpp"
 #include "Core/String.hpp"
 
 #include "GameFileUnpack/GameFileUnpack.hpp"
 
+#include "ReplayParser/ReplayCache.hpp"
 #include "ReplayParser/ReplayParser.hpp"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <ranges>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 
 namespace fs = std::filesystem;
 
 using namespace std::chrono_literals;
 using namespace PotatoAlert::Core;
+using PotatoAlert::Client::DatabaseManager;
 using PotatoAlert::Client::ReplayAnalyzer;
+using PotatoAlert::Client::ReplayFileState;
 using PotatoAlert::GameFileUnpack::Unpacker;
 using PotatoAlert::GameFileUnpack::UnpackResult;
 
+namespace {
+
+// rough estimate of the peak memory while analyzing a replay relative to its file size,
+// the mapped file plus the inflated payload and the entity state
+static constexpr size_t g_replayMemoryFactor = 8;
+
+// a replay is considered fully written once it stayed the same for this many checks in a row
+static constexpr auto g_readinessTick = 50ms;
+static constexpr auto g_readinessInterval = 150ms;
+static constexpr uint32_t g_readinessStableChecks = 2;
+// give up waiting after roughly a minute and just try to analyze it
+static constexpr uint32_t g_readinessMaxChecks = 400;
+static constexpr uint64_t g_readinessTailSize = 4096;
+
+static std::optional<ReplayFileState> SampleFile(const fs::path& path)
+{
+	std::error_code ec;
+	const fs::file_time_type lastModified = fs::last_write_time(path, ec);
+	if (ec)
+		return std::nullopt;
+
+	// the game might still hold the file exclusively
+	const File file = File::Open(path, File::Flags::Open | File::Flags::Read | File::Flags::ShareRead | File::Flags::ShareWrite);
+	if (!file)
+		return std::nullopt;
+
+	const uint64_t size = file.Size();
+	const uint64_t tailSize = std::min(size, g_readinessTailSize);
+	std::vector<Byte> tail;
+	if (!file.MoveFilePointer(-static_cast<int64_t>(tailSize), File::FilePointerMoveMethod::End) || !file.Read(tail, tailSize, false))
+		return std::nullopt;
+
+	return ReplayFileState
+	{
+		.Size = size,
+		.LastModified = lastModified.time_since_epoch().count(),
+		.TailHash = Hash(std::string_view(reinterpret_cast<const char*>(tail.data()), tail.size())),
+	};
+}
+
+}
+
+ReplayAnalyzer::ReplayAnalyzer(const ServiceProvider& serviceProvider, const fs::path& gameFilePath, const BatchAnalysisOptions& batchOptions)
+	: m_services(serviceProvider), m_gameFilePath(gameFilePath), m_readinessWheel(g_readinessTick), m_batchOptions(batchOptions)
+{
+	if (m_batchOptions.CacheDirectory)
+	{
+		m_cache = std::make_unique<ReplayParser::ReplayCache>(*m_batchOptions.CacheDirectory, m_batchOptions.CacheSize);
+	}
+
+	qRegisterMetaType<uint32_t>("uint32_t");
+	qRegisterMetaType<ReplaySummary>("ReplaySummary");
+
+	// the timer only runs while there are replays waiting
+	m_readinessTimer.setInterval(g_readinessTick);
+	connect(&m_readinessTimer, &QTimer::timeout, this, [this]()
+	{
+		m_readinessWheel.Advance();
+		if (m_readinessWheel.Empty())
+		{
+			m_readinessTimer.stop();
+		}
+	});
+}
+
+ReplayAnalyzer::~ReplayAnalyzer()
+{
+	{
+		std::unique_lock lock(m_batchMutex);
+		m_batchStopping = true;
+	}
+	m_batchCondition.notify_all();
+
+	if (m_batchThread.joinable())
+	{
+		m_batchThread.join();
+	}
+}
+
 bool ReplayAnalyzer::HasGameFiles(Version gameVersion) const
 {
 	return ReplayParser::HasGameScripts(gameVersion, m_gameFilePath);
@@ -36,10 +126,14 @@ bool ReplayAnalyzer::HasGameFiles(Version gameVersion) const
 
 UnpackResult<void> ReplayAnalyzer::UnpackGameFiles(const fs::path& dst, const fs::path& pkgPath, const fs::path& idxPath)
 {
+	// only these are ever extracted, the paths of everything else in the index are never resolved
+	static constexpr std::array<std::string_view, 2> prefixes = { "scripts/", "content/GameParams.data" };
+
+	const size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
 	Unpacker unpacker(pkgPath, idxPath);
-	PA_TRYV(unpacker.Parse());
-	PA_TRYV(unpacker.Extract("scripts/", dst));
-	PA_TRYV(unpacker.Extract("content/GameParams.data", dst));
+	PA_TRYV(unpacker.Parse(prefixes, threadCount));
+	PA_TRYV(unpacker.Extract("scripts/", dst, true, threadCount));
+	PA_TRYV(unpacker.Extract("content/GameParams.data", dst, true, threadCount));
 	return {};
 }
 
@@ -49,19 +143,68 @@ void ReplayAnalyzer::OnFileChanged(const std::filesystem::path& file)
 		file.filename() != fs::path("temp.wowsreplay"))
 	{
 		LOG_TRACE("Replay file {} changed", file);
-		AnalyzeReplay(file, 30s);
+
+		// the file is already being checked, every change starts the stability count over
+		if (auto it = m_pendingFiles.find(file.native()); it != m_pendingFiles.end())
+		{
+			it->second.StableChecks = 0;
+			return;
+		}
+
+		m_pendingFiles.emplace(file.native(), PendingFile{});
+		m_readinessWheel.Schedule(0ms, [this, file]() { CheckReadiness(file); });
+		m_readinessTimer.start();
 	}
 }
 
-void ReplayAnalyzer::AnalyzeReplay(const fs::path& path, std::chrono::seconds readDelay)
+void ReplayAnalyzer::CheckReadiness(const fs::path& file)
 {
-	auto analyze = [this](const fs::path& file, std::chrono::seconds delay) -> void
+	const auto it = m_pendingFiles.find(file.native());
+	if (it == m_pendingFiles.end())
+		return;
+
+	PendingFile& pending = it->second;
+	pending.Checks++;
+
+	if (!File::Exists(file))
+	{
+		LOG_TRACE("Replay file {} disappeared before it was analyzed", file);
+		m_pendingFiles.erase(it);
+		return;
+	}
+
+	const std::optional<ReplayFileState> state = SampleFile(file);
+	if (state && state == pending.State)
+	{
+		pending.StableChecks++;
+	}
+	else
 	{
-		// this is honestly not ideal, but i don't see another way of fixing it
-		LOG_TRACE(STR("Analyzing replay file {} after {} delay..."), file, delay);
-		std::this_thread::sleep_for(delay);
+		pending.StableChecks = 0;
+	}
+	pending.State = state;
 
-		PA_TRY_OR_ELSE(summary, ReplayParser::AnalyzeReplay(file, m_gameFilePath),
+	if (pending.StableChecks >= g_readinessStableChecks || pending.Checks >= g_readinessMaxChecks)
+	{
+		if (pending.StableChecks < g_readinessStableChecks)
+		{
+			LOG_WARN("Replay file {} did not settle, analyzing it anyway", file);
+		}
+		m_pendingFiles.erase(it);
+		AnalyzeReplay(file);
+		return;
+	}
+
+	m_readinessWheel.Schedule(g_readinessInterval, [this, file]() { CheckReadiness(file); });
+}
+
+void ReplayAnalyzer::AnalyzeReplay(const fs::path& path)
+{
+	auto analyze = [this](const fs::path& file) -> void
+	{
+		LOG_TRACE(STR("Analyzing replay file {}..."), file);
+
+		PA_TRY_OR_ELSE(summary, ReplayParser::AnalyzeReplay(file, m_gameFilePath, m_cache.get()),
 		{
 			LOG_ERROR(STR("Failed to analyze replay file {}: {}"), file, StringWrap(error));
 			return;
@@ -91,16 +234,26 @@ void ReplayAnalyzer::AnalyzeReplay(const fs::path& path, std::chrono::seconds re
 		LOG_TRACE("Cannot find replay to set summary with hash '{}'", summary.Hash);
 	};
 
+	// the batch analysis is going to write its summary anyway
+	{
+		std::unique_lock lock(m_batchMutex);
+		if (m_batchQueued.contains(path.native()))
+		{
+			LOG_TRACE(STR("Replay file {} is already queued for batch analysis"), path);
+			return;
+		}
+	}
+
 	// if this replay was never analyzed or analyzing finished, analyze it
 	// this avoids running multiple analyzes if the game writes to the replay multiple times
 	if (!m_futures.contains(path.native()))
 	{
-		m_futures.emplace(path.native(), m_threadPool.Enqueue(analyze, path, readDelay));
+		m_futures.emplace(path.native(), m_threadPool.Enqueue(analyze, path));
 	}
 
 	if (m_futures.at(path.native()).wait_for(0s) == std::future_status::ready)
 	{
-		m_futures.at(path.native()) = m_threadPool.Enqueue(analyze, path, readDelay);
+		m_futures.at(path.native()) = m_threadPool.Enqueue(analyze, path);
 	}
 }
 
@@ -114,10 +267,12 @@ void ReplayAnalyzer::AnalyzeDirectory(const fs::path& directory)
 		return;
 	});
 
-	std::ranges::sort(matches, [](const NonAnalyzedMatch& left, const NonAnalyzedMatch& right)
+	std::unordered_set<std::string> pending;
+	pending.reserve(matches.size());
+	for (const NonAnalyzedMatch& match : matches)
 	{
-		return left.ReplayName < right.ReplayName;
-	});
+		pending.emplace(String::ToLower(match.ReplayName));
+	}
 
 	std::error_code ec;
 	auto it = fs::recursive_directory_iterator(directory, ec);
@@ -127,20 +282,170 @@ void ReplayAnalyzer::AnalyzeDirectory(const fs::path& directory)
 		return;
 	}
 
+	std::vector<BatchJob> jobs;
 	for (const fs::directory_entry& entry : it)
 	{
-		if (entry.is_regular_file() && entry.path().extension() == ".wowsreplay")
+		if (pending.empty())
+			break;
+
+		if (!entry.is_regular_file(ec) || entry.path().extension() != ".wowsreplay")
+			continue;
+
+		// every match is only analyzed once, even if there are multiple copies of the replay
+		if (pending.erase(String::ToLower(entry.path().filename().string())) == 0)
+			continue;
+
+		// it is being analyzed right now, because the game just wrote it
+		if (const auto future = m_futures.find(entry.path().native());
+			future != m_futures.end() && future->second.wait_for(0s) != std::future_status::ready)
+			continue;
+
+		const uintmax_t fileSize = entry.file_size(ec);
+		jobs.emplace_back(BatchJob{ entry.path(), ec ? 0 : static_cast<size_t>(fileSize) * g_replayMemoryFactor });
+	}
+
+	if (jobs.empty())
+		return;
+
+	LOG_INFO("Queueing {} replays for analysis", jobs.size());
+
+	std::unique_lock lock(m_batchMutex);
+	for (BatchJob& job : jobs)
+	{
+		if (m_batchQueued.emplace(job.Path.native()).second)
 		{
-			auto found = std::ranges::find_if(matches, [&](const NonAnalyzedMatch& match)
-			{
-				const std::string fileName = String::ToLower(entry.path().filename().string());
-				return String::ToLower(match.ReplayName) == fileName;
-			});
+			m_batchQueue.emplace_back(std::move(job));
+		}
+	}
+
+	if (!m_batchRunning)
+	{
+		// the previous batch finished on its own, it only has to be joined
+		if (m_batchThread.joinable())
+		{
+			m_batchThread.join();
+		}
+		m_batchRunning = true;
+		m_batchThread = std::thread(&ReplayAnalyzer::RunBatch, this);
+	}
+	else
+	{
+		m_batchCondition.notify_all();
+	}
+}
+
+bool ReplayAnalyzer::CanStartBatchJob(const BatchJob& job) const
+{
+	if (m_batchInFlight >= m_batchOptions.MaxConcurrency)
+		return false;
+
+	// a replay bigger than the whole budget still has to be analyzed at some point
+	return m_batchInFlight == 0 || m_batchCostInFlight + job.Cost <= m_batchOptions.MemoryBudget;
+}
+
+void ReplayAnalyzer::StartBatchJob(BatchJob job)
+{
+	m_batchInFlight++;
+	m_batchCostInFlight += job.Cost;
+
+	m_threadPool.Enqueue([this](const BatchJob& job)
+	{
+		std::optional<ReplaySummary> summary;
+		if (ReplayResult<ReplaySummary> result = ReplayParser::AnalyzeReplay(job.Path, m_gameFilePath, m_cache.get()))
+		{
+			summary = std::move(*result);
+		}
+		else
+		{
+			LOG_ERROR(STR("Failed to analyze replay file {}: {}"), job.Path, StringWrap(result.error()));
+		}
+
+		// notified under the lock, once the batch thread sees nothing in flight the analyzer may be destroyed
+		std::unique_lock lock(m_batchMutex);
+		m_batchInFlight--;
+		m_batchCostInFlight -= job.Cost;
+		m_batchQueued.erase(job.Path.native());
+		if (summary)
+		{
+			m_batchResults.emplace_back(std::move(*summary));
+		}
+		m_batchCondition.notify_all();
+	}, std::move(job));
+}
+
+void ReplayAnalyzer::RunBatch()
+{
+	std::unique_lock lock(m_batchMutex);
+	while (true)
+	{
+		m_batchCondition.wait(lock, [this]()
+		{
+			return m_batchStopping ||
+				m_batchResults.size() >= m_batchOptions.WriteBatchSize ||
+				(m_batchInFlight == 0 && (m_batchQueue.empty() || !m_batchResults.empty())) ||
+				(!m_batchQueue.empty() && CanStartBatchJob(m_batchQueue.front()));
+		});
+
+		if (m_batchStopping)
+		{
+			// the jobs reference this analyzer, so they have to finish before it goes away
+			m_batchCondition.wait(lock, [this]() { return m_batchInFlight == 0; });
 
-			if (found != matches.end())
+			// whatever already finished is still written, only the replays that never started are left for next time
+			const std::vector<ReplaySummary> results = std::exchange(m_batchResults, {});
+			lock.unlock();
+			if (!results.empty())
 			{
-				AnalyzeReplay(entry.path());
+				WriteSummaries(results);
 			}
+			lock.lock();
+			m_batchRunning = false;
+			return;
+		}
+
+		while (!m_batchQueue.empty() && CanStartBatchJob(m_batchQueue.front()))
+		{
+			StartBatchJob(std::move(m_batchQueue.front()));
+			m_batchQueue.pop_front();
+		}
+
+		if (m_batchResults.size() >= m_batchOptions.WriteBatchSize || (m_batchInFlight == 0 && !m_batchResults.empty()))
+		{
+			const std::vector<ReplaySummary> results = std::exchange(m_batchResults, {});
+			lock.unlock();
+			WriteSummaries(results);
+			lock.lock();
+		}
+
+		if (m_batchInFlight == 0 && m_batchQueue.empty() && m_batchResults.empty())
+		{
+			LOG_INFO("Finished batch replay analysis");
+			m_batchRunning = false;
+			return;
+		}
+	}
+}
+
+void ReplayAnalyzer::WriteSummaries(std::span<const ReplaySummary> summaries) const
+{
+	const DatabaseManager& dbm = m_services.Get<DatabaseManager>();
+
+	PA_TRY_OR_ELSE(ids, dbm.SetMatchReplaySummaries(summaries),
+	{
+		LOG_ERROR("Failed to set {} replay summaries: {}", summaries.size(), error);
+		return;
+	});
+
+	for (size_t i = 0; i < summaries.size(); i++)
+	{
+		if (ids[i])
+		{
+			emit ReplaySummaryReady(*ids[i], summaries[i]);
+		}
+		else
+		{
+			LOG_TRACE("Cannot find replay to set summary with hash '{}'", summaries[i].Hash);
 		}
 	}
+	LOG_TRACE("Set {} replay summaries", summaries.size());
 }
@@ -31,6 +31,11 @@ public:
 	bool Decrypt(std::span<const Byte> src, std::span<Byte> dst) const;
 	bool Encrypt(std::span<const Byte> src, std::span<Byte> dst) const;
 
+	// Decrypts src into dst and xors every block with the previous plaintext block, chain holds the block before
+	// the first one and is updated to the last one, so a payload can be decrypted in consecutive pieces.
+	// The blocks are decrypted several at a time and large inputs can be split across threads.
+	bool DecryptChained(std::span<const Byte> src, std::span<Byte> dst, std::span<Byte, 8> chain, size_t threadCount = 1) const;
+
 	void EncryptBlock(uint32_t* left, uint32_t* right) const;
 	void DecryptBlock(uint32_t* left, uint32_t* right) const;
 
@@ -42,6 +47,7 @@ private:
 	std::array<uint32_t, N + 2> m_pArray;
 	std::array<std::array<uint32_t, 256>, 4> m_sBoxes;
 	[[nodiscard]] uint32_t F(uint32_t x) const;
+	void DecryptBlocks(std::span<const Byte> src, std::span<Byte> dst) const;
 };
 
 }  // namespace PotatoAlert::Core
@@ -17,7 +17,7 @@ template<typename T>
 concept character = std::integral<T> && any_of<T, char, wchar_t, char8_t, char16_t, char32_t>;
 
 template<typename T>
-concept is_std_string = std::is_same_v<T, std::string> || std::is_same_v<T, std::wstring>;
+concept is_std_string = any_of<T, std::string, std::wstring, std::pmr::string, std::pmr::wstring>;
 
 template<typename T>
 concept is_string = std::ranges::contiguous_range<T> && character<std::ranges::range_value_t<T>>;
@@ -141,6 +141,8 @@ public:
 		bool GetDouble(int index, double& outDouble) const;
 
 		void ExecuteStep();
+		// makes the statement ready to be executed again, keeps the bindings
+		bool Reset();
 		[[nodiscard]] bool IsDone() const { return m_done; }
 		[[nodiscard]] bool HasRow() const { return m_hasRow; }
 
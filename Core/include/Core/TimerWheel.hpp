@@ -0,0 +1,60 @@
+// Copyright 2024 <github.com/razaqq>
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+
+namespace PotatoAlert::Core {
+
+// Hashed timer wheel, timers are bucketed by their expiry tick, so scheduling, cancelling and advancing are O(1)
+// in the number of pending timers. It does not own a clock or thread, whoever owns it has to call Advance every tick.
+class TimerWheel
+{
+public:
+	using Callback = std::function<void()>;
+	using TimerId = uint64_t;
+
+	explicit TimerWheel(std::chrono::milliseconds tick, size_t slotCount = 256);
+
+	// the callback runs from within Advance, the delay is rounded up to full ticks
+	TimerId Schedule(std::chrono::milliseconds delay, Callback callback);
+	bool Cancel(TimerId id);
+
+	// moves the wheel forward and runs every timer that expired, returns how many did
+	size_t Advance(size_t ticks = 1);
+
+	[[nodiscard]] std::chrono::milliseconds Tick() const
+	{
+		return m_tick;
+	}
+
+	[[nodiscard]] size_t Pending() const
+	{
+		return m_slotOf.size();
+	}
+
+	[[nodiscard]] bool Empty() const
+	{
+		return m_slotOf.empty();
+	}
+
+private:
+	struct Timer
+	{
+		TimerId Id;
+		size_t Rounds;
+		Callback Func;
+	};
+
+	std::chrono::milliseconds m_tick;
+	std::vector<std::vector<Timer>> m_slots;
+	std::unordered_map<TimerId, size_t> m_slotOf;
+	size_t m_cursor = 0;
+	TimerId m_nextId = 1;
+};
+
+}  // namespace PotatoAlert::Core
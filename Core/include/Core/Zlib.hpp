@@ -3,12 +3,55 @@
 
 #include "Core/Bytes.hpp"
 
+#include <functional>
+#include <memory>
 #include <span>
 #include <vector>
 
 
+struct z_stream_s;
+
 namespace PotatoAlert::Core::Zlib {
 
-std::vector<Byte> Inflate(std::span<const Byte> in, bool hasHeader = true);
+// the size hint is what the output is allocated with up front, it only grows if the data turns out bigger
+std::vector<Byte> Inflate(std::span<const Byte> in, bool hasHeader = true, size_t sizeHint = 0);
+
+// inflates directly into out, fails unless the stream ends exactly at the end of out
+bool Inflate(std::span<const Byte> in, std::span<Byte> out, bool hasHeader = true);
+
+// Incremental inflate, input can be fed in arbitrary pieces and the output is handed to a sink chunk by chunk.
+// The sink can return false to abort the stream.
+class Inflater
+{
+public:
+	using Sink = std::function<bool(std::span<const Byte>)>;
+
+	explicit Inflater(bool hasHeader = true);
+	Inflater(const Inflater&) = delete;
+	Inflater(Inflater&&) noexcept;
+	Inflater& operator=(const Inflater&) = delete;
+	Inflater& operator=(Inflater&&) noexcept;
+	~Inflater();
+
+	explicit operator bool() const { return m_stream != nullptr && !m_failed; }
+
+	bool Feed(std::span<const Byte> in, const Sink& sink);
+
+	// inflates directly into the front of out and advances it past the written bytes,
+	// fails if out is full before the input is used up
+	bool Feed(std::span<const Byte> in, std::span<Byte>& out);
+
+	[[nodiscard]] bool Finished() const { return m_finished; }
+	[[nodiscard]] size_t TotalOut() const { return m_totalOut; }
+
+private:
+	std::unique_ptr<z_stream_s> m_stream;
+	bool m_failed = false;
+	bool m_finished = false;
+	size_t m_totalOut = 0;
+};
+
+// streams the inflated data to the sink without ever holding all of it
+bool Inflate(std::span<const Byte> in, const Inflater::Sink& sink, bool hasHeader = true);
 
 }  // namespace PotatoAlert::Core::Zlib
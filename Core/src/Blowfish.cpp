@@ -10,10 +10,22 @@
 #include <memory>
 #include <span>
 #include <string>
+#include <thread>
+#include <vector>
 
 
 using PotatoAlert::Core::Blowfish;
 
+namespace {
+
+// how many independent blocks are decrypted side by side to hide the latency of the s-box lookups
+static constexpr size_t g_interleavedBlocks = 4;
+
+// splitting less than this across threads costs more than it saves
+static constexpr size_t g_minBytesPerThread = 256 * 1024;
+
+}
+
 static const std::array<uint32_t, N + 2> P = {
 	0x243F6A88L, 0x85A308D3L, 0x13198A2EL, 0x03707344L, 0xA4093822L,
 	0x299F31D0L, 0x082EFA98L, 0xEC4E6C89L, 0x452821E6L, 0x38D01377L,
@@ -376,6 +388,117 @@ bool Blowfish::Decrypt(std::span<const Byte> src, std::span<Byte> dst) const
 	return true;
 }
 
+bool Blowfish::DecryptChained(std::span<const Byte> src, std::span<Byte> dst, std::span<Byte, 8> chain, size_t threadCount) const
+{
+	if (dst.size() < src.size() || src.size() % BlockSize() != 0)
+	{
+		return false;
+	}
+
+	threadCount = std::clamp(threadCount, size_t(1), std::max(size_t(1), src.size() / g_minBytesPerThread));
+	if (threadCount == 1)
+	{
+		DecryptBlocks(src, dst);
+	}
+	else
+	{
+		// the blocks are decrypted independently, only the chaining below depends on the previous block
+		const size_t bytesPerThread = (src.size() / BlockSize() + threadCount - 1) / threadCount * BlockSize();
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		for (size_t offset = bytesPerThread; offset < src.size(); offset += bytesPerThread)
+		{
+			const size_t size = std::min(bytesPerThread, src.size() - offset);
+			threads.emplace_back([this, src = src.subspan(offset, size), dst = dst.subspan(offset, size)]()
+			{
+				DecryptBlocks(src, dst);
+			});
+		}
+		DecryptBlocks(src.first(std::min(bytesPerThread, src.size())), dst);
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	// every plaintext block is the decrypted block xor the previous plaintext block, which is just a running xor
+	uint64_t prev;
+	std::memcpy(&prev, chain.data(), sizeof(prev));
+	for (size_t offset = 0; offset < src.size(); offset += BlockSize())
+	{
+		uint64_t block;
+		std::memcpy(&block, dst.data() + offset, sizeof(block));
+		prev ^= block;
+		std::memcpy(dst.data() + offset, &prev, sizeof(prev));
+	}
+	std::memcpy(chain.data(), &prev, sizeof(prev));
+
+	return true;
+}
+
+void Blowfish::DecryptBlocks(std::span<const Byte> src, std::span<Byte> dst) const
+{
+	const size_t blockCount = src.size() / BlockSize();
+
+	size_t block = 0;
+	for (; block + g_interleavedBlocks <= blockCount; block += g_interleavedBlocks)
+	{
+		uint32_t left[g_interleavedBlocks];
+		uint32_t right[g_interleavedBlocks];
+		for (size_t k = 0; k < g_interleavedBlocks; k++)
+		{
+			const size_t offset = (block + k) * BlockSize();
+			std::memcpy(&left[k], src.data() + offset, sizeof(uint32_t));
+			std::memcpy(&right[k], src.data() + offset + sizeof(uint32_t), sizeof(uint32_t));
+			ReverseByteOrder(left[k]);
+			ReverseByteOrder(right[k]);
+		}
+
+		// same rounds as DecryptBlock, two at a time so the halves do not have to be swapped
+		for (size_t i = N + 1; i > 1; i -= 2)
+		{
+			for (size_t k = 0; k < g_interleavedBlocks; k++)
+			{
+				left[k] ^= m_pArray[i];
+				right[k] ^= F(left[k]);
+			}
+			for (size_t k = 0; k < g_interleavedBlocks; k++)
+			{
+				right[k] ^= m_pArray[i - 1];
+				left[k] ^= F(right[k]);
+			}
+		}
+
+		for (size_t k = 0; k < g_interleavedBlocks; k++)
+		{
+			uint32_t outLeft = right[k] ^ m_pArray[0];
+			uint32_t outRight = left[k] ^ m_pArray[1];
+			ReverseByteOrder(outLeft);
+			ReverseByteOrder(outRight);
+
+			const size_t offset = (block + k) * BlockSize();
+			std::memcpy(dst.data() + offset, &outLeft, sizeof(uint32_t));
+			std::memcpy(dst.data() + offset + sizeof(uint32_t), &outRight, sizeof(uint32_t));
+		}
+	}
+
+	for (; block < blockCount; block++)
+	{
+		const size_t offset = block * BlockSize();
+		uint32_t b[2];
+		std::memcpy(b, src.data() + offset, sizeof(b));
+
+		ReverseByteOrder(b[0]);
+		ReverseByteOrder(b[1]);
+		DecryptBlock(&b[0], &b[1]);
+		ReverseByteOrder(b[0]);
+		ReverseByteOrder(b[1]);
+
+		std::memcpy(dst.data() + offset, b, sizeof(b));
+	}
+}
+
 void Blowfish::EncryptBlock(uint32_t* left, uint32_t* right) const
 {
 	for (size_t i = 0; i < N; ++i)
@@ -236,7 +236,8 @@ bool File::RawWrite(Handle handle, std::span<const T> data, bool resetFilePointe
 		return false;
 	}
 
-	if (ftruncate64(UnwrapHandle<int>(handle), data.size()) == -1)
+	// the file ends after the data just written, like SetEndOfFile does on windows
+	if (ftruncate64(UnwrapHandle<int>(handle), RawCurrentFilePointer(handle)) == -1)
 	{
 		// TODO: handle error
 		return false;
@@ -273,7 +274,8 @@ bool File::RawWriteString(Handle handle, std::string_view data, bool resetFilePo
 		return false;
 	}
 
-	if (ftruncate64(UnwrapHandle<int>(handle), static_cast<off64_t>(data.size())) == -1)
+	// the file ends after the data just written, like SetEndOfFile does on windows
+	if (ftruncate64(UnwrapHandle<int>(handle), RawCurrentFilePointer(handle)) == -1)
 	{
 		// TODO: handle error
 		return false;
@@ -186,6 +186,13 @@ void SQLite::Statement::ExecuteStep()
 	}
 }
 
+bool SQLite::Statement::Reset()
+{
+	m_hasRow = false;
+	m_done = false;
+	return sqlite3_reset(static_cast<sqlite3_stmt*>(m_stmt)) == SQLITE_OK;
+}
+
 bool SQLite::Statement::GetText(int index, std::string& outStr) const
 {
 	if (!m_hasRow || index < 0 || index > m_columnCount)
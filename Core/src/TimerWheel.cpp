@@ -0,0 +1,74 @@
+// Copyright 2024 <github.com/razaqq>
+
+#include "Core/TimerWheel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+
+using PotatoAlert::Core::TimerWheel;
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, size_t slotCount)
+	: m_tick(std::max(tick, std::chrono::milliseconds(1))), m_slots(std::max(slotCount, size_t(1)))
+{
+}
+
+TimerWheel::TimerId TimerWheel::Schedule(std::chrono::milliseconds delay, Callback callback)
+{
+	const size_t ticks = std::max<size_t>(1, static_cast<size_t>((std::max(delay.count(), int64_t(0)) + m_tick.count() - 1) / m_tick.count()));
+	const size_t slot = (m_cursor + ticks) % m_slots.size();
+
+	const TimerId id = m_nextId++;
+	m_slots[slot].emplace_back(Timer{ id, (ticks - 1) / m_slots.size(), std::move(callback) });
+	m_slotOf.emplace(id, slot);
+	return id;
+}
+
+bool TimerWheel::Cancel(TimerId id)
+{
+	const auto it = m_slotOf.find(id);
+	if (it == m_slotOf.end())
+		return false;
+
+	std::vector<Timer>& slot = m_slots[it->second];
+	std::erase_if(slot, [id](const Timer& timer) { return timer.Id == id; });
+	m_slotOf.erase(it);
+	return true;
+}
+
+size_t TimerWheel::Advance(size_t ticks)
+{
+	size_t fired = 0;
+	std::vector<Callback> expired;
+	for (size_t i = 0; i < ticks; i++)
+	{
+		m_cursor = (m_cursor + 1) % m_slots.size();
+
+		std::vector<Timer>& slot = m_slots[m_cursor];
+		for (auto it = slot.begin(); it != slot.end();)
+		{
+			if (it->Rounds == 0)
+			{
+				m_slotOf.erase(it->Id);
+				expired.emplace_back(std::move(it->Func));
+				it = slot.erase(it);
+			}
+			else
+			{
+				it->Rounds--;
+				++it;
+			}
+		}
+
+		// callbacks may schedule or cancel timers, so they only run once the slot is consistent
+		for (Callback& callback : expired)
+		{
+			callback();
+		}
+		fired += expired.size();
+		expired.clear();
+	}
+	return fired;
+}
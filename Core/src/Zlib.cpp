@@ -7,52 +7,206 @@
 
 #include "zlib.h"
 
+#include <algorithm>
 #include <cstring>
 #include <span>
 #include <vector>
 
 
-std::vector<Byte> PotatoAlert::Core::Zlib::Inflate(std::span<const Byte> in, bool hasHeader)
+namespace {
+
+// the output vector grows by at least this much if the size hint was too small
+static constexpr size_t g_minGrowth = 16 * 1024;
+
+}
+
+std::vector<Byte> PotatoAlert::Core::Zlib::Inflate(std::span<const Byte> in, bool hasHeader, size_t sizeHint)
 {
-	std::vector<Byte> out;
-	unsigned char chunk[2048];
+	std::vector<Byte> out(std::max(sizeHint, g_minGrowth));
 
 	z_stream stream = {};
-	int ret = 0;
-	if (hasHeader)
-		ret = inflateInit(&stream);
-	else
-		ret = inflateInit2(&stream, -15);
+	const int init = hasHeader ? inflateInit(&stream) : inflateInit2(&stream, -15);
+	if (init != Z_OK)
+	{
+		return {};
+	}
 
 	stream.next_in = reinterpret_cast<const Bytef*>(in.data());
 	stream.avail_in = static_cast<uInt>(in.size());
 
+	int ret;
 	do {
-		do {
-			stream.next_out = chunk;
-			stream.avail_out = sizeof(chunk);
+		if (stream.total_out == out.size())
+		{
+			out.resize(out.size() + std::max(out.size() / 2, g_minGrowth));
+		}
+		stream.next_out = reinterpret_cast<Bytef*>(out.data() + stream.total_out);
+		stream.avail_out = static_cast<uInt>(out.size() - stream.total_out);
 
-			ret = inflate(&stream, Z_NO_FLUSH);
-			switch (ret)
-			{
-				case Z_OK:
-				case Z_STREAM_END:
-					break;
+		ret = inflate(&stream, Z_NO_FLUSH);
+	} while (ret == Z_OK);
 
-				default:
-					out.resize(0);
-					goto exit;
-			}
+	if (ret == Z_STREAM_END)
+	{
+		out.resize(stream.total_out);
+	}
+	else
+	{
+		out.clear();
+	}
+
+	inflateEnd(&stream);
+	return out;
+}
+
+bool PotatoAlert::Core::Zlib::Inflate(std::span<const Byte> in, std::span<Byte> out, bool hasHeader)
+{
+	z_stream stream = {};
+	const int init = hasHeader ? inflateInit(&stream) : inflateInit2(&stream, -15);
+	if (init != Z_OK)
+	{
+		return false;
+	}
 
-			size_t size = sizeof(chunk) - stream.avail_out;
+	stream.next_in = reinterpret_cast<const Bytef*>(in.data());
+	stream.avail_in = static_cast<uInt>(in.size());
+	stream.next_out = reinterpret_cast<Bytef*>(out.data());
+	stream.avail_out = static_cast<uInt>(out.size());
 
-			size_t pos = out.size();
-			out.resize(out.size() + size);
-			std::memcpy(out.data() + pos, chunk, size);
-		} while (stream.avail_out == 0);
-	} while (ret != Z_STREAM_END);
+	// the whole output is there, so a single call either finishes the stream or something is wrong
+	const int ret = inflate(&stream, Z_FINISH);
+	const bool ok = ret == Z_STREAM_END && stream.total_out == out.size();
 
-exit:
 	inflateEnd(&stream);
-	return out;
+	return ok;
+}
+
+bool PotatoAlert::Core::Zlib::Inflate(std::span<const Byte> in, const Inflater::Sink& sink, bool hasHeader)
+{
+	Inflater inflater(hasHeader);
+	return inflater && inflater.Feed(in, sink) && inflater.Finished();
+}
+
+using PotatoAlert::Core::Zlib::Inflater;
+
+Inflater::Inflater(bool hasHeader) : m_stream(std::make_unique<z_stream>())
+{
+	const int ret = hasHeader ? inflateInit(m_stream.get()) : inflateInit2(m_stream.get(), -15);
+	if (ret != Z_OK)
+	{
+		m_stream.reset();
+	}
+}
+
+Inflater::Inflater(Inflater&& other) noexcept = default;
+
+Inflater& Inflater::operator=(Inflater&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (m_stream)
+			inflateEnd(m_stream.get());
+		m_stream = std::move(other.m_stream);
+		m_failed = other.m_failed;
+		m_finished = other.m_finished;
+		m_totalOut = other.m_totalOut;
+	}
+	return *this;
+}
+
+Inflater::~Inflater()
+{
+	if (m_stream)
+		inflateEnd(m_stream.get());
+}
+
+bool Inflater::Feed(std::span<const Byte> in, const Sink& sink)
+{
+	if (!m_stream || m_failed)
+		return false;
+
+	// anything after the end of the stream is padding
+	if (m_finished)
+		return true;
+
+	unsigned char chunk[16384];
+
+	m_stream->next_in = reinterpret_cast<const Bytef*>(in.data());
+	m_stream->avail_in = static_cast<uInt>(in.size());
+
+	do {
+		m_stream->next_out = chunk;
+		m_stream->avail_out = sizeof(chunk);
+
+		const int ret = inflate(m_stream.get(), Z_NO_FLUSH);
+		switch (ret)
+		{
+			case Z_OK:
+				break;
+			case Z_STREAM_END:
+				m_finished = true;
+				break;
+			case Z_BUF_ERROR:
+				// no progress possible, need more input
+				return true;
+			default:
+				m_failed = true;
+				return false;
+		}
+
+		const size_t size = sizeof(chunk) - m_stream->avail_out;
+		m_totalOut += size;
+		if (size > 0 && !sink(std::span<const Byte>{ chunk, size }))
+		{
+			m_failed = true;
+			return false;
+		}
+	} while (!m_finished && (m_stream->avail_in > 0 || m_stream->avail_out == 0));
+
+	return true;
+}
+
+bool Inflater::Feed(std::span<const Byte> in, std::span<Byte>& out)
+{
+	if (!m_stream || m_failed)
+		return false;
+
+	if (m_finished)
+		return true;
+
+	m_stream->next_in = reinterpret_cast<const Bytef*>(in.data());
+	m_stream->avail_in = static_cast<uInt>(in.size());
+	m_stream->next_out = reinterpret_cast<Bytef*>(out.data());
+	m_stream->avail_out = static_cast<uInt>(out.size());
+
+	const int ret = inflate(m_stream.get(), Z_NO_FLUSH);
+
+	const size_t size = out.size() - m_stream->avail_out;
+	m_totalOut += size;
+	out = out.subspan(size);
+
+	switch (ret)
+	{
+		case Z_OK:
+			// everything fits, so inflate only stops early if the output is full
+			if (m_stream->avail_in > 0)
+			{
+				m_failed = true;
+				return false;
+			}
+			return true;
+		case Z_STREAM_END:
+			m_finished = true;
+			return true;
+		case Z_BUF_ERROR:
+			if (m_stream->avail_out == 0 && m_stream->avail_in > 0)
+			{
+				m_failed = true;
+				return false;
+			}
+			return true;
+		default:
+			m_failed = true;
+			return false;
+	}
 }
@@ -8,7 +8,7 @@
 #include <optional>
 #include <span>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 
@@ -42,82 +42,107 @@ struct IdxHeader
 static_assert(sizeof(IdxHeader) == HeaderSize);
 
 static constexpr uint32_t NodeSize = 0x20;
-struct Node
-{
-	std::string Name;
-	uint64_t Id;
-	uint64_t Parent;
-
-	static UnpackResult<Node> Parse(std::span<const Core::Byte> data, uint64_t offset, std::span<const Core::Byte> fullData);
-};
 
 static constexpr uint32_t FileRecordSize = 0x30;
+// what is needed to extract a file, its path is given by the node of the tree it is in
 struct FileRecord
 {
-	std::string PkgName;
-	std::string Path;
 	uint64_t NodeId;
 	uint64_t VolumeId;
 	uint64_t Offset;
 	uint64_t CompressionInfo;
+	uint64_t UncompressedSize;
 	uint32_t Size;
 	uint32_t Crc32;
-	uint64_t UncompressedSize;
-	uint32_t Padding;
-
-	static UnpackResult<FileRecord> Parse(std::span<const Core::Byte> data, const std::unordered_map<uint64_t, Node>& nodes);
+	// index into the pkg names of the tree the record is in
+	uint32_t Pkg;
 };
 
-static constexpr uint32_t VolumeSize = 0x18;
-struct Volume
+// a record together with its full path, the path is only kept until the record is inserted into a tree
+struct PathRecord
 {
-	std::string Name;
-	uint64_t Id;
-
-	static UnpackResult<Volume> Parse(std::span<const Core::Byte> data, uint64_t offset, std::span<const Core::Byte> fullData);
+	std::string Path;
+	FileRecord Record;
 };
 
-struct IdxFile
-{
-	std::string_view PkgName;
-	std::unordered_map<uint64_t, Node> Nodes;
-	std::vector<FileRecord> Files;
-	std::vector<Volume> Volumes;
-
-	static UnpackResult<IdxFile> Parse(std::span<const Core::Byte> data);
-};
+static constexpr uint32_t VolumeSize = 0x18;
 
+// All records of the index in one flat table, the children of a node are stored next to each other and sorted by name.
+// The tree is built once from every record and never changed afterwards.
 class DirectoryTree
 {
 public:
-	struct TreeNode
+	// a reference to a node, it is only valid as long as the tree it came from
+	class TreeNode
 	{
-		std::unordered_map<std::string, TreeNode> Nodes;
-		std::optional<FileRecord> File;
+	public:
+		[[nodiscard]] std::string_view Name() const;
+		// joined from the names of the nodes above, empty for the root
+		[[nodiscard]] std::string Path() const;
+		// nullptr for directories
+		[[nodiscard]] const FileRecord* File() const;
+		// the name of the pkg volume the file is in, empty for directories
+		[[nodiscard]] std::string_view PkgName() const;
+		[[nodiscard]] size_t ChildCount() const;
+		[[nodiscard]] TreeNode Child(size_t index) const;
+		[[nodiscard]] std::optional<TreeNode> FindChild(std::string_view name) const;
+
+	private:
+		friend class DirectoryTree;
+		TreeNode(const DirectoryTree* tree, uint32_t index) : m_tree(tree), m_index(index) {}
+
+		const DirectoryTree* m_tree;
+		uint32_t m_index;
 	};
 
-	void Insert(const FileRecord& fileRecord);
+	DirectoryTree();
+	DirectoryTree(std::vector<std::string> pkgNames, std::vector<PathRecord> files);
+
+	[[nodiscard]] TreeNode Root() const;
 	[[nodiscard]] std::optional<TreeNode> Find(std::string_view path) const;
+	[[nodiscard]] std::span<const FileRecord> Files() const { return m_files; }
+	[[nodiscard]] std::span<const std::string> PkgNames() const { return m_pkgNames; }
 
 private:
-	TreeNode m_root;
+	static constexpr uint32_t NoFile = UINT32_MAX;
+
+	struct Entry
+	{
+		// the name is a slice of m_names
+		uint32_t NameOffset;
+		uint32_t NameSize;
+		uint32_t Parent;
+		uint32_t FirstChild;
+		uint32_t ChildCount;
+		uint32_t File;
+	};
 
-	TreeNode& CreatePath(std::string_view path);
+	std::vector<Entry> m_nodes;
+	std::string m_names;
+	std::vector<std::string> m_pkgNames;
+	std::vector<FileRecord> m_files;
 };
 
 class Unpacker
 {
 public:
 	explicit Unpacker(std::filesystem::path pkgPath, std::filesystem::path idxPath);
-	UnpackResult<void> Parse();
-	UnpackResult<void> Extract(std::string_view node, const std::filesystem::path& dst, bool preservePath = true) const;
+	// Only resolves the paths of records below one of the prefixes, without any the whole index is parsed.
+	// A prefix without a trailing '/' names a single file, parsing stops once all of those were found.
+	// A prefix of "" or "/" is the start of every path, the whole index is parsed then.
+	// A path that is in more than one idx file is taken from the one whose path sorts last, with or without prefixes.
+	// With more than one thread the idx files are parsed in parallel, the result stays the same.
+	UnpackResult<void> Parse(std::span<const std::string_view> prefixes = {}, size_t threadCount = 1);
+
+	// with more than one thread the records are inflated and written in parallel, grouped by the volume they are in
+	UnpackResult<void> Extract(std::string_view node, const std::filesystem::path& dst, bool preservePath = true, size_t threadCount = 1) const;
+
+	[[nodiscard]] const DirectoryTree& Tree() const { return m_directoryTree; }
 
 private:
 	DirectoryTree m_directoryTree;
 	std::filesystem::path m_pkgPath;
 	std::filesystem::path m_idxPath;
-
-	UnpackResult<void> ExtractFile(const FileRecord& fileRecord, const std::filesystem::path& dst) const;
 };
 
 }  // namespace PotatoAlert::GameFileUnpack
@@ -8,16 +8,27 @@
 #include "Core/Log.hpp"
 #include "Core/Result.hpp"
 #include "Core/String.hpp"
+#include "Core/ThreadPool.hpp"
 #include "Core/Zlib.hpp"
 
 #include "GameFileUnpack/GameFileUnpack.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
 #include <expected>
 #include <filesystem>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <numeric>
 #include <optional>
+#include <ranges>
 #include <string>
 #include <span>
+#include <unordered_map>
 #include <vector>
 
 
@@ -25,18 +36,20 @@ using PotatoAlert::Core::Byte;
 using PotatoAlert::Core::File;
 using PotatoAlert::Core::FileMagic;
 using PotatoAlert::Core::FileMapping;
-using PotatoAlert::Core::Take;
 using PotatoAlert::Core::TakeInto;
-using PotatoAlert::Core::TakeString;
+using PotatoAlert::Core::ThreadPool;
 using PotatoAlert::GameFileUnpack::DirectoryTree;
 using TreeNode = DirectoryTree::TreeNode;
-using PotatoAlert::GameFileUnpack::IdxFile;
 using PotatoAlert::GameFileUnpack::IdxHeader;
-using PotatoAlert::GameFileUnpack::Node;
 using PotatoAlert::GameFileUnpack::FileRecord;
+using PotatoAlert::GameFileUnpack::FileRecordSize;
+using PotatoAlert::GameFileUnpack::HeaderDataOffset;
+using PotatoAlert::GameFileUnpack::HeaderSize;
+using PotatoAlert::GameFileUnpack::NodeSize;
+using PotatoAlert::GameFileUnpack::PathRecord;
+using PotatoAlert::GameFileUnpack::VolumeSize;
 using PotatoAlert::GameFileUnpack::Unpacker;
 using PotatoAlert::GameFileUnpack::UnpackResult;
-using PotatoAlert::GameFileUnpack::Volume;
 
 namespace fs = std::filesystem;
 
@@ -44,461 +57,1006 @@ namespace fs = std::filesystem;
 
 namespace {
 
-static bool ReadNullTerminatedString(std::span<const Byte> data, uint64_t offset, std::string& out)
+static UnpackResult<void> WriteFileData(const fs::path& file, std::span<const Byte> data)
 {
-	size_t length = 0;
-	for (uint64_t i = offset; i < data.size(); i++)
+	// write the data
+	if (const File outFile = File::Open(file, File::Flags::Open | File::Flags::Write | File::Flags::Create))
 	{
-		if (data[i] == Byte{ '\0' })
+		if (outFile.Write(data))
 		{
-			length = i - offset + 1;
-			break;
+			return {};
 		}
 	}
-	if (length == 0)
+	return PA_UNPACK_ERROR("Failed to write data to outfile {} - {}", file, File::LastError());
+}
+
+// Keeps every pkg volume an extraction touches open and mapped until it is done,
+// instead of opening and mapping the whole volume again for every file in it.
+class PkgVolumes
+{
+public:
+	PkgVolumes(const fs::path& pkgPath, std::span<const std::string> pkgNames) : m_pkgPath(pkgPath), m_pkgNames(pkgNames) {}
+
+	PkgVolumes(const PkgVolumes&) = delete;
+	PkgVolumes(PkgVolumes&&) = delete;
+	PkgVolumes& operator=(const PkgVolumes&) = delete;
+	PkgVolumes& operator=(PkgVolumes&&) = delete;
+
+	~PkgVolumes()
 	{
-		LOG_ERROR("Invalid String Length");
-		return false;
+		for (MappedVolume& volume : m_volumes | std::views::values)
+		{
+			volume.Mapping.Unmap(volume.Data.data(), volume.Data.size());
+		}
 	}
 
-	std::span stringData = data.subspan(offset, length);
-	if (!TakeString(stringData, out, length))
+	UnpackResult<std::span<const Byte>> Get(uint32_t pkg)
 	{
-		LOG_ERROR("Failed to read string");
-		return false;
+		if (const auto it = m_volumes.find(pkg); it != m_volumes.end())
+		{
+			return it->second.Data;
+		}
+
+		File file = File::Open(m_pkgPath / m_pkgNames[pkg], File::Flags::Open | File::Flags::Read);
+		if (!file)
+		{
+			return PA_UNPACK_ERROR("Failed to open pkg file for reading: {}", File::LastError());
+		}
+
+		const uint64_t fileSize = file.Size();
+		FileMapping mapping = FileMapping::Open(file, FileMapping::Flags::Read, fileSize);
+		if (!mapping)
+		{
+			return PA_UNPACK_ERROR("Failed to create file mapping: {}", FileMapping::LastError());
+		}
+
+		const void* dataPtr = mapping.Map(FileMapping::Flags::Read, 0, fileSize);
+		if (dataPtr == nullptr)
+		{
+			return PA_UNPACK_ERROR("Failed to map PkgFile into memory: {}", FileMapping::LastError());
+		}
+
+		const std::span data{ static_cast<const Byte*>(dataPtr), fileSize };
+		m_volumes.emplace(pkg, MappedVolume{ std::move(file), std::move(mapping), data });
+		return data;
 	}
 
-	return true;
-}
+private:
+	struct MappedVolume
+	{
+		File Handle;
+		FileMapping Mapping;
+		std::span<const Byte> Data;
+	};
 
-static UnpackResult<void> WriteFileData(const fs::path& file, std::span<const Byte> data)
+	fs::path m_pkgPath;
+	std::span<const std::string> m_pkgNames;
+	std::unordered_map<uint32_t, MappedVolume> m_volumes;
+};
+
+static UnpackResult<void> ExtractFile(const FileRecord& fileRecord, std::span<const Byte> data, const fs::path& dst)
 {
-	// write the data
-	if (const File outFile = File::Open(file, File::Flags::Open | File::Flags::Write | File::Flags::Create))
+	if (fileRecord.Offset + fileRecord.Size > data.size())
 	{
-		if (outFile.Write(data))
+		return PA_UNPACK_ERROR("Got offset ({} - {}) out of size bounds ({})",
+			fileRecord.Offset, fileRecord.Offset + fileRecord.Size, data.size());
+	}
+
+	// check if data is compressed and inflate
+	if (fileRecord.Size != fileRecord.UncompressedSize)
+	{
+		std::vector<Byte> inflated(fileRecord.UncompressedSize);
+		if (!PotatoAlert::Core::Zlib::Inflate(data.subspan(fileRecord.Offset, fileRecord.Size), inflated, false))
 		{
-			return {};
+			return PA_UNPACK_ERROR("File '{}' failed to decompress to its size of {}", dst, fileRecord.UncompressedSize);
 		}
+		return WriteFileData(dst, std::span{ inflated });
 	}
-	return PA_UNPACK_ERROR("Failed to write data to outfile {} - {}", file, File::LastError());
-}
 
+	return WriteFileData(dst, data.subspan(fileRecord.Offset, fileRecord.Size));
 }
 
-std::optional<DirectoryTree::TreeNode> DirectoryTree::Find(std::string_view path) const
+// how much inflated data the workers of a parallel extraction may hold at once
+static constexpr uint64_t g_extractMemoryBudget = 256 * 1024 * 1024;
+// the most records a single task extracts, small enough that the workers stay busy until the end
+static constexpr size_t g_extractBatchSize = 32;
+
+struct ExtractJob
 {
-	const TreeNode* current = &m_root;
-	for (std::string_view part : Core::String::Split(path, "/"))
+	const FileRecord* Record;
+	std::span<const Byte> Data;
+	fs::path Path;
+};
+
+// Blocks workers until the inflated data they want to hold fits into the budget.
+// A record larger than the whole budget is only let through while nothing else is held.
+class MemoryBudget
+{
+public:
+	// holds its share of the budget until it goes out of scope
+	class Reservation
 	{
-		if (part.empty()) continue;
-		if (auto it = current->Nodes.find(part.data()); it != current->Nodes.end())
+	public:
+		Reservation(MemoryBudget& budget, uint64_t size) : m_budget(budget), m_size(size) {}
+
+		Reservation(const Reservation&) = delete;
+		Reservation(Reservation&&) = delete;
+		Reservation& operator=(const Reservation&) = delete;
+		Reservation& operator=(Reservation&&) = delete;
+
+		~Reservation()
 		{
-			current = &it->second;
+			m_budget.Release(m_size);
 		}
-		else
+
+	private:
+		MemoryBudget& m_budget;
+		uint64_t m_size;
+	};
+
+	explicit MemoryBudget(uint64_t limit) : m_limit(limit) {}
+
+	[[nodiscard]] Reservation Acquire(uint64_t size)
+	{
+		std::unique_lock lock(m_mutex);
+		m_condition.wait(lock, [this, size]()
 		{
-			return {};
+			return m_used == 0 || m_used + size <= m_limit;
+		});
+		m_used += size;
+		return Reservation(*this, size);
+	}
+
+private:
+	void Release(uint64_t size)
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			m_used -= size;
 		}
+		m_condition.notify_all();
 	}
 
-	return *current;
+	uint64_t m_limit;
+	uint64_t m_used = 0;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+};
+
+static UnpackResult<void> ExtractBatch(std::span<const ExtractJob> jobs, MemoryBudget& budget, const std::atomic<bool>& failed)
+{
+	for (const ExtractJob& job : jobs)
+	{
+		// another batch already failed, the extraction is going to be reported as failed anyway
+		if (failed.load(std::memory_order_relaxed))
+			return {};
+
+		// stored records are written straight from the mapping and take no memory
+		const uint64_t size = job.Record->Size != job.Record->UncompressedSize ? job.Record->UncompressedSize : 0;
+		const MemoryBudget::Reservation reservation = budget.Acquire(size);
+		PA_TRYV(ExtractFile(*job.Record, job.Data, job.Path));
+	}
+	return {};
 }
 
-void DirectoryTree::Insert(const FileRecord& fileRecord)
+// orders paths as if '/' came before every other character
+static bool ComparePaths(std::string_view a, std::string_view b)
 {
-	if (const size_t pos = fileRecord.Path.rfind('/'); pos != std::string::npos)
+	const size_t size = std::min(a.size(), b.size());
+	for (size_t i = 0; i < size; i++)
 	{
-		TreeNode& node = CreatePath(fileRecord.Path);
-		node.File = fileRecord;
+		if (a[i] == b[i])
+			continue;
+		if (a[i] == '/')
+			return true;
+		if (b[i] == '/')
+			return false;
+		return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[i]);
 	}
-	else
+	return a.size() < b.size();
+}
+
+// the part of the path from offset up to the next '/'
+static std::string_view PathComponent(std::string_view path, size_t offset)
+{
+	const std::string_view rest = path.substr(offset);
+	return rest.substr(0, rest.find('/'));
+}
+
+// the raw layouts of the idx tables, they are read straight out of the mapped file
+struct RawNode
+{
+	uint64_t NameLength;
+	uint64_t NamePtr;
+	uint64_t Id;
+	uint64_t Parent;
+};
+static_assert(sizeof(RawNode) == NodeSize);
+
+struct RawFileRecord
+{
+	uint64_t NodeId;
+	uint64_t VolumeId;
+	uint64_t Offset;
+	uint64_t CompressionInfo;
+	uint32_t Size;
+	uint32_t Crc32;
+	uint64_t UncompressedSize;
+};
+static_assert(sizeof(RawFileRecord) == FileRecordSize);
+
+struct RawVolume
+{
+	uint64_t NameLength;
+	uint64_t NamePtr;
+	uint64_t Id;
+};
+static_assert(sizeof(RawVolume) == VolumeSize);
+
+template<typename T>
+static T ReadRaw(std::span<const Byte> table, size_t index)
+{
+	T value;
+	std::memcpy(&value, table.data() + index * sizeof(T), sizeof(T));
+	return value;
+}
+
+// the length stored with a name counts its terminator
+static std::optional<std::string_view> ReadName(std::span<const Byte> data, uint64_t offset, uint64_t length)
+{
+	if (length == 0 || offset >= data.size() || length > data.size() - offset || data[offset + length - 1] != '\0')
 	{
-		m_root.Nodes[fileRecord.Path] = TreeNode{ .Nodes = {}, .File = fileRecord };
+		return {};
 	}
+
+	const std::string_view name(reinterpret_cast<const char*>(data.data() + offset), length - 1);
+	if (name.find('\0') != std::string_view::npos)
+	{
+		return {};
+	}
+	return name;
 }
 
-DirectoryTree::TreeNode& DirectoryTree::CreatePath(std::string_view path)
+// The start of the paths a lazy parse is restricted to.
+// A prefix without a trailing '/' names a single file, it is done as soon as that file was found.
+// Which of them were found is kept as a mask next to them, one bit per prefix.
+struct PathPrefix
+{
+	std::string Path;
+	std::vector<std::string_view> Parts;
+	bool IsFile;
+};
+
+static constexpr size_t g_maxPathPrefixes = 64;
+
+static std::vector<PathPrefix> MakePathPrefixes(std::span<const std::string_view> prefixes)
 {
-	TreeNode* current = &m_root;
-	for (std::string_view part : Core::String::Split(path, "/"))
+	std::vector<PathPrefix> result;
+	result.reserve(prefixes.size());
+	for (const std::string_view prefix : prefixes)
 	{
-		if (part.empty()) continue;
-		if (auto it = current->Nodes.find(part.data()); it != current->Nodes.end())
+		PathPrefix& pathPrefix = result.emplace_back(PathPrefix{ .Path = {}, .Parts = {}, .IsFile = !prefix.ends_with('/') });
+
+		std::vector<std::string_view> parts;
+		std::string_view rest = prefix;
+		while (!rest.empty())
 		{
-			current = &it->second;
+			const size_t pos = rest.find('/');
+			if (const std::string_view part = rest.substr(0, pos); !part.empty())
+				parts.emplace_back(part);
+			rest = pos == std::string_view::npos ? std::string_view{} : rest.substr(pos + 1);
 		}
-		else
+		pathPrefix.Path = PotatoAlert::Core::String::Join(parts, "/");
+
+		// the parts point into the owned path, which is joined the same way
+		size_t offset = 0;
+		for (const std::string_view part : parts)
 		{
-			// can ignore the 2nd value since we already checked if it exists
-			auto [node, _] = current->Nodes.emplace(part, TreeNode{});
-			current = &node->second;
- 		}
+			pathPrefix.Parts.emplace_back(std::string_view(pathPrefix.Path).substr(offset, part.size()));
+			offset += part.size() + 1;
+		}
 	}
-	return *current;
+	return result;
 }
 
-Unpacker::Unpacker(fs::path pkgPath, fs::path idxPath) : m_pkgPath(std::move(pkgPath)), m_idxPath(std::move(idxPath))
+// only file prefixes can be done, a directory might have more files in the next idx
+static bool AllPrefixesFound(std::span<const PathPrefix> prefixes, uint64_t found)
 {
+	for (size_t i = 0; i < prefixes.size(); i++)
+	{
+		if (!prefixes[i].IsFile || (found & (uint64_t{ 1 } << i)) == 0)
+			return false;
+	}
+	return !prefixes.empty();
 }
 
-UnpackResult<void> Unpacker::Parse()
+// Decides for the nodes of one idx file whether they are below a prefix, remembering it for every node on the way.
+// A record is only resolved into a full path if its node is.
+class NodeMatcher
 {
-	if (!fs::exists(m_idxPath))
+public:
+	struct Entry
 	{
-		return PA_UNPACK_ERROR("IdxPath does not exist: {}", m_idxPath);
+		uint64_t Id;
+		uint64_t Parent;
+		std::string_view Name;
+	};
+
+	NodeMatcher(std::vector<Entry> nodes, std::span<const PathPrefix> prefixes) : m_nodes(std::move(nodes)), m_prefixes(prefixes)
+	{
+		std::ranges::sort(m_nodes, {}, &Entry::Id);
+		m_states.resize(m_nodes.size());
 	}
 
-	std::error_code ec;
-	auto it = fs::recursive_directory_iterator(m_idxPath, ec);
-	if (ec)
+	[[nodiscard]] std::optional<size_t> Find(uint64_t id) const
 	{
-		return PA_UNPACK_ERROR("Failed to iterate IdxPath: {}", ec.message());
+		const auto it = std::ranges::lower_bound(m_nodes, id, {}, &Entry::Id);
+		if (it == m_nodes.end() || it->Id != id)
+			return {};
+		return static_cast<size_t>(it - m_nodes.begin());
 	}
 
-	for (const fs::directory_entry& entry : it)
+	UnpackResult<bool> IsIncluded(size_t index)
 	{
-		if (entry.is_regular_file() && entry.path().extension() == ".idx")
+		if (m_prefixes.empty())
+			return true;
+
+		// walk up until a node that is already decided or the top
+		m_chain.clear();
+		std::optional<size_t> current = index;
+		while (current && !m_states[*current].Known)
 		{
-			if (File file = File::Open(entry.path(), File::Flags::Open | File::Flags::Read))
+			if (m_chain.size() > m_nodes.size())
 			{
-				if (std::vector<Byte> data; file.ReadAll(data))
-				{
-					PA_TRY(idxFile, IdxFile::Parse(data));
-					for (FileRecord& fileRecord : idxFile.Files)
-					{
-						fileRecord.PkgName = idxFile.PkgName;
-						m_directoryTree.Insert(fileRecord);
-					}
-				}
-				else
-				{
-					return PA_UNPACK_ERROR("Failed to read idxFile: {}", File::LastError());
-				}
+				return PA_UNPACK_ERROR("Node {} has a cycle in its parents", m_nodes[index].Id);
 			}
-			else
+			m_chain.push_back(*current);
+			current = Find(m_nodes[*current].Parent);
+		}
+
+		State parent = current ? m_states[*current] : State{ .Known = true, .Included = false, .Depth = 0, .Alive = AllPrefixes() };
+		for (const size_t node : m_chain | std::views::reverse)
+		{
+			State& state = m_states[node];
+			state = State{ .Known = true, .Included = parent.Included, .Depth = parent.Depth + 1, .Alive = 0 };
+			if (!state.Included)
 			{
-				return PA_UNPACK_ERROR("Failed to open idxFile for reading: {}", File::LastError());
+				for (size_t i = 0; i < m_prefixes.size(); i++)
+				{
+					const std::vector<std::string_view>& parts = m_prefixes[i].Parts;
+					if ((parent.Alive & (uint64_t{ 1 } << i)) == 0 || parts.size() < state.Depth || parts[state.Depth - 1] != m_nodes[node].Name)
+						continue;
+					if (parts.size() == state.Depth)
+						state.Included = true;
+					else
+						state.Alive |= uint64_t{ 1 } << i;
+				}
 			}
+			parent = state;
 		}
+
+		return m_states[index].Included;
 	}
 
-	return {};
-}
+	std::string ResolvePath(size_t index)
+	{
+		m_parts.clear();
+		for (std::optional<size_t> current = index; current && m_parts.size() <= m_nodes.size(); current = Find(m_nodes[*current].Parent))
+		{
+			m_parts.emplace_back(m_nodes[*current].Name);
+		}
+		std::ranges::reverse(m_parts);
+		return PotatoAlert::Core::String::Join(m_parts, "/");
+	}
+
+private:
+	struct State
+	{
+		bool Known = false;
+		bool Included = false;
+		size_t Depth = 0;
+		// the prefixes the path up to this node is still the start of
+		uint64_t Alive = 0;
+	};
+
+	[[nodiscard]] uint64_t AllPrefixes() const
+	{
+		return m_prefixes.size() == 64 ? UINT64_MAX : (uint64_t{ 1 } << m_prefixes.size()) - 1;
+	}
+
+	std::vector<Entry> m_nodes;
+	std::vector<State> m_states;
+	std::span<const PathPrefix> m_prefixes;
+	std::vector<size_t> m_chain;
+	std::vector<std::string_view> m_parts;
+};
 
-UnpackResult<void> Unpacker::Extract(std::string_view nodeName, const fs::path& dst, bool preservePath) const
+// everything one idx file contributed to a parse, its records refer to the pkg by their position in the parse
+struct IdxScan
+{
+	UnpackResult<void> Result;
+	uint64_t Found = 0;
+	std::string PkgName;
+	std::vector<PathRecord> Files;
+};
+
+// Maps the idx file and decodes only the records below one of the prefixes, all of them without any prefix.
+// The records are kept in the order of the file.
+static UnpackResult<void> ScanIdxFile(const fs::path& path, std::span<const PathPrefix> prefixes, IdxScan& scan)
 {
-	const std::optional<DirectoryTree::TreeNode> nodeResult = m_directoryTree.Find(nodeName);
-	if (!nodeResult)
+	File file = File::Open(path, File::Flags::Open | File::Flags::Read | File::Flags::ShareRead);
+	if (!file)
 	{
-		return PA_UNPACK_ERROR("There exists no node with name {} in directory tree", nodeName);
+		return PA_UNPACK_ERROR("Failed to open idxFile for reading: {}", File::LastError());
 	}
-	TreeNode rootNode = nodeResult.value();
 
-	std::vector<TreeNode*> stack = { &rootNode };
+	const uint64_t fileSize = file.Size();
+	if (fileSize < HeaderSize)
+	{
+		return PA_UNPACK_ERROR("Invalid IdxFile size {}", fileSize);
+	}
 
-	while (!stack.empty())
+	FileMapping fileMapping = FileMapping::Open(file, FileMapping::Flags::Read, fileSize);
+	if (!fileMapping)
 	{
-		TreeNode* node = stack.back();
-		stack.pop_back();
-		for (auto& child : node->Nodes | std::views::values)
+		return PA_UNPACK_ERROR("Failed to create file mapping: {}", FileMapping::LastError());
+	}
+
+	void* mapping = fileMapping.Map(FileMapping::Flags::Read, 0, fileSize);
+	if (mapping == nullptr)
+	{
+		return PA_UNPACK_ERROR("Failed to map idxFile into memory: {}", FileMapping::LastError());
+	}
+
+	UnpackResult<void> result = [&]() -> UnpackResult<void>
+	{
+		const std::span data{ static_cast<const Byte*>(mapping), fileSize };
+
+		PA_TRY(header, IdxHeader::Parse(data.subspan(0, HeaderSize)));
+		if (header.Endianness != 0x2000000)
+		{
+			return PA_UNPACK_ERROR("Endianness is not 0x20000000");
+		}
+		if (header.Version != 0x40)
 		{
-			stack.push_back(&child);
+			return PA_UNPACK_ERROR("Version is not 0x40");
 		}
 
-		if (node->File)
+		auto getTable = [data](uint64_t ptr, uint64_t count, uint64_t size) -> UnpackResult<std::span<const Byte>>
 		{
-			fs::path filePath;
-			if (!preservePath)
+			const uint64_t offset = ptr + HeaderDataOffset;
+			if (offset > data.size() || count * size > data.size() - offset)
 			{
-				const fs::path rel = fs::relative(node->File->Path, nodeName);
-				if (rel == fs::path("."))
-					filePath = dst / fs::path(nodeName).filename();
-				else
-					filePath = dst / rel;
-			}
-			else
-			{
-				filePath = dst / node->File->Path;
+				return PA_UNPACK_ERROR("Data too small: offset {} + size {} > {}", offset, count * size, data.size());
 			}
+			return data.subspan(offset, count * size);
+		};
 
-			// create output directories if they don't exist yet
-			fs::path outDir = filePath;
-			outDir.remove_filename();
-			if (!fs::exists(outDir))
-			{
-				std::error_code ec;
-				fs::create_directories(outDir, ec);
-				if (ec)
-				{
-					return PA_UNPACK_ERROR("Failed to create game file scripts directory: {}", ec);
-				}
-			}
+		PA_TRY(nodeTable, getTable(header.NodeTablePtr, header.NodeCount, NodeSize));
+		PA_TRY(fileRecordTable, getTable(header.FileRecordTablePtr, header.FileCount, FileRecordSize));
+		PA_TRY(volumeTable, getTable(header.VolumeTablePtr, header.VolumeCount, VolumeSize));
 
-			PA_TRYV(ExtractFile(node->File.value(), filePath));
+		if (header.VolumeCount != 1)
+		{
+			return PA_UNPACK_ERROR("IdxFile had volume count {} != 1", header.VolumeCount);
 		}
-	}
+		const RawVolume volume = ReadRaw<RawVolume>(volumeTable, 0);
+		const std::optional<std::string_view> pkgName = ReadName(data, header.VolumeTablePtr + HeaderDataOffset + volume.NamePtr, volume.NameLength);
+		if (!pkgName)
+		{
+			return PA_UNPACK_ERROR("Failed to get Volume name");
+		}
+		scan.PkgName = *pkgName;
 
-	return {};
-}
+		// the names stay in the mapping, they are only copied for the paths of records that are used
+		std::vector<NodeMatcher::Entry> nodes;
+		nodes.reserve(header.NodeCount);
+		for (uint32_t i = 0; i < header.NodeCount; i++)
+		{
+			const RawNode node = ReadRaw<RawNode>(nodeTable, i);
+			const uint64_t offset = header.NodeTablePtr + HeaderDataOffset + i * NodeSize;
+			const std::optional<std::string_view> name = ReadName(data, offset + node.NamePtr, node.NameLength);
+			if (!name)
+			{
+				return PA_UNPACK_ERROR("Failed to get node name");
+			}
+			nodes.emplace_back(NodeMatcher::Entry{ node.Id, node.Parent, *name });
+		}
+		NodeMatcher matcher(std::move(nodes), prefixes);
 
-UnpackResult<void> Unpacker::ExtractFile(const FileRecord& fileRecord, const fs::path& dst) const
-{
-	if (const File inFile = File::Open(m_pkgPath / fileRecord.PkgName, File::Flags::Open | File::Flags::Read))
-	{
-		uint64_t fileSize = inFile.Size();
-		if (FileMapping mapping = FileMapping::Open(inFile, FileMapping::Flags::Read, fileSize))
+		// a path that is in the file twice is won by its later record, so the records are scanned from the back,
+		// once every prefix was found the ones in front of it can not change the result anymore
+		for (uint32_t i = header.FileCount; i-- > 0;)
 		{
-			if (const void* dataPtr = mapping.Map(FileMapping::Flags::Read, 0, fileSize))
+			const RawFileRecord record = ReadRaw<RawFileRecord>(fileRecordTable, i);
+			const std::optional<size_t> node = matcher.Find(record.NodeId);
+			if (!node)
 			{
-				if (fileRecord.Offset + fileRecord.Size > fileSize)
-				{
-					return PA_UNPACK_ERROR("Got offset ({} - {}) out of size bounds ({})",
-						fileRecord.Offset, fileRecord.Offset + fileRecord.Size, fileSize);
-				}
+				return PA_UNPACK_ERROR("FileRecord references node with id {}, but that doesnt exist", record.NodeId);
+			}
 
-				// check if data is compressed and inflate
-				const std::span data{ static_cast<const Byte*>(dataPtr), fileSize };
-				if (fileRecord.Size != fileRecord.UncompressedSize)
-				{
-					std::vector<Byte> inflated = Core::Zlib::Inflate(
-						data.subspan(fileRecord.Offset, fileRecord.Size), false
-					);
-					if (inflated.size() != fileRecord.UncompressedSize)
-					{
-						return PA_UNPACK_ERROR("File '{}' had invalid size {} != {} after decompression", fileRecord.Path, inflated.size(), fileRecord.UncompressedSize);
-					}
-					return WriteFileData(dst, std::span{ inflated });
-				}
+			PA_TRY(included, matcher.IsIncluded(*node));
+			if (!included)
+				continue;
 
-				return WriteFileData(dst, data.subspan(fileRecord.Offset, fileRecord.Size));
+			const PathRecord& pathRecord = scan.Files.emplace_back(PathRecord
+			{
+				.Path = matcher.ResolvePath(*node),
+				.Record = FileRecord
+				{
+					.NodeId = record.NodeId,
+					.VolumeId = record.VolumeId,
+					.Offset = record.Offset,
+					.CompressionInfo = record.CompressionInfo,
+					.UncompressedSize = record.UncompressedSize,
+					.Size = record.Size,
+					.Crc32 = record.Crc32,
+					.Pkg = 0,
+				},
+			});
+
+			for (size_t j = 0; j < prefixes.size(); j++)
+			{
+				if (prefixes[j].IsFile && prefixes[j].Path == pathRecord.Path)
+					scan.Found |= uint64_t{ 1 } << j;
 			}
-			return PA_UNPACK_ERROR("Failed to map PkgFile into memory: {}", FileMapping::LastError());
+			if (AllPrefixesFound(prefixes, scan.Found))
+				break;
 		}
-		return PA_UNPACK_ERROR("Failed to create file mapping: {}", FileMapping::LastError());
-	}
-	return PA_UNPACK_ERROR("Failed to open pkg file for reading: {}", File::LastError());
+
+		// back into the order of the file, the tree decides between duplicates by it
+		std::ranges::reverse(scan.Files);
+		return {};
+	}();
+
+	fileMapping.Unmap(mapping, fileSize);
+	return result;
 }
 
-UnpackResult<IdxHeader> IdxHeader::Parse(std::span<const Byte> data)
+// The scans of a parse are merged in the order of their files, a path that is in two of them is won by the later one.
+// Going back from the last file, once every prefix was found the files in front can not change the result anymore.
+// This keeps track of the first file that is still needed while the scans finish in any order, so workers can skip the ones in front.
+class ScanFrontier
 {
-	if (data.size() != HeaderSize)
+public:
+	ScanFrontier(std::span<const PathPrefix> prefixes, size_t count) : m_prefixes(prefixes), m_found(count), m_next(count)
 	{
-		return PA_UNPACK_ERROR("Invalid IdxHeader Length");
 	}
 
-	IdxHeader header;
-
-	if (!FileMagic<'I', 'S', 'F', 'P'>(data))
+	[[nodiscard]] bool IsNeeded(size_t index) const
 	{
-		return PA_UNPACK_ERROR("Invalid Idx Header");
+		return index >= m_first.load(std::memory_order_relaxed);
 	}
 
-	TakeInto(data, header.Endianness);
-	TakeInto(data, header.MurmurHash);
-	TakeInto(data, header.Version);
-
-	TakeInto(data, header.NodeCount);
-	TakeInto(data, header.FileCount);
-	TakeInto(data, header.VolumeCount);
+	void Complete(size_t index, uint64_t found)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_found[index] = found;
+		while (m_next > 0 && m_found[m_next - 1] && m_first.load(std::memory_order_relaxed) == 0)
+		{
+			m_next--;
+			m_foundSoFar |= *m_found[m_next];
+			if (AllPrefixesFound(m_prefixes, m_foundSoFar))
+				m_first.store(m_next, std::memory_order_relaxed);
+		}
+	}
 
-	TakeInto(data, header.Unknown);
+private:
+	std::span<const PathPrefix> m_prefixes;
+	std::mutex m_mutex;
+	std::vector<std::optional<uint64_t>> m_found;
+	// every scan from here to the end is complete
+	size_t m_next;
+	uint64_t m_foundSoFar = 0;
+	std::atomic<size_t> m_first = 0;
+};
 
-	TakeInto(data, header.NodeTablePtr);
-	TakeInto(data, header.FileRecordTablePtr);
-	TakeInto(data, header.VolumeTablePtr);
+}
 
-	return header;
+DirectoryTree::DirectoryTree() : DirectoryTree({}, {})
+{
 }
 
-UnpackResult<Node> Node::Parse(std::span<const Byte> data, uint64_t offset, std::span<const Byte> fullData)
+DirectoryTree::DirectoryTree(std::vector<std::string> pkgNames, std::vector<PathRecord> files) : m_pkgNames(std::move(pkgNames))
 {
-	if (data.size() != NodeSize)
+	if (files.size() >= NoFile)
 	{
-		return PA_UNPACK_ERROR("Invalid Node size {}", data.size());
+		LOG_ERROR("Directory tree can not hold {} files", files.size());
+		files.clear();
 	}
 
-	Node node;
+	// the paths are ordered as if '/' came before every other character,
+	// that way everything below a directory ends up next to each other and sorted by name
+	std::vector<uint32_t> order(files.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::ranges::stable_sort(order, [&files](uint32_t a, uint32_t b)
+	{
+		return ComparePaths(files[a].Path, files[b].Path);
+	});
 
-	uint64_t nameLength;
-	if (!TakeInto(data, nameLength))
-		return PA_UNPACK_ERROR("Failed read Node name length");
+	// the records that are below a node and where the name of its children starts in their paths
+	struct Pending
+	{
+		uint32_t Node;
+		size_t Begin;
+		size_t End;
+		size_t Offset;
+	};
+	std::vector<Pending> pending = { { 0, 0, order.size(), 0 } };
+	m_nodes.emplace_back(Entry{ 0, 0, 0, 0, 0, NoFile });
 
-	uint64_t namePtr;
-	if (!TakeInto(data, namePtr))
-		return PA_UNPACK_ERROR("Failed read Node namePtr");
+	// breadth first, so all children of a node are added right after each other
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		const Pending current = pending[i];
+		m_nodes[current.Node].FirstChild = static_cast<uint32_t>(m_nodes.size());
 
-	namePtr += offset;
+		size_t begin = current.Begin;
+		while (begin < current.End)
+		{
+			const std::string_view name = PathComponent(files[order[begin]].Path, current.Offset);
+			size_t end = begin + 1;
+			while (end < current.End && PathComponent(files[order[end]].Path, current.Offset) == name)
+			{
+				end++;
+			}
 
-	if (namePtr >= fullData.size())
-	{
-		return PA_UNPACK_ERROR("Node name pointer {} outside data range {}", namePtr, fullData.size());
-	}
+			Entry child{ static_cast<uint32_t>(m_names.size()), static_cast<uint32_t>(name.size()), current.Node, 0, 0, NoFile };
+			m_names.append(name);
 
-	if (!ReadNullTerminatedString(fullData, namePtr, node.Name))
-	{
-		return PA_UNPACK_ERROR("Failed to get node name");
+			// the paths ending here make this a file, the one inserted last wins
+			const size_t nameEnd = current.Offset + name.size();
+			size_t below = begin;
+			while (below < end && files[order[below]].Path.size() == nameEnd)
+			{
+				child.File = order[below];
+				below++;
+			}
+			if (below < end)
+			{
+				pending.emplace_back(Pending{ static_cast<uint32_t>(m_nodes.size()), below, end, nameEnd + 1 });
+			}
+
+			m_nodes.emplace_back(child);
+			begin = end;
+		}
+
+		m_nodes[current.Node].ChildCount = static_cast<uint32_t>(m_nodes.size()) - m_nodes[current.Node].FirstChild;
 	}
 
-	if (nameLength != node.Name.size())
+	// only the records are kept, their paths are in the nodes now
+	m_files.reserve(files.size());
+	for (PathRecord& file : files)
 	{
-		return PA_UNPACK_ERROR("Node has invalid name length {} != {}", nameLength, node.Name.size());
+		m_files.emplace_back(file.Record);
 	}
+}
 
-	node.Name.pop_back();  // remove the double \0, otherwise we get issues down the line
+DirectoryTree::TreeNode DirectoryTree::Root() const
+{
+	return { this, 0 };
+}
+
+std::optional<DirectoryTree::TreeNode> DirectoryTree::Find(std::string_view path) const
+{
+	TreeNode current = Root();
+	while (!path.empty())
+	{
+		const size_t pos = path.find('/');
+		const std::string_view part = path.substr(0, pos);
+		path = pos == std::string_view::npos ? std::string_view{} : path.substr(pos + 1);
 
-	if (!TakeInto(data, node.Id))
-		return PA_UNPACK_ERROR("Failed read node.Id");
+		if (part.empty()) continue;
+		if (const std::optional<TreeNode> child = current.FindChild(part))
+		{
+			current = *child;
+		}
+		else
+		{
+			return {};
+		}
+	}
 
-	if (!TakeInto(data, node.Parent))
-		return PA_UNPACK_ERROR("Failed read node.Parent");
+	return current;
+}
 
-	return node;
+std::string_view DirectoryTree::TreeNode::Name() const
+{
+	const Entry& entry = m_tree->m_nodes[m_index];
+	return std::string_view(m_tree->m_names).substr(entry.NameOffset, entry.NameSize);
 }
 
-UnpackResult<FileRecord> FileRecord::Parse(std::span<const Byte> data, const std::unordered_map<uint64_t, Node>& nodes)
+std::string DirectoryTree::TreeNode::Path() const
 {
-	if (data.size() != FileRecordSize)
+	std::vector<std::string_view> parts;
+	for (uint32_t index = m_index; index != 0; index = m_tree->m_nodes[index].Parent)
 	{
-		return PA_UNPACK_ERROR("Invalid RawFileRecord size {}", data.size());
+		parts.emplace_back(TreeNode(m_tree, index).Name());
 	}
+	std::ranges::reverse(parts);
+	return PotatoAlert::Core::String::Join(parts, "/");
+}
 
-	FileRecord fileRecord;
+const FileRecord* DirectoryTree::TreeNode::File() const
+{
+	const uint32_t file = m_tree->m_nodes[m_index].File;
+	return file == NoFile ? nullptr : &m_tree->m_files[file];
+}
 
-	TakeInto(data, fileRecord.NodeId);
-	TakeInto(data, fileRecord.VolumeId);
-	TakeInto(data, fileRecord.Offset);
-	TakeInto(data, fileRecord.CompressionInfo);
-	TakeInto(data, fileRecord.Size);
-	TakeInto(data, fileRecord.Crc32);
-	TakeInto(data, fileRecord.UncompressedSize);
-	TakeInto(data, fileRecord.Padding);
+std::string_view DirectoryTree::TreeNode::PkgName() const
+{
+	const FileRecord* file = File();
+	return file == nullptr ? std::string_view{} : m_tree->m_pkgNames[file->Pkg];
+}
 
-	if (!nodes.contains(fileRecord.NodeId))
-	{
-		return PA_UNPACK_ERROR("FileRecord references node with id {}, but that doesnt exist", fileRecord.NodeId);
-	}
+size_t DirectoryTree::TreeNode::ChildCount() const
+{
+	return m_tree->m_nodes[m_index].ChildCount;
+}
+
+DirectoryTree::TreeNode DirectoryTree::TreeNode::Child(size_t index) const
+{
+	return { m_tree, m_tree->m_nodes[m_index].FirstChild + static_cast<uint32_t>(index) };
+}
 
-	std::vector<std::string_view> paths;
-	uint64_t current = fileRecord.NodeId;
+std::optional<DirectoryTree::TreeNode> DirectoryTree::TreeNode::FindChild(std::string_view name) const
+{
+	const Entry& entry = m_tree->m_nodes[m_index];
+	const auto begin = m_tree->m_nodes.begin() + entry.FirstChild;
+	const auto end = begin + entry.ChildCount;
 
-	while (nodes.contains(current))
+	const auto it = std::ranges::lower_bound(begin, end, name, {}, [this](const Entry& child)
+	{
+		return std::string_view(m_tree->m_names).substr(child.NameOffset, child.NameSize);
+	});
+	const TreeNode child(m_tree, static_cast<uint32_t>(it - m_tree->m_nodes.begin()));
+	if (it == end || child.Name() != name)
 	{
-		const Node& node = nodes.at(current);
-		current = node.Parent;
-		paths.emplace_back(node.Name);
+		return {};
 	}
+	return child;
+}
 
-	std::ranges::reverse(paths);
-	fileRecord.Path = Core::String::Join(paths, "/");
-
-	return fileRecord;
+Unpacker::Unpacker(fs::path pkgPath, fs::path idxPath) : m_pkgPath(std::move(pkgPath)), m_idxPath(std::move(idxPath))
+{
 }
 
-UnpackResult<Volume> Volume::Parse(std::span<const Byte> data, uint64_t offset, std::span<const Byte> fullData)
+UnpackResult<void> Unpacker::Parse(std::span<const std::string_view> prefixes, size_t threadCount)
 {
-	if (data.size() < VolumeSize)
+	if (!fs::exists(m_idxPath))
 	{
-		return PA_UNPACK_ERROR("Invalid IdxFile size {}", data.size());
+		return PA_UNPACK_ERROR("IdxPath does not exist: {}", m_idxPath);
 	}
 
-	Volume volume;
+	if (prefixes.size() > g_maxPathPrefixes)
+	{
+		return PA_UNPACK_ERROR("Can not parse with more than {} prefixes", g_maxPathPrefixes);
+	}
+	std::vector<PathPrefix> pathPrefixes = MakePathPrefixes(prefixes);
+	if (std::ranges::any_of(pathPrefixes, [](const PathPrefix& prefix) { return prefix.Parts.empty(); }))
+	{
+		pathPrefixes.clear();
+	}
 
-	uint64_t nameLength;
-	if (!TakeInto(data, nameLength))
-		return PA_UNPACK_ERROR("Failed read Volume name length");
+	std::error_code ec;
+	auto it = fs::recursive_directory_iterator(m_idxPath, ec);
+	if (ec)
+	{
+		return PA_UNPACK_ERROR("Failed to iterate IdxPath: {}", ec.message());
+	}
 
-	uint64_t namePtr;
-	if (!TakeInto(data, namePtr))
-		return PA_UNPACK_ERROR("Failed read Volume namePtr");
+	std::vector<fs::path> idxPaths;
+	for (const fs::directory_entry& entry : it)
+	{
+		if (entry.is_regular_file() && entry.path().extension() == ".idx")
+		{
+			idxPaths.emplace_back(entry.path());
+		}
+	}
+	// the directory order differs between systems, whichever file comes last wins a path that is in two of them
+	std::ranges::sort(idxPaths);
 
-	namePtr += offset;
+	// every file is scanned on its own, so the result is the same no matter in which order the scans finish
+	std::vector<IdxScan> scans(idxPaths.size());
+	ScanFrontier frontier(pathPrefixes, idxPaths.size());
+	const auto scanFile = [&idxPaths, &pathPrefixes, &scans, &frontier](size_t index)
+	{
+		IdxScan& scan = scans[index];
+		if (frontier.IsNeeded(index))
+		{
+			scan.Result = ScanIdxFile(idxPaths[index], pathPrefixes, scan);
+		}
+		frontier.Complete(index, scan.Found);
+	};
 
-	if (namePtr >= fullData.size())
+	// from the last file, that is where a prefix parse can stop
+	if (threadCount <= 1 || idxPaths.size() <= 1)
 	{
-		return PA_UNPACK_ERROR("Volume name pointer {} outside data range {}", namePtr, fullData.size());
+		for (size_t i = idxPaths.size(); i-- > 0;)
+		{
+			scanFile(i);
+		}
 	}
-
-	if (!ReadNullTerminatedString(fullData, namePtr, volume.Name))
+	else
 	{
-		return PA_UNPACK_ERROR("Failed to get Volume name");
+		ThreadPool pool(threadCount);
+		for (size_t i = idxPaths.size(); i-- > 0;)
+		{
+			pool.Enqueue(scanFile, i);
+		}
+		pool.WaitUntilNothingInFlight();
 	}
 
-	if (nameLength != volume.Name.size())
+	// the same files the frontier kept, from the last one back until every prefix was found
+	size_t first = scans.size();
+	uint64_t found = 0;
+	while (first > 0 && !AllPrefixesFound(pathPrefixes, found))
 	{
-		return PA_UNPACK_ERROR("Volume has invalid name length {} != {}", nameLength, volume.Name.size());
+		first--;
+		PA_TRYV(scans[first].Result);
+		found |= scans[first].Found;
 	}
 
-	volume.Name.pop_back();  // remove the double \0, otherwise we get issues down the line
-
-	TakeInto(data, volume.Id);
+	// every pkg name is stored once, no matter how many records are in it
+	std::vector<std::string> pkgNames;
+	std::unordered_map<std::string, uint32_t> pkgIndices;
+	std::vector<PathRecord> files;
+	for (IdxScan& scan : std::span{ scans }.subspan(first))
+	{
+		if (!scan.Files.empty())
+		{
+			const auto [it, inserted] = pkgIndices.try_emplace(scan.PkgName, static_cast<uint32_t>(pkgNames.size()));
+			if (inserted)
+				pkgNames.emplace_back(scan.PkgName);
+			for (PathRecord& file : scan.Files)
+			{
+				file.Record.Pkg = it->second;
+			}
+		}
+		files.insert(files.end(), std::make_move_iterator(scan.Files.begin()), std::make_move_iterator(scan.Files.end()));
+	}
 
-	return volume;
+	m_directoryTree = DirectoryTree(std::move(pkgNames), std::move(files));
+	return {};
 }
 
-UnpackResult<IdxFile> IdxFile::Parse(std::span<const Byte> data)
+UnpackResult<void> Unpacker::Extract(std::string_view nodeName, const fs::path& dst, bool preservePath, size_t threadCount) const
 {
-	const std::span originalData = data;
-
-	if (data.size() < HeaderSize)
+	const std::optional<TreeNode> rootNode = m_directoryTree.Find(nodeName);
+	if (!rootNode)
 	{
-		return PA_UNPACK_ERROR("Invalid IdxFile size {}", data.size());
+		return PA_UNPACK_ERROR("There exists no node with name {} in directory tree", nodeName);
 	}
 
-	IdxFile file;
-
-	// parse headers
-	PA_TRY(header, IdxHeader::Parse(Take(data, HeaderSize)));
+	PkgVolumes volumes(m_pkgPath, m_directoryTree.PkgNames());
+	std::vector<ExtractJob> jobs;
+	std::vector<TreeNode> stack = { *rootNode };
 
-	if (header.Endianness != 0x2000000)
+	while (!stack.empty())
 	{
-		return PA_UNPACK_ERROR("Endianness is not 0x20000000");
+		const TreeNode node = stack.back();
+		stack.pop_back();
+		for (size_t i = 0; i < node.ChildCount(); i++)
+		{
+			stack.push_back(node.Child(i));
+		}
+
+		if (const FileRecord* file = node.File())
+		{
+			const std::string path = node.Path();
+			fs::path filePath;
+			if (!preservePath)
+			{
+				const fs::path rel = fs::relative(path, nodeName);
+				if (rel == fs::path("."))
+					filePath = dst / fs::path(nodeName).filename();
+				else
+					filePath = dst / rel;
+			}
+			else
+			{
+				filePath = dst / path;
+			}
+
+			// create output directories if they don't exist yet
+			fs::path outDir = filePath;
+			outDir.remove_filename();
+			if (!fs::exists(outDir))
+			{
+				std::error_code ec;
+				fs::create_directories(outDir, ec);
+				if (ec)
+				{
+					return PA_UNPACK_ERROR("Failed to create game file scripts directory: {}", ec);
+				}
+			}
+
+			PA_TRY(data, volumes.Get(file->Pkg));
+			jobs.emplace_back(ExtractJob{ file, data, std::move(filePath) });
+		}
 	}
 
-	if (header.Version != 0x40)
+	// every volume is read front to back, one after another
+	std::ranges::sort(jobs, [](const ExtractJob& a, const ExtractJob& b)
 	{
-		return PA_UNPACK_ERROR("Endianness is not 0x40");
+		if (a.Record->Pkg != b.Record->Pkg)
+			return a.Record->Pkg < b.Record->Pkg;
+		return a.Record->Offset < b.Record->Offset;
+	});
+
+	if (threadCount <= 1 || jobs.size() <= 1)
+	{
+		for (const ExtractJob& job : jobs)
+		{
+			PA_TRYV(ExtractFile(*job.Record, job.Data, job.Path));
+		}
+		return {};
 	}
 
-	auto getData = [originalData](uint64_t offset, uint64_t size) -> UnpackResult<std::span<const Byte>>
+	MemoryBudget budget(g_extractMemoryBudget);
+	std::atomic<bool> failed = false;
+	std::vector<std::future<UnpackResult<void>>> batches;
 	{
-		if (offset + size > originalData.size())
+		ThreadPool pool(threadCount);
+
+		// a batch never spans two volumes, so each worker stays within one mapping
+		size_t begin = 0;
+		while (begin < jobs.size())
 		{
-			return PA_UNPACK_ERROR("Data too small: offset {} + size {} > {}", offset, size, originalData.size());
+			size_t end = begin + 1;
+			while (end < jobs.size() && end - begin < g_extractBatchSize && jobs[end].Record->Pkg == jobs[begin].Record->Pkg)
+			{
+				end++;
+			}
+
+			const std::span<const ExtractJob> batch = std::span{ jobs }.subspan(begin, end - begin);
+			batches.emplace_back(pool.Enqueue([batch, &budget, &failed]() -> UnpackResult<void>
+			{
+				UnpackResult<void> result = ExtractBatch(batch, budget, failed);
+				if (!result)
+					failed.store(true, std::memory_order_relaxed);
+				return result;
+			}));
+			begin = end;
 		}
-		return originalData.subspan(offset, size);
-	};
 
-	PA_TRY(nodeData, getData(header.NodeTablePtr + HeaderDataOffset, header.NodeCount * NodeSize));
-	PA_TRY(fileRecordData, getData(header.FileRecordTablePtr + HeaderDataOffset, header.FileCount * FileRecordSize));
-	PA_TRY(volumeData, getData(header.VolumeTablePtr + HeaderDataOffset, header.VolumeCount * VolumeSize));
+		pool.WaitUntilNothingInFlight();
+	}
 
-	// parse nodes
-	for (uint32_t i = 0; i < header.NodeCount; i++)
+	for (std::future<UnpackResult<void>>& batch : batches)
 	{
-		const uint64_t offset = header.NodeTablePtr + HeaderDataOffset + i * NodeSize;
-		PA_TRY(node, Node::Parse(Take(nodeData, NodeSize), offset, originalData));
-		file.Nodes[node.Id] = node;
+		PA_TRYV(batch.get());
 	}
+	return {};
+}
 
-	// parse file records
-	for (uint32_t i = 0; i < header.FileCount; i++)
+UnpackResult<IdxHeader> IdxHeader::Parse(std::span<const Byte> data)
+{
+	if (data.size() != HeaderSize)
 	{
-		PA_TRY(fileRecord, FileRecord::Parse(Take(fileRecordData, FileRecordSize), file.Nodes));
-		file.Files.emplace_back(std::move(fileRecord));
+		return PA_UNPACK_ERROR("Invalid IdxHeader Length");
 	}
 
-	// parse volumes
-	for (uint32_t i = 0; i < header.VolumeCount; i++)
+	IdxHeader header;
+
+	if (!FileMagic<'I', 'S', 'F', 'P'>(data))
 	{
-		const uint64_t offset = header.VolumeTablePtr + HeaderDataOffset + i * VolumeSize;
-		PA_TRY(volume, Volume::Parse(Take(volumeData, VolumeSize), offset, originalData));
-		file.Volumes.emplace_back(std::move(volume));
+		return PA_UNPACK_ERROR("Invalid Idx Header");
 	}
 
-	if (file.Volumes.size() != 1)
-		return PA_UNPACK_ERROR("IdxFile had volume count {} != 1", file.Volumes.size());
-	file.PkgName = file.Volumes[0].Name;
+	TakeInto(data, header.Endianness);
+	TakeInto(data, header.MurmurHash);
+	TakeInto(data, header.Version);
 
-	return file;
+	TakeInto(data, header.NodeCount);
+	TakeInto(data, header.FileCount);
+	TakeInto(data, header.VolumeCount);
+
+	TakeInto(data, header.Unknown);
+
+	TakeInto(data, header.NodeTablePtr);
+	TakeInto(data, header.FileRecordTablePtr);
+	TakeInto(data, header.VolumeTablePtr);
+
+	return header;
 }
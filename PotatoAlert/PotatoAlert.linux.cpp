@@ -69,7 +69,7 @@ int main(int argc, char* argv[])
 	Config config(appDirs.ConfigFile);
 	serviceProvider.Add(config);
 
-	ReplayAnalyzer replayAnalyzer(serviceProvider, appDirs.ReplayVersionsDir);
+	ReplayAnalyzer replayAnalyzer(serviceProvider, appDirs.ReplayVersionsDir, { .CacheDirectory = appDirs.ReplayCacheDir });
 	serviceProvider.Add(replayAnalyzer);
 
 	PotatoClient client(
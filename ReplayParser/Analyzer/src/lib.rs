@@ -1,7 +1,7 @@
 #![no_main]
 
 use std::collections::HashMap;
-use cxx::CxxVector;
+use std::fmt::Display;
 use num_derive::FromPrimitive;
 use num_traits::FromPrimitive;
 use serde_pickle::{DeOptions, Error, Value};
@@ -63,24 +63,25 @@ mod ffi
 
 	extern "Rust"
 	{
-		#[cxx_name = "ParseReceiveDamageStat"]
-		fn parse_receive_damage_stat(data: &CxxVector<u8>) -> ReceiveDamageStatResult;
+		// all blobs of a replay back to back with the size of each, a later stat replaces an earlier one of the same type and flag
+		#[cxx_name = "ParseReceiveDamageStats"]
+		fn parse_receive_damage_stats(data: &[u8], sizes: &[u32]) -> ReceiveDamageStatResult;
 		#[cxx_name = "ParseArenaStateReceivedPlayers"]
-		fn parse_arena_state_received_players(data: &CxxVector<u8>, version: u32) -> OnArenaStateReceivedPlayerResult;
+		fn parse_arena_state_received_players(data: &[u8], version: u32) -> OnArenaStateReceivedPlayerResult;
 	}
 }
 
 use ffi::{OnArenaStateReceivedPlayer, OnArenaStateReceivedPlayerResult, ReceiveDamageStat, ReceiveDamageStatResult};
 
-pub trait ErrorType<T, E>
+pub trait ErrorType<T>
 {
-	fn new_error(err: E) -> Self;
+	fn new_error(err: impl Display) -> Self;
 	fn new_result(res: T) -> Self;
 }
 
-impl ErrorType<Vec<ReceiveDamageStat>, Error> for ReceiveDamageStatResult
+impl ErrorType<Vec<ReceiveDamageStat>> for ReceiveDamageStatResult
 {
-	fn new_error(err: Error) -> Self
+	fn new_error(err: impl Display) -> Self
 	{
 		Self
 		{
@@ -101,9 +102,9 @@ impl ErrorType<Vec<ReceiveDamageStat>, Error> for ReceiveDamageStatResult
 	}
 }
 
-impl ErrorType<Vec<OnArenaStateReceivedPlayer>, Error> for OnArenaStateReceivedPlayerResult
+impl ErrorType<Vec<OnArenaStateReceivedPlayer>> for OnArenaStateReceivedPlayerResult
 {
-	fn new_error(err: Error) -> Self
+	fn new_error(err: impl Display) -> Self
 	{
 		Self
 		{
@@ -124,37 +125,59 @@ impl ErrorType<Vec<OnArenaStateReceivedPlayer>, Error> for OnArenaStateReceivedP
 	}
 }
 
-fn parse_receive_damage_stat(data: &CxxVector<u8>) -> ReceiveDamageStatResult
+type DamageStat = HashMap<(i64, i64), (i64, f32)>;
+
+fn parse_damage_stat(data: &[u8]) -> Result<DamageStat, Error>
 {
-	type DamageStat = HashMap<(i64, i64), (i64, f32)>;
+	let val = serde_pickle::de::value_from_slice(data, DeOptions::default())?;
+	serde_pickle::value::from_value::<DamageStat>(val)
+}
 
-	match serde_pickle::de::value_from_slice(data.as_slice(), DeOptions::default())
-	{
-		Ok(val) => {
-			match serde_pickle::value::from_value::<DamageStat>(val)
+fn to_receive_damage_stats(ds: DamageStat) -> Vec<ReceiveDamageStat>
+{
+	ds.into_iter()
+		.map(|((dmg_type, dmg_flag), (count, dmg))|
+			ReceiveDamageStat
 			{
-				Ok(ds) => {
-					let stats = ds.into_iter()
-						.map(|((dmg_type, dmg_flag), (count, dmg))|
-							ReceiveDamageStat
-							{
-								damage_type: dmg_type,
-								damage_flag: dmg_flag,
-								hits: count,
-								damage: dmg
-							}
-						).collect::<Vec<ReceiveDamageStat>>();
-					ReceiveDamageStatResult::new_result(stats)
-				}
-				Err(err) => {
-					ReceiveDamageStatResult::new_error(err)
-				}
+				damage_type: dmg_type,
+				damage_flag: dmg_flag,
+				hits: count,
+				damage: dmg
 			}
+		).collect::<Vec<ReceiveDamageStat>>()
+}
+
+fn parse_receive_damage_stats(data: &[u8], sizes: &[u32]) -> ReceiveDamageStatResult
+{
+	let mut merged = DamageStat::new();
+	let mut rest = data;
+
+	for &size in sizes
+	{
+		if size as usize > rest.len()
+		{
+			return ReceiveDamageStatResult::new_error("receiveDamageStat sizes exceed the data");
 		}
-		Err(err) => {
-			ReceiveDamageStatResult::new_error(err)
+
+		let (blob, tail) = rest.split_at(size as usize);
+		rest = tail;
+		match parse_damage_stat(blob)
+		{
+			Ok(ds) => {
+				merged.extend(ds);
+			}
+			Err(err) => {
+				return ReceiveDamageStatResult::new_error(err);
+			}
 		}
 	}
+
+	if !rest.is_empty()
+	{
+		return ReceiveDamageStatResult::new_error(format!("receiveDamageStat data has {} bytes after the last blob", rest.len()));
+	}
+
+	ReceiveDamageStatResult::new_result(to_receive_damage_stats(merged))
 }
 
 #[allow(non_camel_case_types)]
@@ -333,7 +356,7 @@ macro_rules! parse_arena_state
 {
 	($data_index:ident, $players:expr, $data:expr) =>
 	{
-		match serde_pickle::de::value_from_slice($data.as_slice(), DeOptions::default())
+		match serde_pickle::de::value_from_slice($data, DeOptions::default())
 		{
 			Ok(val) => {
 				match serde_pickle::value::from_value::<Vec<Player>>(val)
@@ -400,7 +423,7 @@ fn create_version(major: u8, minor: u8, patch: u8, build: u8) -> u32
 	((major as u32) << 0x18) + ((minor as u32) << 0x10) + ((patch as u32) << 0x08) + (build as u32)
 }
 
-fn parse_arena_state_received_players(data: &CxxVector<u8>, version: u32) -> OnArenaStateReceivedPlayerResult
+fn parse_arena_state_received_players(data: &[u8], version: u32) -> OnArenaStateReceivedPlayerResult
 {
 	let mut out_players: Vec<OnArenaStateReceivedPlayer> = vec![];
 
@@ -33,13 +33,8 @@ int main(int argc, char* argv[])
 		return err();
 	}
 
-	PA_TRY_OR_ELSE(replay, Replay::FromFile(argv[1], (AppDataPath("PotatoAlert") / "ReplayVersions")),
-	{
-		LOG_ERROR(error);
-		return err();
-	});
-
-	PA_TRY_OR_ELSE(summary, replay.Analyze(),
+	// visits only the packets the analysis needs, straight from the packet stream
+	PA_TRY_OR_ELSE(summary, AnalyzeReplay(argv[1], AppDataPath("PotatoAlert") / "ReplayVersions"),
 	{
 		LOG_ERROR(error);
 		return err();
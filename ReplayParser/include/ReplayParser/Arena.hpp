@@ -0,0 +1,94 @@
+// Copyright 2024 <github.com/razaqq>
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+
+namespace PotatoAlert::ReplayParser {
+
+// passes everything on to the upstream resource and counts the allocations going through it
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+	explicit CountingResource(std::pmr::memory_resource* upstream) : m_upstream(upstream) {}
+
+	[[nodiscard]] size_t Allocations() const
+	{
+		return m_allocations;
+	}
+
+	[[nodiscard]] size_t Bytes() const
+	{
+		return m_bytes;
+	}
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		m_allocations++;
+		m_bytes += bytes;
+		return m_upstream->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		m_upstream->deallocate(p, bytes, alignment);
+	}
+
+	[[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+	std::pmr::memory_resource* m_upstream;
+	size_t m_allocations = 0;
+	size_t m_bytes = 0;
+};
+
+// A bump allocator for the decoded values of one replay.
+// Values are never freed one by one, everything goes at once when the arena is released or destroyed,
+// so the arena has to outlive every value allocated from it.
+class ReplayArena
+{
+public:
+	explicit ReplayArena(size_t initialSize = 256 * 1024)
+		: m_upstream(std::pmr::new_delete_resource()), m_buffer(initialSize, &m_upstream), m_resource(&m_buffer) {}
+
+	ReplayArena(const ReplayArena&) = delete;
+	ReplayArena& operator=(const ReplayArena&) = delete;
+
+	[[nodiscard]] std::pmr::memory_resource* Resource()
+	{
+		return &m_resource;
+	}
+
+	// the number of allocations served by the arena
+	[[nodiscard]] size_t Allocations() const
+	{
+		return m_resource.Allocations();
+	}
+
+	// the number of blocks the arena had to get from the heap to serve them
+	[[nodiscard]] size_t HeapAllocations() const
+	{
+		return m_upstream.Allocations();
+	}
+
+	[[nodiscard]] size_t HeapBytes() const
+	{
+		return m_upstream.Bytes();
+	}
+
+	void Release()
+	{
+		m_buffer.release();
+	}
+
+private:
+	CountingResource m_upstream;
+	std::pmr::monotonic_buffer_resource m_buffer;
+	CountingResource m_resource;
+};
+
+}  // namespace PotatoAlert::ReplayParser
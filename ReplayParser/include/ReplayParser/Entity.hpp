@@ -6,8 +6,10 @@
 #include "ReplayParser/Result.hpp"
 #include "ReplayParser/Types.hpp"
 
+#include <cstdint>
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -62,11 +64,39 @@ inline PropertyFlag ParseFlag(const std::string& str)
 	return PropertyFlag::Unknown;
 }
 
+// the client methods an analyzer acts on, resolved once per spec so packets are matched by id instead of by name
+#define PA_REPLAY_WELL_KNOWN_METHODS(X)              \
+	X(OnArenaStateReceived, "onArenaStateReceived")  \
+	X(OnBattleEnd, "onBattleEnd")                    \
+	X(ReceiveDamageStat, "receiveDamageStat")        \
+	X(ReceiveDamagesOnShip, "receiveDamagesOnShip")  \
+	X(OnRibbon, "onRibbon")                          \
+	X(OnAchievementEarned, "onAchievementEarned")
+
+enum class WellKnownMethod : uint8_t
+{
+	Unknown,
+#define PA_REPLAY_METHOD_ENUM(Value, Name) Value,
+	PA_REPLAY_WELL_KNOWN_METHODS(PA_REPLAY_METHOD_ENUM)
+#undef PA_REPLAY_METHOD_ENUM
+};
+
+WellKnownMethod ResolveWellKnownMethod(std::string_view name);
+
+typedef uint32_t TypeNameId;
+
+// Maps a method or property name to an id that is the same for equal names across all specs and game versions.
+// Ids stay valid for the lifetime of the process, 0 is never handed out.
+TypeNameId InternName(std::string_view name);
+std::string_view InternedName(TypeNameId id);
+
 struct Property
 {
 	std::string Name;
 	ArgType Type;
 	PropertyFlag Flag;
+	DecodeProgram Program = {};
+	TypeNameId NameId = 0;
 };
 
 struct Method
@@ -74,6 +104,9 @@ struct Method
 	std::string Name;
 	size_t VarLengthHeaderSize;
 	std::vector<ArgType> Args = {};
+	DecodeProgram Program = {};
+	TypeNameId NameId = 0;
+	WellKnownMethod Known = WellKnownMethod::Unknown;
 
 	[[nodiscard]] size_t SortSize() const
 	{
@@ -8,7 +8,10 @@
 
 #include <filesystem>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
@@ -25,8 +28,32 @@ struct EntitySpec
 	std::vector<std::reference_wrapper<const Property>> ClientPropertiesInternal;
 	std::vector<std::reference_wrapper<const Property>> CellProperties;
 	std::vector<std::reference_wrapper<const Property>> BaseProperties;
+	// where each of ClientPropertiesInternal is found in ClientProperties
+	std::vector<uint32_t> ClientPropertiesInternalSlots = {};
+
+	[[nodiscard]] std::optional<size_t> ClientPropertySlot(std::string_view name) const
+	{
+		for (size_t i = 0; i < ClientProperties.size(); i++)
+		{
+			if (ClientProperties[i].get().Name == name)
+			{
+				return i;
+			}
+		}
+		return {};
+	}
 };
 
+using EntitySpecs = std::shared_ptr<const std::vector<EntitySpec>>;
+
 ReplayResult<std::vector<EntitySpec>> ParseScripts(Core::Version version, const fs::path& gameFilePath);
 
+// Returns the specs of a game version from a process-wide cache, only the first request of a version parses the scripts.
+// With persist enabled the compiled specs are also stored next to the scripts and loaded from there on the next start.
+ReplayResult<EntitySpecs> GetEntitySpecs(Core::Version version, const fs::path& gameFilePath, bool persist = true);
+void ClearEntitySpecCache();
+
+std::vector<Byte> SerializeSpecs(const std::vector<EntitySpec>& specs);
+ReplayResult<std::vector<EntitySpec>> DeserializeSpecs(std::span<const Byte> data);
+
 }  // namespace PotatoAlert::ReplayParser
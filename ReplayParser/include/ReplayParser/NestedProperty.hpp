@@ -28,7 +28,7 @@ struct UpdateActionSetRange
 {
 	size_t Start;
 	size_t Stop;
-	std::vector<ArgValue> Values;
+	ArgArray Values;
 };
 
 struct UpdateActionRemoveRange
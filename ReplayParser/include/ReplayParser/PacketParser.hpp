@@ -1,35 +1,236 @@
 // Copyright 2021 <github.com/razaqq>
 #pragma once
 
+#include "Core/Version.hpp"
+
 #include "ReplayParser/GameFiles.hpp"
 #include "ReplayParser/Packets.hpp"
 #include "ReplayParser/PacketCallback.hpp"
 #include "ReplayParser/Result.hpp"
 
+#include <array>
+#include <memory_resource>
+#include <optional>
 #include <span>
-#include <unordered_map>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 
 namespace PotatoAlert::ReplayParser {
 
+// one slot per property of the spec, empty until the property is set
+using PropertySlots = std::pmr::vector<std::optional<ArgValue>>;
+
 struct Entity
 {
 	uint16_t Type;
 	std::reference_wrapper<const EntitySpec> Spec;
-	std::unordered_map<std::string, ArgValue> BasePropertiesValues;
-	std::unordered_map<std::string, ArgValue> ClientPropertiesValues;
-	std::unordered_map<std::string, ArgValue> ClientPropertiesInternalValues;
+	PropertySlots BasePropertiesValues;  // indexed like Spec.BaseProperties
+	PropertySlots ClientPropertiesValues;  // indexed like Spec.ClientProperties
+
+	[[nodiscard]] const ArgValue* ClientProperty(std::string_view name) const
+	{
+		if (const std::optional<size_t> slot = Spec.get().ClientPropertySlot(name))
+		{
+			if (const std::optional<ArgValue>& value = ClientPropertiesValues[*slot])
+			{
+				return &*value;
+			}
+		}
+		return nullptr;
+	}
+};
+
+// All entities of a replay stored contiguously in the order they were created, looked up by id through a sorted index.
+// References are invalidated when an entity is added.
+class EntityTable
+{
+public:
+	[[nodiscard]] Entity* Find(TypeEntityId id);
+	[[nodiscard]] const Entity* Find(TypeEntityId id) const;
+
+	[[nodiscard]] bool Contains(TypeEntityId id) const
+	{
+		return Find(id) != nullptr;
+	}
+
+	Entity& InsertOrAssign(TypeEntityId id, Entity&& entity);
+	// inserts the entity unless there is one with this id already, returns the one in the table
+	Entity& TryEmplace(TypeEntityId id, Entity&& entity);
+
+	// a deep copy with all values allocated from memory
+	[[nodiscard]] EntityTable Clone(std::pmr::memory_resource* memory) const;
+
+	void Clear()
+	{
+		m_entities.clear();
+		m_ids.clear();
+		m_index.clear();
+	}
+
+	[[nodiscard]] size_t Size() const
+	{
+		return m_entities.size();
+	}
+
+	[[nodiscard]] TypeEntityId Id(size_t index) const
+	{
+		return m_ids[index];
+	}
+
+	[[nodiscard]] std::span<const Entity> Entities() const
+	{
+		return m_entities;
+	}
+
+	[[nodiscard]] auto begin() const { return m_entities.begin(); }
+	[[nodiscard]] auto end() const { return m_entities.end(); }
+
+private:
+	struct IndexEntry
+	{
+		TypeEntityId Id;
+		uint32_t Index;
+	};
+
+	std::vector<Entity> m_entities;
+	std::vector<TypeEntityId> m_ids;
+	std::vector<IndexEntry> m_index;  // sorted by id
+};
+
+// The packet types, methods and properties a consumer of the parser cares about.
+struct PacketFilter
+{
+	std::vector<PacketBaseType> PacketTypes;
+	std::vector<std::string_view> Methods;
+	std::vector<std::string_view> Properties;
+};
+
+// A PacketFilter resolved to the method and property ids of every EntitySpec.
+struct PacketInterest
+{
+	uint32_t PacketTypes = 0;
+	std::vector<std::vector<bool>> ClientMethods;
+	std::vector<std::vector<bool>> ClientProperties;
+	std::vector<std::vector<bool>> ClientPropertiesInternal;
+	std::vector<std::vector<bool>> BaseProperties;
+
+	[[nodiscard]] bool Wants(PacketBaseType type) const
+	{
+		return PacketTypes & (1u << static_cast<uint32_t>(type));
+	}
+
+	[[nodiscard]] static bool Wants(const std::vector<std::vector<bool>>& ids, size_t specId, size_t id)
+	{
+		return specId < ids.size() && id < ids[specId].size() && ids[specId][id];
+	}
+};
+
+struct PacketParser;
+
+// The packet ids of one game version resolved to their type and parser once, so the stream is dispatched by id alone.
+class PacketDispatchTable
+{
+public:
+	using ParseFunction = ReplayResult<PacketType>(*)(std::span<const Byte> payload, PacketParser& parser, float clock);
+
+	struct Entry
+	{
+		PacketBaseType Type;
+		ParseFunction Parse;
+	};
+
+	static constexpr uint32_t Size = 64;  // above every packet id in use
+
+	PacketDispatchTable() = default;
+	explicit PacketDispatchTable(Core::Version version);
+
+	// returns nothing for packets which are not parsed
+	[[nodiscard]] const Entry* Find(uint32_t id) const
+	{
+		if (id >= Size || m_entries[id].Parse == nullptr)
+			return nullptr;
+		return &m_entries[id];
+	}
+
+	[[nodiscard]] Core::Version GameVersion() const
+	{
+		return m_version;
+	}
+
+private:
+	std::array<Entry, Size> m_entries = {};
+	Core::Version m_version;
 };
 
 struct PacketParser
 {
-	std::vector<EntitySpec> Specs;
-	std::unordered_map<TypeEntityId, Entity> Entities;
+	std::span<const EntitySpec> Specs;
+	PacketDispatchTable Dispatch;
+	EntityTable Entities;
 	PacketCallbacks Callbacks;
+	// when set, everything outside of it is skipped by size and returned as UnknownPacket
+	std::optional<PacketInterest> Interest;
+	// where the values of packets and entities are allocated from, has to outlive both
+	std::pmr::memory_resource* Memory = std::pmr::get_default_resource();
 };
 
-ReplayResult<PacketType> ParsePacket(std::span<const Byte>& data, PacketParser& parser, Core::Version version);
+// the type a packet is parsed as, nothing for UnknownPacket
+template<typename P>
+constexpr std::optional<PacketBaseType> PacketBaseTypeOf()
+{
+	if constexpr (std::is_same_v<P, BasePlayerCreatePacket>) return PacketBaseType::BasePlayerCreate;
+	else if constexpr (std::is_same_v<P, CellPlayerCreatePacket>) return PacketBaseType::CellPlayerCreate;
+	else if constexpr (std::is_same_v<P, EntityControlPacket>) return PacketBaseType::EntityControl;
+	else if constexpr (std::is_same_v<P, EntityEnterPacket>) return PacketBaseType::EntityEnter;
+	else if constexpr (std::is_same_v<P, EntityLeavePacket>) return PacketBaseType::EntityLeave;
+	else if constexpr (std::is_same_v<P, EntityCreatePacket>) return PacketBaseType::EntityCreate;
+	else if constexpr (std::is_same_v<P, EntityMethodPacket>) return PacketBaseType::EntityMethod;
+	else if constexpr (std::is_same_v<P, EntityPropertyPacket>) return PacketBaseType::EntityProperty;
+	else if constexpr (std::is_same_v<P, PlayerPositionPacket>) return PacketBaseType::PlayerPosition;
+	else if constexpr (std::is_same_v<P, PlayerOrientationPacket>) return PacketBaseType::PlayerOrientation;
+	else if constexpr (std::is_same_v<P, MapPacket>) return PacketBaseType::Map;
+	else if constexpr (std::is_same_v<P, NestedPropertyUpdatePacket>) return PacketBaseType::NestedPropertyUpdate;
+	else if constexpr (std::is_same_v<P, VersionPacket>) return PacketBaseType::Version;
+	else if constexpr (std::is_same_v<P, CameraPacket>) return PacketBaseType::Camera;
+	else if constexpr (std::is_same_v<P, PlayerEntityPacket>) return PacketBaseType::PlayerEntity;
+	else if constexpr (std::is_same_v<P, CruiseStatePacket>) return PacketBaseType::CruiseState;
+	else if constexpr (std::is_same_v<P, CameraFreeLookPacket>) return PacketBaseType::CameraFreeLook;
+	else if constexpr (std::is_same_v<P, CameraModePacket>) return PacketBaseType::CameraMode;
+	else if constexpr (std::is_same_v<P, ResultPacket>) return PacketBaseType::Result;
+	else return std::nullopt;
+}
+
+// packets that have to be parsed to keep the entities up to date, regardless of any filter
+constexpr bool ChangesEntityState(PacketBaseType type)
+{
+	switch (type)
+	{
+		case PacketBaseType::BasePlayerCreate:
+		case PacketBaseType::CellPlayerCreate:
+		case PacketBaseType::EntityCreate:
+		case PacketBaseType::EntityProperty:
+		case PacketBaseType::NestedPropertyUpdate:
+		case PacketBaseType::EntityLeave:
+			return true;
+		default:
+			return false;
+	}
+}
+
+PacketInterest ResolvePacketFilter(const PacketFilter& filter, std::span<const EntitySpec> specs);
+
+// Parses the payload of a packet known to be a P, without going through the dispatch table or the PacketType variant.
+// Nothing is returned for method and property packets that are outside of the interest.
+template<typename P>
+ReplayResult<std::optional<P>> ParsePacketAs(std::span<const Byte> payload, float clock, PacketParser& parser);
+
+
+ReplayResult<PacketType> ParsePacket(std::span<const Byte>& data, PacketParser& parser);
+ReplayResult<PacketType> ParsePacket(std::span<const Byte> payload, uint32_t type, float clock, PacketParser& parser);
+
+// returns the type of packet with this id, or nothing if such packets are not parsed
+std::optional<PacketBaseType> GetPacketBaseType(uint32_t type, Core::Version version);
 
 }  // namespace PotatoAlert::ReplayParser
@@ -0,0 +1,132 @@
+// Copyright 2024 <github.com/razaqq>
+#pragma once
+
+#include "Core/Bytes.hpp"
+
+#include "ReplayParser/PacketParser.hpp"
+#include "ReplayParser/Packets.hpp"
+#include "ReplayParser/Result.hpp"
+
+#include <concepts>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <variant>
+
+
+namespace PotatoAlert::ReplayParser {
+
+template<typename Visitor, typename P>
+concept HandlesPacket = std::is_invocable_v<Visitor&, const P&>;
+
+// visitors that want method or property packets name them in a static Filter(), it replaces the derived one
+template<typename Visitor>
+concept HasPacketFilter = requires
+{
+	{ Visitor::Filter() } -> std::convertible_to<PacketFilter>;
+};
+
+// the packet types the visitor has an overload for
+template<typename Visitor>
+PacketFilter PacketFilterFor()
+{
+	if constexpr (HasPacketFilter<Visitor>)
+	{
+		return Visitor::Filter();
+	}
+	else
+	{
+		PacketFilter filter;
+		[&filter]<typename... Ps>(std::type_identity<std::variant<Ps...>>)
+		{
+			([&filter]()
+			{
+				if constexpr (HandlesPacket<Visitor, Ps> && PacketBaseTypeOf<Ps>().has_value())
+				{
+					filter.PacketTypes.push_back(*PacketBaseTypeOf<Ps>());
+				}
+			}(), ...);
+		}(std::type_identity<PacketType>{});
+		return filter;
+	}
+}
+
+// calls the overload for the packet, packets without one compile down to nothing
+template<typename Visitor, typename P>
+ReplayResult<void> InvokePacketOverload(Visitor& visitor, const P& packet)
+{
+	if constexpr (!HandlesPacket<Visitor, P>)
+	{
+		return {};
+	}
+	else if constexpr (std::is_void_v<std::invoke_result_t<Visitor&, const P&>>)
+	{
+		visitor(packet);
+		return {};
+	}
+	else
+	{
+		return visitor(packet);
+	}
+}
+
+template<typename Visitor>
+ReplayResult<void> InvokePacketVisitor(Visitor& visitor, const PacketType& packet)
+{
+	return std::visit([&visitor]<typename P>(const P& p) -> ReplayResult<void>
+	{
+		return InvokePacketOverload(visitor, p);
+	}, packet);
+}
+
+// packets the visitor either has an overload for or that have to be parsed for the entities anyway
+template<typename Visitor, typename P>
+constexpr bool VisitsPacket()
+{
+	constexpr std::optional<PacketBaseType> type = PacketBaseTypeOf<P>();
+	return type.has_value() && (HandlesPacket<Visitor, P> || ChangesEntityState(*type));
+}
+
+template<typename Visitor, typename P>
+ReplayResult<void> VisitPacketAs(Visitor& visitor, std::span<const Byte> payload, float clock, PacketParser& parser)
+{
+	constexpr PacketBaseType type = *PacketBaseTypeOf<P>();
+	const bool wanted = HandlesPacket<Visitor, P> && (!parser.Interest || parser.Interest->Wants(type));
+	if (!wanted && !ChangesEntityState(type))
+	{
+		return {};
+	}
+
+	PA_TRY(packet, ParsePacketAs<P>(payload, clock, parser));
+	if (wanted && packet)
+	{
+		return InvokePacketOverload(visitor, *packet);
+	}
+	return {};
+}
+
+// Parses a packet of the type and hands it to the visitor. The packet types are unrolled at compile time, only the ones the
+// visitor sees are compared against and each of them calls its parser and the overload directly.
+template<typename Visitor>
+ReplayResult<void> VisitPacket(Visitor& visitor, PacketBaseType type, std::span<const Byte> payload, float clock, PacketParser& parser)
+{
+	ReplayResult<void> result;
+	[&]<typename... Ps>(std::type_identity<std::variant<Ps...>>)
+	{
+		([&]() -> bool
+		{
+			if constexpr (VisitsPacket<Visitor, Ps>())
+			{
+				if (type == *PacketBaseTypeOf<Ps>())
+				{
+					result = VisitPacketAs<Visitor, Ps>(visitor, payload, clock, parser);
+					return true;
+				}
+			}
+			return false;
+		}() || ...);
+	}(std::type_identity<PacketType>{});
+	return result;
+}
+
+}  // namespace PotatoAlert::ReplayParser
@@ -5,10 +5,13 @@
 #include "Core/Math.hpp"
 #include "Core/Preprocessor.hpp"
 
+#include "ReplayParser/Entity.hpp"
 #include "ReplayParser/NestedProperty.hpp"
 #include "ReplayParser/Types.hpp"
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -99,7 +102,7 @@ struct CellPlayerCreatePacket : Packet
 	TypeVehicleId VehicleId;
 	Vec3 Position;
 	Rot3 Rotation;
-	std::unordered_map<std::string, ArgValue> Values;
+	ArgDict Values;
 };
 
 /**
@@ -170,7 +173,7 @@ struct EntityCreatePacket : Packet
 	TypeVehicleId VehicleId;
 	Vec3 Position;
 	Rot3 Rotation;
-	std::unordered_map<std::string, ArgValue> Values;
+	ArgDict Values;
 };
 
 /**
@@ -185,8 +188,10 @@ struct EntityMethodPacket : Packet
 {
 	TypeEntityId EntityId;
 	TypeMethodId MethodId;
-	std::string MethodName;
-	std::vector<ArgValue> Values;
+	TypeNameId MethodNameId;
+	WellKnownMethod Method;
+	std::string_view MethodName;  // points into the EntitySpec
+	ArgArray Values;
 };
 
 /**
@@ -201,7 +206,8 @@ struct EntityPropertyPacket : Packet
 {
 	TypeEntityId EntityId;
 	TypeMethodId MethodId;
-	std::string PropertyName;
+	TypeNameId PropertyNameId;
+	std::string_view PropertyName;  // points into the EntitySpec
 	ArgValue Value;
 };
 
@@ -223,18 +229,16 @@ struct PlayerPositionPacket : Packet
 	bool IsError;
 };
 
-struct Entity;  // forward declare for PacketParser.hpp
-
 /*
  * https://github.com/Monstrofil/replays_unpack/blob/parser2.0/docs/packets/0x22.md
  */
 struct NestedPropertyUpdatePacket : Packet
 {
 	TypeEntityId EntityId;
-	std::string PropertyName;
+	TypeNameId PropertyNameId;
+	std::string_view PropertyName;  // points into the EntitySpec
 	size_t PropertyIndex;
 	PropertyNesting Nesting;
-	Entity* EntityPtr;
 };
 
 struct MapPacket : Packet
@@ -316,6 +320,15 @@ typedef std::variant<
 		PA_CHAIN_COMMA(PA_RP_PACKETS(PA_NOARG))
 > PacketType;
 
+// where a packet is found in the decompressed stream, kept in this layout by the replay cache
+struct PacketIndexEntry
+{
+	uint32_t Offset;  // offset of the payload in the decompressed stream
+	uint32_t Size;
+	uint32_t Type;
+	float Clock;
+};
+
 }  // namespace PotatoAlert::ReplayParser
 
 #pragma clang diagnostic pop
@@ -0,0 +1,115 @@
+// Copyright 2024 <github.com/razaqq>
+#pragma once
+
+#include "Core/Bytes.hpp"
+#include "Core/File.hpp"
+#include "Core/FileMapping.hpp"
+
+#include "ReplayParser/Packets.hpp"
+#include "ReplayParser/Result.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace PotatoAlert::ReplayParser {
+
+// A cache entry mapped into memory, its packet index and stream are read right out of the mapping.
+class CachedReplay
+{
+public:
+	CachedReplay() = default;
+	CachedReplay(CachedReplay&& src) noexcept;
+	CachedReplay(const CachedReplay&) = delete;
+	CachedReplay& operator=(CachedReplay&& src) noexcept;
+	CachedReplay& operator=(const CachedReplay&) = delete;
+	~CachedReplay();
+
+	[[nodiscard]] std::span<const PacketIndexEntry> Index() const
+	{
+		return m_index;
+	}
+
+	[[nodiscard]] std::span<const Byte> Data() const
+	{
+		return m_data;
+	}
+
+private:
+	friend class ReplayCache;
+
+	void Unmap();
+
+	Core::File m_file;
+	Core::FileMapping m_fileMapping;
+	std::span<const Byte> m_mapping;
+	std::span<const PacketIndexEntry> m_index;
+	std::span<const Byte> m_data;
+};
+
+// Keeps the decompressed packet stream and packet index of replays on disk, keyed by the hash of their meta, optionally with their keyframes.
+// A replay found here is neither decrypted nor inflated again, which makes analyzing it a second time mostly packet parsing.
+// Once the entries grow past the size limit, the least recently used ones are removed.
+class ReplayCache
+{
+public:
+	ReplayCache(const std::filesystem::path& directory, uint64_t maxSize);
+
+	ReplayCache(const ReplayCache&) = delete;
+	ReplayCache(ReplayCache&&) = delete;
+	ReplayCache& operator=(const ReplayCache&) = delete;
+	ReplayCache& operator=(ReplayCache&&) = delete;
+
+	// anything that cannot be read is treated as missing, entries failing validation are removed as well
+	bool Load(std::string_view hash, CachedReplay& entry);
+	ReplayResult<void> Store(std::string_view hash, std::span<const PacketIndexEntry> index, std::span<const Byte> data);
+
+	// keyframes serialized by ReplayView, kept next to the entry and removed with it, there are only ones for the last interval stored
+	bool LoadKeyframes(std::string_view hash, float interval, std::vector<Byte>& data);
+	ReplayResult<void> StoreKeyframes(std::string_view hash, float interval, std::span<const Byte> data);
+
+	[[nodiscard]] bool Contains(std::string_view hash) const;
+
+	// the size of all entries on disk
+	[[nodiscard]] uint64_t Size() const;
+
+private:
+	struct Entry
+	{
+		std::string Hash;
+		uint64_t Size;
+		uint64_t KeyframesSize = 0;
+	};
+
+	[[nodiscard]] std::filesystem::path EntryPath(std::string_view hash) const;
+	[[nodiscard]] std::filesystem::path KeyframesPath(std::string_view hash) const;
+	// deletes what is left of the files of the entry, their sizes are only taken off once they are gone
+	bool RemoveFiles(Entry& entry);
+	// false if the files of an entry removed before are still there
+	bool RemovePending(std::string_view hash);
+	void Remove(std::string_view hash);
+	void Trim();
+
+	std::filesystem::path m_directory;
+	uint64_t m_maxSize;
+
+	mutable std::mutex m_mutex;
+	// the most recently used entry is at the front
+	std::list<Entry> m_entries;
+	std::unordered_map<std::string, std::list<Entry>::iterator> m_lookup;
+	// removed entries whose files could not be deleted yet, e.g. because a view still has them open,
+	// they count towards the size until they are gone and are tried again on every trim
+	std::vector<Entry> m_pending;
+	uint64_t m_size = 0;
+	std::atomic<uint64_t> m_tempCounter = 0;
+};
+
+}  // namespace PotatoAlert::ReplayParser
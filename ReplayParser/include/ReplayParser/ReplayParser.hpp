@@ -1,15 +1,18 @@
 // Copyright 2021 <github.com/razaqq>
 #pragma once
 
+#include "Core/Bytes.hpp"
 #include "Core/Json.hpp"
 #include "Core/Version.hpp"
 
+#include "ReplayParser/Arena.hpp"
 #include "ReplayParser/Packets.hpp"
 #include "ReplayParser/PacketParser.hpp"
 #include "ReplayParser/ReplayMeta.hpp"
 #include "ReplayParser/Result.hpp"
 
 #include <filesystem>
+#include <memory>
 #include <span>
 #include <string>
 #include <vector>
@@ -335,11 +338,19 @@ static inline Core::JsonResult<void> ToJson(rapidjson::Writer<rapidjson::StringB
 
 class Replay
 {
+	// declared first, so it outlives every packet and entity value allocated from it
+	std::unique_ptr<ReplayArena> m_arena = std::make_unique<ReplayArena>();
+
 public:
 	std::string MetaString;
 	ReplayMeta Meta;
 	std::vector<PacketType> Packets;
-	std::vector<EntitySpec> Specs;
+	EntitySpecs Specs;
+
+	Replay() = default;
+	Replay(Replay&&) = default;
+	// assigning would replace the arena before the values allocated from it are gone
+	Replay& operator=(Replay&&) = delete;
 
 	static ReplayResult<Replay> FromFile(const std::filesystem::path& filePath, const std::filesystem::path& gameFilePath);
 	[[nodiscard]] ReplayResult<ReplaySummary> Analyze() const;
@@ -350,11 +361,42 @@ public:
 		m_packetParser.Callbacks.Add(callback);
 	}
 
+	[[nodiscard]] const ReplayArena& Arena() const
+	{
+		return *m_arena;
+	}
+
 private:
 	PacketParser m_packetParser;
 };
 
-ReplayResult<ReplaySummary> AnalyzeReplay(const std::filesystem::path& file, const std::filesystem::path& gameFilePath);
+// everything in front of the packet stream, the hash is the same as the one of the ReplaySummary
+struct ReplayHeader
+{
+	std::string MetaString;
+	ReplayMeta Meta;
+	std::string Hash;
+};
+
+// only reads the meta block at the front of the file, the packets are not touched
+ReplayResult<ReplayHeader> ReadReplayHeader(const std::filesystem::path& filePath);
+
+// where the parts of a mapped replay file are, the payload is the encrypted and compressed packet stream
+struct ReplayLayout
+{
+	std::string MetaString;
+	ReplayMeta Meta;
+	uint32_t DecompressedSize;
+	std::span<const Byte> Payload;
+};
+
+// The stages of Replay::FromFile on their own, for tools that want to look at each of them.
+ReplayResult<ReplayLayout> ReadReplayLayout(std::span<const Byte> data);
+// decrypts the whole payload into out, which has to be exactly as long as it
+ReplayResult<void> DecryptReplayPayload(std::span<const Byte> payload, std::span<Byte> out);
+class ReplayCache;
+
+ReplayResult<ReplaySummary> AnalyzeReplay(const std::filesystem::path& file, const std::filesystem::path& gameFilePath, ReplayCache* cache = nullptr);
 bool HasGameScripts(Core::Version gameVersion, const fs::path& gameFilePath);
 
 }  // namespace PotatoAlert::ReplayParser
@@ -0,0 +1,191 @@
+// Copyright 2024 <github.com/razaqq>
+#pragma once
+
+#include "Core/Bytes.hpp"
+
+#include "ReplayParser/Arena.hpp"
+#include "ReplayParser/GameFiles.hpp"
+#include "ReplayParser/PacketParser.hpp"
+#include "ReplayParser/PacketVisitor.hpp"
+#include "ReplayParser/Packets.hpp"
+#include "ReplayParser/ReplayMeta.hpp"
+#include "ReplayParser/ReplayCache.hpp"
+#include "ReplayParser/ReplayParser.hpp"
+#include "ReplayParser/Result.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+
+namespace PotatoAlert::ReplayParser {
+
+// the state of all entities after every packet up to the clock
+struct Keyframe
+{
+	float Clock;
+	uint32_t Position;  // index of the first packet not part of the snapshot
+	EntityTable Entities;
+};
+
+// A replay that keeps the decompressed packet stream and an index over it instead of decoded packets.
+// Packets are only decoded when they are visited.
+class ReplayView
+{
+public:
+	using Visitor = std::function<ReplayResult<void>(const PacketType&)>;
+
+	std::string MetaString;
+	ReplayMeta Meta;
+	EntitySpecs Specs;
+
+	ReplayView() = default;
+	ReplayView(ReplayView&&) = default;
+	// assigning would replace the arenas before the values allocated from them are gone
+	ReplayView& operator=(ReplayView&&) = delete;
+
+	// with a cache the packet stream is taken from there if it has the replay, otherwise it is stored there after decoding it,
+	// the view keeps using the cache for its keyframes, so it has to outlive the view
+	static ReplayResult<ReplayView> FromFile(const std::filesystem::path& filePath, const std::filesystem::path& gameFilePath, ReplayCache* cache = nullptr);
+
+	[[nodiscard]] std::span<const PacketIndexEntry> Index() const
+	{
+		return m_index;
+	}
+
+	[[nodiscard]] std::span<const Byte> Payload(const PacketIndexEntry& entry) const
+	{
+		return m_data.subspan(entry.Offset, entry.Size);
+	}
+
+	// Walks all packets in order and hands the ones matching the filter to the visitor, everything else is skipped by size.
+	// Packets changing the entity state are always looked at, so Entities() holds the filtered properties at every point.
+	ReplayResult<void> Visit(const PacketFilter& filter, const Visitor& visitor);
+
+	// Like above, but the packet types are taken from the overloads of the visitor. The loop is instantiated per visitor,
+	// every packet goes straight to the parser of its type and the overload for it, see VisitPacket.
+	template<typename V>
+	ReplayResult<void> Visit(V& visitor)
+	{
+		BeginVisit(PacketFilterFor<V>());
+		const ReplayResult<void> result = [this, &visitor]() -> ReplayResult<void>
+		{
+			for (const PacketIndexEntry& entry : m_index)
+			{
+				if (const PacketDispatchTable::Entry* dispatch = m_packetParser.Dispatch.Find(entry.Type))
+				{
+					PA_TRYV(VisitPacket(visitor, dispatch->Type, Payload(entry), entry.Clock, m_packetParser));
+				}
+			}
+			return {};
+		}();
+		m_packetParser.Interest.reset();
+		return result;
+	}
+
+	[[nodiscard]] const EntityTable& Entities() const
+	{
+		return m_packetParser.Entities;
+	}
+
+	// Walks the packets changing the entity state once and takes a snapshot of all entities every interval seconds of game time.
+	// A view opened with a cache takes the keyframes from there when it has them for the interval, otherwise they are stored there.
+	ReplayResult<void> BuildKeyframes(float interval = 30.0f);
+
+	[[nodiscard]] std::span<const Keyframe> Keyframes() const
+	{
+		return m_keyframes;
+	}
+
+	// Brings Entities() to their state at the clock, starting from the last keyframe before it and parsing only the packets after that.
+	// Without keyframes this parses everything from the start, a following visit starts from the beginning again.
+	ReplayResult<void> SeekTo(float clock);
+
+	// the keyframes in a form that can be stored next to the replay and loaded instead of building them again
+	[[nodiscard]] std::vector<Byte> SerializeKeyframes() const;
+	ReplayResult<void> LoadKeyframes(std::span<const Byte> data);
+
+	// the values of visited packets and entities, released at the start of every visit
+	[[nodiscard]] const ReplayArena& Arena() const
+	{
+		return *m_arena;
+	}
+
+	ReplayResult<ReplaySummary> Analyze();
+
+	// called for the packets of a visit, not for the ones BuildKeyframes and SeekTo go through again
+	template<typename P>
+	void AddPacketCallback(std::function<void(const P&)> callback)
+	{
+		m_packetParser.Callbacks.Add(callback);
+	}
+
+private:
+	template<typename F>
+	ReplayResult<void> VisitPackets(const PacketFilter& filter, F&& onPacket)
+	{
+		BeginVisit(filter);
+		const ReplayResult<void> result = [this, &onPacket]() -> ReplayResult<void>
+		{
+			for (const PacketIndexEntry& entry : m_index)
+			{
+				const PacketDispatchTable::Entry* dispatch = m_packetParser.Dispatch.Find(entry.Type);
+				if (dispatch == nullptr)
+					continue;
+
+				// these never reach the visitor and do not touch any entity, so they are not even looked at
+				const bool wanted = m_packetParser.Interest->Wants(dispatch->Type);
+				if (!wanted && !ChangesEntityState(dispatch->Type))
+					continue;
+
+				PA_TRY(packet, ParsePacket(Payload(entry), entry.Type, entry.Clock, m_packetParser));
+				if (wanted && !std::holds_alternative<UnknownPacket>(packet))
+				{
+					PA_TRYV(onPacket(packet));
+				}
+			}
+			return {};
+		}();
+		m_packetParser.Interest.reset();
+		return result;
+	}
+
+	void BeginVisit(const PacketFilter& filter);
+
+	// parses the packets changing the entity state from begin on up to the clock, returns the index of the first packet after it
+	ReplayResult<size_t> ApplyEntityPackets(size_t begin, float clock);
+
+	// the stream and index are either decoded into these buffers or mapped from the cache
+	std::vector<Byte> m_decodedData;
+	std::vector<PacketIndexEntry> m_decodedIndex;
+	CachedReplay m_cached;
+	ReplayCache* m_cache = nullptr;
+	std::string m_cacheKey;
+	std::span<const Byte> m_data;
+	std::span<const PacketIndexEntry> m_index;
+	std::unique_ptr<ReplayArena> m_arena = std::make_unique<ReplayArena>();
+	std::unique_ptr<ReplayArena> m_keyframeArena = std::make_unique<ReplayArena>();
+	std::vector<Keyframe> m_keyframes;
+	PacketParser m_packetParser;
+};
+
+// Opens the replay and hands every packet the visitor has an overload for to it, see ReplayView::Visit.
+template<typename V>
+ReplayResult<ReplayView> ParseReplay(const std::filesystem::path& filePath, const std::filesystem::path& gameFilePath, V& visitor)
+{
+	ReplayResult<ReplayView> view = ReplayView::FromFile(filePath, gameFilePath);
+	if (view)
+	{
+		PA_TRYV(view->Visit(visitor));
+	}
+	return view;
+}
+
+}  // namespace PotatoAlert::ReplayParser
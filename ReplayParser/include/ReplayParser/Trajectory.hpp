@@ -0,0 +1,83 @@
+// Copyright 2024 <github.com/razaqq>
+#pragma once
+
+#include "Core/Bytes.hpp"
+#include "Core/Math.hpp"
+
+#include "ReplayParser/Packets.hpp"
+#include "ReplayParser/Result.hpp"
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+
+namespace PotatoAlert::ReplayParser {
+
+class ReplayView;
+
+// The track of one entity as columns, so a whole match is a linear scan over contiguous floats.
+struct Trajectory
+{
+	std::vector<float> Clock;
+	std::vector<float> X;
+	std::vector<float> Y;
+	std::vector<float> Z;
+	std::vector<float> Yaw;
+
+	[[nodiscard]] size_t Size() const
+	{
+		return Clock.size();
+	}
+
+	void Add(float clock, const Vec3& position, float yaw)
+	{
+		Clock.push_back(clock);
+		X.push_back(position.X);
+		Y.push_back(position.Y);
+		Z.push_back(position.Z);
+		Yaw.push_back(yaw);
+	}
+};
+
+// Collects the trajectories of all entities from their position packets.
+// With a tolerance, samples that lie within that distance of the line between their kept neighbours are dropped.
+class TrajectoryStore
+{
+public:
+	explicit TrajectoryStore(float tolerance = 0.0f) : m_tolerance(tolerance) {}
+
+	void Add(TypeEntityId entityId, float clock, const Vec3& position, float yaw);
+	void Add(const PlayerPositionPacket& packet);
+	// only packets without a parent, positions relative to a parent are not tracked
+	void Add(const PlayerOrientationPacket& packet);
+
+	[[nodiscard]] const Trajectory* Find(TypeEntityId entityId) const;
+
+	[[nodiscard]] const std::unordered_map<TypeEntityId, Trajectory>& Trajectories() const
+	{
+		return m_trajectories;
+	}
+
+	// Delta and varint encoded, clocks are stored in milliseconds, positions in centimeters and yaw in 1/10000 radians.
+	[[nodiscard]] std::vector<Byte> Serialize() const;
+	static ReplayResult<TrajectoryStore> Deserialize(std::span<const Byte> data);
+
+private:
+	struct Sample
+	{
+		float Clock;
+		Vec3 Position;
+	};
+
+	float m_tolerance;
+	std::unordered_map<TypeEntityId, Trajectory> m_trajectories;
+	// samples dropped since the last kept one, every later drop has to stay within the tolerance for them too
+	std::unordered_map<TypeEntityId, std::vector<Sample>> m_dropped;
+};
+
+TrajectoryStore CollectTrajectories(std::span<const PacketType> packets, float tolerance = 0.0f);
+ReplayResult<TrajectoryStore> CollectTrajectories(ReplayView& view, float tolerance = 0.0f);
+
+}  // namespace PotatoAlert::ReplayParser
@@ -8,6 +8,7 @@
 #include "ReplayParser/Result.hpp"
 
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <span>
 #include <string>
@@ -101,10 +102,17 @@ struct UserType;
 typedef std::variant<PrimitiveType, ArrayType, FixedDictType, TupleType, UserType, UnknownType> ArgType;
 
 struct ArgValue;
+
+// the containers of a decoded value allocate from the memory resource of the replay it belongs to,
+// copies end up on the default resource unless they are made with CloneValue
+using ArgString = std::pmr::string;
+using ArgBlob = std::pmr::vector<Byte>;
+using ArgArray = std::pmr::vector<ArgValue>;
+using ArgDict = std::pmr::unordered_map<std::pmr::string, ArgValue>;
+
 using ValueVariant = std::variant<
 		uint8_t, uint16_t, uint32_t, uint64_t, int8_t, int16_t, int32_t, int64_t,
-		float, double, Vec2, Vec3, std::string, std::unordered_map<std::string, ArgValue>,
-		std::vector<ArgValue>, std::vector<Byte>>;
+		float, double, Vec2, Vec3, ArgString, ArgDict, ArgArray, ArgBlob>;
 struct ArgValue : ValueVariant
 {
 	using ValueVariant::ValueVariant;
@@ -149,10 +157,52 @@ struct UnknownType {};
 
 typedef std::unordered_map<std::string, ArgType> AliasType;
 
+enum class DecodeOp : uint8_t
+{
+	Primitive,  // a single primitive, strings and blobs included
+	Array,      // Count elements if Flag is set, otherwise a leading count byte, followed by the element
+	Dict,       // Count properties named Names[Name...], followed by them, Flag allows none
+	Tuple,      // Count elements, followed by the element
+	User,       // a leading byte, followed by the wrapped value, Flag makes it nullable
+	Fixed,      // Count values spanning Size bytes, bounds checked once and then decoded without any checks
+	Unknown,
+};
+
+struct DecodeInstruction
+{
+	DecodeOp Op;
+	BasicType Type = BasicType::Uint8;
+	bool Flag = false;
+	uint32_t Count = 0;
+	uint32_t Size = 0;
+	uint32_t Name = 0;
+	uint32_t Length = 1;  // instructions making up this value, itself included
+};
+
+// A sequence of ArgTypes flattened into one array of instructions in pre-order,
+// decoding it gives the same values as ParseValue without walking the type graph.
+struct DecodeProgram
+{
+	std::vector<DecodeInstruction> Code;
+	std::vector<std::string> Names;
+	uint32_t Values = 0;
+};
+
 ReplayResult<ArgType> ParseType(XMLElement* elem, const AliasType& aliases);
 size_t TypeSize(const ArgType& type);
-ReplayResult<ArgValue> ParseValue(std::span<const Byte>& data, const ArgType& type);
-ReplayResult<ArgValue> GetDefaultValue(const ArgType& type);
+ReplayResult<ArgValue> ParseValue(std::span<const Byte>& data, const ArgType& type, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+// consumes exactly the bytes ParseValue would, without decoding anything
+ReplayResult<void> SkipValue(std::span<const Byte>& data, const ArgType& type);
+ReplayResult<ArgValue> GetDefaultValue(const ArgType& type, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+// deep copy of the value with all of its containers allocated from memory
+ArgValue CloneValue(const ArgValue& value, std::pmr::memory_resource* memory);
+
+DecodeProgram CompileDecodeProgram(std::span<const ArgType> types);
+// appends all values of the program to out
+ReplayResult<void> DecodeValues(const DecodeProgram& program, std::span<const Byte>& data, ArgArray& out, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+// decodes a program of exactly one value
+ReplayResult<ArgValue> DecodeValue(const DecodeProgram& program, std::span<const Byte>& data, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+ReplayResult<void> SkipValues(const DecodeProgram& program, std::span<const Byte>& data);
 
 #ifndef NDEBUG
 std::string PrintType(const ArgType& type);
@@ -7,6 +7,7 @@
 #include "ReplayAnalyzerRust.hpp"
 #include "ReplayParser/GameFiles.hpp"
 #include "ReplayParser/ReplayParser.hpp"
+#include "ReplayParser/ReplayView.hpp"
 #include "ReplayParser/Result.hpp"
 #include "ReplayParser/Types.hpp"
 #include "ReplayParser/Variant.hpp"
@@ -22,6 +23,7 @@
 
 using PotatoAlert::Core::Byte;
 using PotatoAlert::ReplayParser::Replay;
+using PotatoAlert::ReplayParser::ReplayView;
 using PotatoAlert::ReplayParser::ReplayResult;
 using namespace PotatoAlert::ReplayParser;
 using namespace PotatoAlert::ReplayAnalyzer;
@@ -62,47 +64,47 @@ enum class Consumable : int8_t
 	ReserveBattery           = 13,
 };
 
-ReplayResult<ReplaySummary> Replay::Analyze() const
-{
-	PA_PROFILE_FUNCTION();
+namespace {
 
-	struct
+// Collects everything needed for the ReplaySummary from the packets it is fed in order.
+class ReplayAnalysis
+{
+public:
+	// everything the analysis looks at, the rest can be skipped
+	static PacketFilter Filter()
 	{
-		std::optional<int8_t> winningTeam = std::nullopt;
-		std::optional<int8_t> playerTeam = std::nullopt;
-		int32_t PlayerEntityId;
-		// int64_t PlayerAvatarId;
-		int64_t PlayerShipId;
-		int64_t PlayerId;
-		std::unordered_map<DamageType, float> DamageDealt;
-		std::unordered_map<DamageType, float> DamagePotential;
-		std::unordered_map<DamageType, float> DamageSpotting;
-		float DamageTaken = 0.0f;
-		std::unordered_map<RibbonType, uint32_t> Ribbons;
-		std::unordered_map<AchievementType, uint32_t> Achievements;
-	} replayData;
+		return PacketFilter
+		{
+			.PacketTypes = { PacketBaseType::BasePlayerCreate, PacketBaseType::CellPlayerCreate, PacketBaseType::EntityMethod },
+			.Methods = { "onArenaStateReceived", "onBattleEnd", "receiveDamageStat", "receiveDamagesOnShip", "onRibbon", "onAchievementEarned" },
+			.Properties = { "teamId", "privateVehicleState", "battleResult" },
+		};
+	}
+
+	explicit ReplayAnalysis(Version version) : m_version(version) {}
 
-	for (const PacketType& pak : Packets)
+	template<typename T>
+	ReplayResult<void> operator()(const T& packet)
 	{
-		const ReplayResult<void> packetResult = std::visit([&replayData, this]<typename Type>(Type&& packet) -> ReplayResult<void>
-		{
-			using T = std::decay_t<Type>;
+		ReplayData& replayData = m_replayData;
 
-			if constexpr (std::is_same_v<T, BasePlayerCreatePacket>)
-			{
-				replayData.PlayerEntityId = packet.EntityId;
+		if constexpr (std::is_same_v<T, BasePlayerCreatePacket>)
+		{
+			replayData.PlayerEntityId = packet.EntityId;
 
-				return {};
-			}
+			return {};
+		}
 
-			if constexpr (std::is_same_v<T, EntityMethodPacket>)
+		if constexpr (std::is_same_v<T, EntityMethodPacket>)
+		{
+			switch (packet.Method)
 			{
-				if (packet.MethodName == "onArenaStateReceived")
+				case WellKnownMethod::OnArenaStateReceived:
 				{
 					bool found = false;
-					PA_TRYV(VariantGet<std::vector<Byte>>(packet, 3, [&replayData, &found, this](const std::vector<Byte>& data) -> ReplayResult<void>
+					PA_TRYV(VariantGet<ArgBlob>(packet, 3, [&replayData, &found, this](const ArgBlob& data) -> ReplayResult<void>
 					{
-						OnArenaStateReceivedPlayerResult result = ParseArenaStateReceivedPlayers(data, Meta.ClientVersionFromExe.GetRaw());
+						OnArenaStateReceivedPlayerResult result = ParseArenaStateReceivedPlayers(rust::Slice<const uint8_t>(data.data(), data.size()), m_version.GetRaw());
 
 						if (result.IsError)
 						{
@@ -130,10 +132,9 @@ ReplayResult<ReplaySummary> Replay::Analyze() const
 
 					return {};
 				}
-
-				if (packet.MethodName == "onBattleEnd")
+				case WellKnownMethod::OnBattleEnd:
 				{
-					if (Meta.ClientVersionFromExe < Version(12, 5, 0))
+					if (m_version < Version(12, 5, 0))
 					{
 						// second arg uint8_t winReason
 						return VariantGet<int8_t>(packet, 0, [&replayData](int8_t team) -> ReplayResult<void>
@@ -143,65 +144,35 @@ ReplayResult<ReplaySummary> Replay::Analyze() const
 							return {};
 						});
 					}
+					break;
 				}
-
-				if (packet.MethodName == "receiveDamageStat")
+				case WellKnownMethod::ReceiveDamageStat:
 				{
 					if (packet.Values.size() != 1)
 					{
 						return PA_REPLAY_ERROR("receiveDamageStat Values were not size 1");
 					}
 
-					return VariantGet<std::vector<Byte>>(packet, 0, [&replayData](const std::vector<Byte>& data) -> ReplayResult<void>
+					// only collected here, all of them go to the rust side at once in Finish
+					return VariantGet<ArgBlob>(packet, 0, [this](const ArgBlob& data) -> ReplayResult<void>
 					{
-						ReceiveDamageStatResult result = ParseReceiveDamageStat(data);
-
-						if (result.IsError)
-						{
-							return PA_REPLAY_ERROR("Failed to parse damage stat: {}", result.Error.c_str());
-						}
-
-						for (const ReceiveDamageStat& stat : result.Value)
-						{
-							const DamageType dmgType = static_cast<DamageType>(stat.DamageType);
-							switch (static_cast<DamageFlag>(stat.DamageFlag))
-							{
-								case DamageFlag::EnemyDamage:
-								{
-									replayData.DamageDealt[dmgType] = stat.Damage;
-									break;
-								}
-								case DamageFlag::PotentialDamage:
-								{
-									replayData.DamagePotential[dmgType] = stat.Damage;
-									break;
-								}
-								case DamageFlag::SpottingDamage:
-								{
-									replayData.DamageSpotting[dmgType] = stat.Damage;
-									break;
-								}
-								default:
-									break;
-							}
-						}
-
+						m_damageStats.insert(m_damageStats.end(), data.begin(), data.end());
+						m_damageStatSizes.push_back(static_cast<uint32_t>(data.size()));
 						return {};
 					});
 				}
-
-				if (packet.MethodName == "receiveDamagesOnShip")
+				case WellKnownMethod::ReceiveDamagesOnShip:
 				{
 					if (packet.EntityId != replayData.PlayerShipId)
 					{
 						return {};  // just ignore this packet if the ids dont match
 					}
 
-					return VariantGet<std::vector<ArgValue>>(packet, 0, [&replayData](const std::vector<ArgValue>& vec) -> ReplayResult<void>
+					return VariantGet<ArgArray>(packet, 0, [&replayData](const ArgArray& vec) -> ReplayResult<void>
 					{
 						for (const ArgValue& elem : vec)
 						{
-							PA_TRYV(VariantGet<std::unordered_map<std::string, ArgValue>>(elem, [&replayData](const std::unordered_map<std::string, ArgValue>& dict) -> ReplayResult<void>
+							PA_TRYV(VariantGet<ArgDict>(elem, [&replayData](const ArgDict& dict) -> ReplayResult<void>
 							{
 								// other field is 'vehicleID' int32_t of the aggressor
 								if (dict.contains("damage"))
@@ -221,11 +192,10 @@ ReplayResult<ReplaySummary> Replay::Analyze() const
 
 					return {};
 				}
-
-				// until 12.0.0, since then its an EntityProperty
-				if (Meta.ClientVersionFromExe < Version(12, 0, 0))
+				case WellKnownMethod::OnRibbon:
 				{
-					if (packet.MethodName == "onRibbon")
+					// until 12.0.0, since then its an EntityProperty
+					if (m_version < Version(12, 0, 0))
 					{
 						return VariantGet<int8_t>(packet, 0, [&replayData](int8_t value) -> ReplayResult<void>
 						{
@@ -242,15 +212,15 @@ ReplayResult<ReplaySummary> Replay::Analyze() const
 							return {};
 						});
 					}
+					break;
 				}
-
-				if (packet.MethodName == "onAchievementEarned")
+				case WellKnownMethod::OnAchievementEarned:
 				{
 					bool discard = true;
 					PA_TRYV(VariantGet<int32_t>(packet, 0, [&replayData, &discard, this](int32_t id) -> ReplayResult<void>
 					{
 						// since version 0.11.4 this is a different id
-						if (Meta.ClientVersionFromExe >= Version(0, 11, 4))
+						if (m_version >= Version(0, 11, 4))
 						{
 							if (id == replayData.PlayerId)
 							{
@@ -284,161 +254,259 @@ ReplayResult<ReplaySummary> Replay::Analyze() const
 
 					return {};
 				}
+				default:
+					break;
 			}
+		}
 
-			if constexpr (std::is_same_v<T, CellPlayerCreatePacket>)
+		if constexpr (std::is_same_v<T, CellPlayerCreatePacket>)
+		{
+			if (packet.Values.contains("teamId"))
 			{
-				if (packet.Values.contains("teamId"))
+				PA_TRYV(VariantGet<int8_t>(packet.Values.at("teamId"), [&replayData](int8_t team) -> ReplayResult<void>
 				{
-					PA_TRYV(VariantGet<int8_t>(packet.Values.at("teamId"), [&replayData](int8_t team) -> ReplayResult<void>
-					{
-						replayData.playerTeam = team;
-						return {};
-					}));
-				}
-
-				return {};
+					replayData.playerTeam = team;
+					return {};
+				}));
 			}
 
 			return {};
-		}, pak);
-		PA_TRYV(packetResult);
+		}
+
+		return {};
 	}
 
-	auto damageDealtValues = std::views::values(replayData.DamageDealt);
-	float damageDealt = std::accumulate(damageDealtValues.begin(), damageDealtValues.end(), 0.0f);
+	ReplayResult<ReplaySummary> Finish(const EntityTable& entities, std::string_view metaString)
+	{
+		ReplayData& replayData = m_replayData;
 
-	auto dmgPotentialValues = std::views::values(replayData.DamagePotential);
-	float damagePotential = std::accumulate(dmgPotentialValues.begin(), dmgPotentialValues.end(), 0.0f);
+		PA_TRYV(ApplyDamageStats());
 
-	auto dmgSpottingValues = std::views::values(replayData.DamageSpotting);
-	float damageSpotting = std::accumulate(dmgSpottingValues.begin(), dmgSpottingValues.end(), 0.0f);
+		auto damageDealtValues = std::views::values(replayData.DamageDealt);
+		float damageDealt = std::accumulate(damageDealtValues.begin(), damageDealtValues.end(), 0.0f);
 
-	MatchOutcome outcome;
+		auto dmgPotentialValues = std::views::values(replayData.DamagePotential);
+		float damagePotential = std::accumulate(dmgPotentialValues.begin(), dmgPotentialValues.end(), 0.0f);
 
-	// since 12.0.0
-	if (Meta.ClientVersionFromExe >= Version(12, 0, 0))
-	{
-		if (!m_packetParser.Entities.contains(replayData.PlayerEntityId))
-		{
-			return PA_REPLAY_ERROR("PacketParser has no entity for PlayerEntityId");
-		}
-		const Entity& playerEntity = m_packetParser.Entities.at(replayData.PlayerEntityId);
-		if (!playerEntity.ClientPropertiesValues.contains("privateVehicleState"))
-		{
-			return PA_REPLAY_ERROR("Player entity is missing ClientProperty 'privateVehicleState'");
-		}
-		const ArgValue& privateVehicleState = playerEntity.ClientPropertiesValues.at("privateVehicleState");
+		auto dmgSpottingValues = std::views::values(replayData.DamageSpotting);
+		float damageSpotting = std::accumulate(dmgSpottingValues.begin(), dmgSpottingValues.end(), 0.0f);
 
-		PA_TRYV(VariantGet<std::unordered_map<std::string, ArgValue>>(privateVehicleState, [&replayData](auto& state) -> ReplayResult<void>
+		MatchOutcome outcome;
+
+		// since 12.0.0
+		if (m_version >= Version(12, 0, 0))
 		{
-			if (!state.contains("ribbons"))
+			const Entity* playerEntity = entities.Find(replayData.PlayerEntityId);
+			if (playerEntity == nullptr)
+			{
+				return PA_REPLAY_ERROR("PacketParser has no entity for PlayerEntityId");
+			}
+			const ArgValue* privateVehicleState = playerEntity->ClientProperty("privateVehicleState");
+			if (privateVehicleState == nullptr)
 			{
-				return PA_REPLAY_ERROR("privateVehicleState is missing key 'ribbons'");
+				return PA_REPLAY_ERROR("Player entity is missing ClientProperty 'privateVehicleState'");
 			}
-			return VariantGet<std::vector<ArgValue>>(state.at("ribbons"), [&replayData](auto& ribbons) -> ReplayResult<void>
+
+			PA_TRYV(VariantGet<ArgDict>(*privateVehicleState, [&replayData](auto& state) -> ReplayResult<void>
 			{
-				for (const ArgValue& ribbonValue : ribbons)
+				if (!state.contains("ribbons"))
+				{
+					return PA_REPLAY_ERROR("privateVehicleState is missing key 'ribbons'");
+				}
+				return VariantGet<ArgArray>(state.at("ribbons"), [&replayData](auto& ribbons) -> ReplayResult<void>
 				{
-					PA_TRYV(VariantGet<std::unordered_map<std::string, ArgValue>>(ribbonValue, [&replayData](auto& ribbon) -> ReplayResult<void>
+					for (const ArgValue& ribbonValue : ribbons)
 					{
-						if (!ribbon.contains("count"))
+						PA_TRYV(VariantGet<ArgDict>(ribbonValue, [&replayData](auto& ribbon) -> ReplayResult<void>
 						{
-							return PA_REPLAY_ERROR("ribbon is missing key 'count'");
-						}
-						uint32_t ribbonCount;
-						PA_TRYV(VariantGet<uint16_t>(ribbon.at("count"), [&ribbonCount](uint16_t count) -> ReplayResult<void>
-						{
-							ribbonCount = count;
-							return {};
-						}));
+							if (!ribbon.contains("count"))
+							{
+								return PA_REPLAY_ERROR("ribbon is missing key 'count'");
+							}
+							uint32_t ribbonCount;
+							PA_TRYV(VariantGet<uint16_t>(ribbon.at("count"), [&ribbonCount](uint16_t count) -> ReplayResult<void>
+							{
+								ribbonCount = count;
+								return {};
+							}));
 
-						if (!ribbon.contains("ribbonId"))
-						{
-							return PA_REPLAY_ERROR("ribbon is missing key 'ribbonId'");
-						}
-						RibbonType ribbonType;
-						PA_TRYV(VariantGet<int8_t>(ribbon.at("ribbonId"), [&ribbonType](int8_t ribbonId) -> ReplayResult<void>
-						{
-							ribbonType = static_cast<RibbonType>(ribbonId);
+							if (!ribbon.contains("ribbonId"))
+							{
+								return PA_REPLAY_ERROR("ribbon is missing key 'ribbonId'");
+							}
+							RibbonType ribbonType;
+							PA_TRYV(VariantGet<int8_t>(ribbon.at("ribbonId"), [&ribbonType](int8_t ribbonId) -> ReplayResult<void>
+							{
+								ribbonType = static_cast<RibbonType>(ribbonId);
+								return {};
+							}));
+							replayData.Ribbons.emplace(ribbonType, ribbonCount);
 							return {};
 						}));
-						replayData.Ribbons.emplace(ribbonType, ribbonCount);
+					}
+					return {};
+				});
+			}));
+		}
+
+		if (m_version >= Version(12, 5, 0))
+		{
+			const auto battleLogic = std::ranges::find_if(entities, [](const Entity& entity)
+			{
+				return entity.Spec.get().Name == "BattleLogic";
+			});
+
+			if (battleLogic == entities.end())
+			{
+				return PA_REPLAY_ERROR("No entity with spec BattleLogic");
+			}
+
+			const ArgValue* battleResult = battleLogic->ClientProperty("battleResult");
+			if (battleResult == nullptr)
+			{
+				return PA_REPLAY_ERROR("Entity BattleLogic is missing 'battleResult'");
+			}
+
+			PA_TRYV(VariantGet<ArgDict>(*battleResult, [&replayData](const auto& map) -> ReplayResult<void>
+			{
+				if (map.contains("winnerTeamId"))
+				{
+					PA_TRYV(VariantGet<int8_t>(map.at("winnerTeamId"), [&replayData](int8_t winnerTeamId) -> ReplayResult<void>
+					{
+						replayData.winningTeam = winnerTeamId;
 						return {};
 					}));
+
+					return {};
 				}
-				return {};
-			});
-		}));
-	}
 
-	if (Meta.ClientVersionFromExe >= Version(12, 5, 0))
-	{
-		const auto battleLogic = std::ranges::find_if(m_packetParser.Entities | std::views::values, [](const Entity& entity)
+				return PA_REPLAY_ERROR("battleResult did not contain 'winnerTeamId'");
+			}));
+		}
+
+		if (!replayData.playerTeam || !replayData.winningTeam || (replayData.winningTeam && replayData.winningTeam == -2))
+		{
+			LOG_TRACE("Failed to determine match outcome, PT {} WT {}", replayData.playerTeam.has_value(), replayData.winningTeam.has_value());
+			outcome = MatchOutcome::Unknown;
+		}
+		else if (replayData.playerTeam.value() == replayData.winningTeam.value())
+		{
+			outcome = MatchOutcome::Win;
+		}
+		else if (replayData.winningTeam.value() == -1)
+		{
+			outcome = MatchOutcome::Draw;
+		}
+		else
 		{
-			return entity.Spec.get().Name == "BattleLogic";
-		});
+			outcome = MatchOutcome::Loss;
+		}
 
-		if (battleLogic == std::end(m_packetParser.Entities | std::views::values))
+		std::string hash;
+		if (!PotatoAlert::Core::Sha256(metaString, hash))
 		{
-			return PA_REPLAY_ERROR("No entity with spec BattleLogic");
+			return PA_REPLAY_ERROR("Failed to get SHA256 hash of replay meta");
 		}
 
-		if (!(*battleLogic).ClientPropertiesValues.contains("battleResult"))
+		return ReplaySummary
+		{
+			.Hash = hash,
+			.Outcome = outcome,
+			.DamageDealt = damageDealt,
+			.DamageTaken = replayData.DamageTaken,
+			.DamageSpotting = damageSpotting,
+			.DamagePotential = damagePotential,
+			.Achievements = replayData.Achievements,
+			.Ribbons = replayData.Ribbons,
+		};
+	}
+
+private:
+	struct ReplayData
+	{
+		std::optional<int8_t> winningTeam = std::nullopt;
+		std::optional<int8_t> playerTeam = std::nullopt;
+		int32_t PlayerEntityId;
+		// int64_t PlayerAvatarId;
+		int64_t PlayerShipId;
+		int64_t PlayerId;
+		std::unordered_map<DamageType, float> DamageDealt;
+		std::unordered_map<DamageType, float> DamagePotential;
+		std::unordered_map<DamageType, float> DamageSpotting;
+		float DamageTaken = 0.0f;
+		std::unordered_map<RibbonType, uint32_t> Ribbons;
+		std::unordered_map<AchievementType, uint32_t> Achievements;
+	};
+
+	// every stat replaces the ones of the same type and flag before it, so only the merged result of all of them counts
+	ReplayResult<void> ApplyDamageStats()
+	{
+		if (m_damageStatSizes.empty())
+			return {};
+
+		const ReceiveDamageStatResult result = ParseReceiveDamageStats(
+			rust::Slice<const uint8_t>(m_damageStats.data(), m_damageStats.size()),
+			rust::Slice<const uint32_t>(m_damageStatSizes.data(), m_damageStatSizes.size()));
+
+		if (result.IsError)
 		{
-			return PA_REPLAY_ERROR("Entity BattleLogic is missing 'battleResult'");
+			return PA_REPLAY_ERROR("Failed to parse damage stat: {}", result.Error.c_str());
 		}
 
-		PA_TRYV(VariantGet<std::unordered_map<std::string, ArgValue>>((*battleLogic).ClientPropertiesValues.at("battleResult"), [&replayData](const auto& map) -> ReplayResult<void>
+		for (const ReceiveDamageStat& stat : result.Value)
 		{
-			if (map.contains("winnerTeamId"))
+			const DamageType dmgType = static_cast<DamageType>(stat.DamageType);
+			switch (static_cast<DamageFlag>(stat.DamageFlag))
 			{
-				PA_TRYV(VariantGet<int8_t>(map.at("winnerTeamId"), [&replayData](int8_t winnerTeamId) -> ReplayResult<void>
+				case DamageFlag::EnemyDamage:
 				{
-					replayData.winningTeam = winnerTeamId;
-					return {};
-				}));
-
-				return {};
+					m_replayData.DamageDealt[dmgType] = stat.Damage;
+					break;
+				}
+				case DamageFlag::PotentialDamage:
+				{
+					m_replayData.DamagePotential[dmgType] = stat.Damage;
+					break;
+				}
+				case DamageFlag::SpottingDamage:
+				{
+					m_replayData.DamageSpotting[dmgType] = stat.Damage;
+					break;
+				}
+				default:
+					break;
 			}
+		}
 
-			return PA_REPLAY_ERROR("battleResult did not contain 'winnerTeamId'");
-		}));
+		return {};
 	}
 
-	if (!replayData.playerTeam || !replayData.winningTeam || (replayData.winningTeam && replayData.winningTeam == -2))
-	{
-		LOG_TRACE("Failed to determine match outcome, PT {} WT {}", replayData.playerTeam.has_value(), replayData.winningTeam.has_value());
-		outcome = MatchOutcome::Unknown;
-	}
-	else if (replayData.playerTeam.value() == replayData.winningTeam.value())
-	{
-		outcome = MatchOutcome::Win;
-	}
-	else if (replayData.winningTeam.value() == -1)
-	{
-		outcome = MatchOutcome::Draw;
-	}
-	else
-	{
-		outcome = MatchOutcome::Loss;
-	}
+	Version m_version;
+	ReplayData m_replayData;
+	// the receiveDamageStat blobs back to back and the size of each
+	std::vector<Byte> m_damageStats;
+	std::vector<uint32_t> m_damageStatSizes;
+};
+
+}  // namespace
 
-	std::string hash;
-	if (!Core::Sha256(MetaString, hash))
+ReplayResult<ReplaySummary> Replay::Analyze() const
+{
+	PA_PROFILE_FUNCTION();
+
+	ReplayAnalysis analysis(Meta.ClientVersionFromExe);
+	for (const PacketType& packet : Packets)
 	{
-		return PA_REPLAY_ERROR("Failed to get SHA256 hash of replay meta");
+		PA_TRYV(std::visit(analysis, packet));
 	}
+	return analysis.Finish(m_packetParser.Entities, MetaString);
+}
 
-	return ReplaySummary
-	{
-		.Hash = hash,
-		.Outcome = outcome,
-		.DamageDealt = damageDealt,
-		.DamageTaken = replayData.DamageTaken,
-		.DamageSpotting = damageSpotting,
-		.DamagePotential = damagePotential,
-		.Achievements = replayData.Achievements,
-		.Ribbons = replayData.Ribbons,
-	};
+ReplayResult<ReplaySummary> ReplayView::Analyze()
+{
+	PA_PROFILE_FUNCTION();
+
+	ReplayAnalysis analysis(Meta.ClientVersionFromExe);
+	PA_TRYV(Visit(analysis));
+	return analysis.Finish(m_packetParser.Entities, MetaString);
 }
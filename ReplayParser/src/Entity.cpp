@@ -7,9 +7,13 @@
 #include "ReplayParser/Entity.hpp"
 #include "ReplayParser/Types.hpp"
 
+#include <deque>
 #include <filesystem>
+#include <mutex>
 #include <ranges>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 
@@ -19,6 +23,19 @@ using namespace PotatoAlert;
 
 namespace {
 
+struct NameTable
+{
+	std::mutex Mutex;
+	std::deque<std::string> Names;  // deque so views into it stay valid when growing
+	std::unordered_map<std::string_view, TypeNameId> Ids;
+};
+
+static NameTable& GetNameTable()
+{
+	[[clang::no_destroy]] static NameTable table;
+	return table;
+}
+
 static ReplayResult<std::vector<Method>> ParseMethodList(XMLElement* elem, const AliasType& aliases)
 {
 	std::vector<Method> methods;
@@ -165,3 +182,39 @@ ReplayResult<void> rp::ParseInterfaces(const fs::path& root, const AliasType& al
 
 	return {};
 }
+
+WellKnownMethod rp::ResolveWellKnownMethod(std::string_view name)
+{
+#define PA_REPLAY_METHOD_RESOLVE(Value, Name) if (name == Name) return WellKnownMethod::Value;
+	PA_REPLAY_WELL_KNOWN_METHODS(PA_REPLAY_METHOD_RESOLVE)
+#undef PA_REPLAY_METHOD_RESOLVE
+	return WellKnownMethod::Unknown;
+}
+
+TypeNameId rp::InternName(std::string_view name)
+{
+	NameTable& table = GetNameTable();
+	std::scoped_lock lock(table.Mutex);
+
+	if (const auto it = table.Ids.find(name); it != table.Ids.end())
+	{
+		return it->second;
+	}
+
+	const std::string& stored = table.Names.emplace_back(name);
+	const TypeNameId id = static_cast<TypeNameId>(table.Names.size());
+	table.Ids.emplace(stored, id);
+	return id;
+}
+
+std::string_view rp::InternedName(TypeNameId id)
+{
+	NameTable& table = GetNameTable();
+	std::scoped_lock lock(table.Mutex);
+
+	if (id == 0 || id > table.Names.size())
+	{
+		return {};
+	}
+	return table.Names[id - 1];
+}
@@ -10,21 +10,417 @@
 #include "ReplayParser/GameFiles.hpp"
 #include "ReplayParser/Result.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <ranges>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 
 namespace rp = PotatoAlert::ReplayParser;
+using PotatoAlert::Core::Byte;
 using PotatoAlert::Core::File;
+using PotatoAlert::Core::Take;
+using PotatoAlert::Core::TakeInto;
+using PotatoAlert::Core::TakeString;
 using PotatoAlert::Core::LoadXml;
 using PotatoAlert::Core::Version;
 using PotatoAlert::Core::XmlResult;
 using namespace PotatoAlert::ReplayParser;
 using namespace tinyxml2;
 
+namespace {
+
+// bump this whenever the layout of the serialized specs changes
+static constexpr uint32_t g_specFormatVersion = 1;
+static constexpr std::array<Byte, 4> g_specMagic = { 'P', 'A', 'E', 'S' };
+static constexpr std::string_view g_specFileName = "entity_specs.bin";
+
+class SpecWriter
+{
+public:
+	explicit SpecWriter(std::vector<Byte>& out) : m_out(out) {}
+
+	template<typename T> requires std::is_trivially_copyable_v<T>
+	void Write(T value)
+	{
+		const size_t pos = m_out.size();
+		m_out.resize(pos + sizeof(T));
+		std::memcpy(m_out.data() + pos, &value, sizeof(T));
+	}
+
+	void Write(std::string_view str)
+	{
+		Write(static_cast<uint32_t>(str.size()));
+		m_out.insert(m_out.end(), str.begin(), str.end());
+	}
+
+	void Write(const std::shared_ptr<ArgType>& type)
+	{
+		Write(static_cast<uint8_t>(type != nullptr));
+		if (type)
+			Write(*type);
+	}
+
+	void Write(const ArgType& type)
+	{
+		Write(static_cast<uint8_t>(type.index()));
+		std::visit([this](const auto& t)
+		{
+			using T = std::decay_t<decltype(t)>;
+			if constexpr (std::is_same_v<T, PrimitiveType>)
+			{
+				Write(static_cast<uint8_t>(t.Type));
+			}
+			else if constexpr (std::is_same_v<T, ArrayType>)
+			{
+				Write(static_cast<uint8_t>(t.Size.has_value()));
+				Write(static_cast<uint32_t>(t.Size.value_or(0)));
+				Write(t.SubType);
+			}
+			else if constexpr (std::is_same_v<T, FixedDictType>)
+			{
+				Write(static_cast<uint8_t>(t.AllowNone));
+				Write(static_cast<uint32_t>(t.Properties.size()));
+				for (const FixedDictProperty& property : t.Properties)
+				{
+					Write(std::string_view(property.Name));
+					Write(property.Type);
+				}
+			}
+			else if constexpr (std::is_same_v<T, TupleType>)
+			{
+				Write(static_cast<uint32_t>(t.Size));
+				Write(t.SubType);
+			}
+			else if constexpr (std::is_same_v<T, UserType>)
+			{
+				Write(static_cast<uint8_t>(t.IsNullable));
+				Write(t.Type);
+			}
+		}, type);
+	}
+
+	void Write(const std::vector<Method>& methods)
+	{
+		Write(static_cast<uint32_t>(methods.size()));
+		for (const Method& method : methods)
+		{
+			Write(std::string_view(method.Name));
+			Write(static_cast<uint32_t>(method.VarLengthHeaderSize));
+			Write(static_cast<uint32_t>(method.Args.size()));
+			for (const ArgType& arg : method.Args)
+			{
+				Write(arg);
+			}
+		}
+	}
+
+	void Write(const std::vector<std::reference_wrapper<const Property>>& properties, const std::vector<Property>& all)
+	{
+		Write(static_cast<uint32_t>(properties.size()));
+		for (const Property& property : properties)
+		{
+			Write(static_cast<uint32_t>(&property - all.data()));
+		}
+	}
+
+private:
+	std::vector<Byte>& m_out;
+};
+
+class SpecReader
+{
+public:
+	explicit SpecReader(std::span<const Byte> data) : m_data(data) {}
+
+	template<typename T> requires std::is_trivially_copyable_v<T>
+	ReplayResult<T> Read()
+	{
+		T value;
+		if (!TakeInto(m_data, value))
+		{
+			return PA_REPLAY_ERROR("Entity specs are truncated.");
+		}
+		return value;
+	}
+
+	ReplayResult<std::string> ReadString()
+	{
+		PA_TRY(size, Read<uint32_t>());
+		std::string str;
+		if (!TakeString(m_data, str, size))
+		{
+			return PA_REPLAY_ERROR("Entity specs are truncated.");
+		}
+		return str;
+	}
+
+	ReplayResult<std::shared_ptr<ArgType>> ReadTypePtr()
+	{
+		PA_TRY(present, Read<uint8_t>());
+		if (!present)
+		{
+			return nullptr;
+		}
+		PA_TRY(type, ReadType());
+		return std::make_shared<ArgType>(std::move(type));
+	}
+
+	ReplayResult<ArgType> ReadType()
+	{
+		PA_TRY(index, Read<uint8_t>());
+		switch (index)
+		{
+			case 0:
+			{
+				PA_TRY(basicType, Read<uint8_t>());
+				if (basicType > static_cast<uint8_t>(BasicType::Blob))
+				{
+					return PA_REPLAY_ERROR("Entity specs have invalid basic type {}.", basicType);
+				}
+				return PrimitiveType{ static_cast<BasicType>(basicType) };
+			}
+			case 1:
+			{
+				ArrayType arr;
+				PA_TRY(hasSize, Read<uint8_t>());
+				PA_TRY(size, Read<uint32_t>());
+				if (hasSize)
+					arr.Size = size;
+				PA_TRYA(arr.SubType, ReadTypePtr());
+				return arr;
+			}
+			case 2:
+			{
+				FixedDictType dict;
+				PA_TRY(allowNone, Read<uint8_t>());
+				dict.AllowNone = allowNone != 0;
+				PA_TRY(count, Read<uint32_t>());
+				dict.Properties.reserve(count);
+				for (uint32_t i = 0; i < count; i++)
+				{
+					PA_TRY(name, ReadString());
+					PA_TRY(type, ReadTypePtr());
+					dict.Properties.emplace_back(FixedDictProperty{ std::move(name), std::move(type) });
+				}
+				return dict;
+			}
+			case 3:
+			{
+				TupleType tuple;
+				PA_TRY(size, Read<uint32_t>());
+				tuple.Size = size;
+				PA_TRYA(tuple.SubType, ReadTypePtr());
+				return tuple;
+			}
+			case 4:
+			{
+				PA_TRY(isNullable, Read<uint8_t>());
+				PA_TRY(type, ReadTypePtr());
+				return UserType{ std::move(type), isNullable != 0 };
+			}
+			case 5:
+				return UnknownType{};
+			default:
+				return PA_REPLAY_ERROR("Entity specs have invalid type index {}.", index);
+		}
+	}
+
+	ReplayResult<std::vector<Method>> ReadMethods()
+	{
+		PA_TRY(count, Read<uint32_t>());
+		std::vector<Method> methods;
+		methods.reserve(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			Method method;
+			PA_TRYA(method.Name, ReadString());
+			PA_TRYA(method.VarLengthHeaderSize, Read<uint32_t>());
+			PA_TRY(argCount, Read<uint32_t>());
+			method.Args.reserve(argCount);
+			for (uint32_t j = 0; j < argCount; j++)
+			{
+				PA_TRY(arg, ReadType());
+				method.Args.emplace_back(std::move(arg));
+			}
+			methods.emplace_back(std::move(method));
+		}
+		return methods;
+	}
+
+	ReplayResult<std::vector<std::reference_wrapper<const Property>>> ReadPropertyRefs(const std::vector<Property>& all)
+	{
+		PA_TRY(count, Read<uint32_t>());
+		std::vector<std::reference_wrapper<const Property>> properties;
+		properties.reserve(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			PA_TRY(index, Read<uint32_t>());
+			if (index >= all.size())
+			{
+				return PA_REPLAY_ERROR("Entity specs have invalid property index {}.", index);
+			}
+			properties.emplace_back(all[index]);
+		}
+		return properties;
+	}
+
+	[[nodiscard]] std::span<const Byte> Remaining() const
+	{
+		return m_data;
+	}
+
+private:
+	std::span<const Byte> m_data;
+};
+
+static void MixFingerprint(uint64_t& fingerprint, uint64_t value)
+{
+	fingerprint = (fingerprint ^ value) * 0x100000001B3ull;
+}
+
+// Identifies the scripts the serialized specs were created from, so re-extracted scripts invalidate them.
+// Covers every file the spec parser reads, entities.xml and everything in entity_defs.
+static uint64_t ScriptsFingerprint(const fs::path& scriptsDir)
+{
+	std::error_code ec;
+	std::vector<fs::path> files = { scriptsDir / "entities.xml" };
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(scriptsDir / "entity_defs", ec))
+	{
+		if (entry.is_regular_file(ec))
+			files.emplace_back(entry.path());
+	}
+	if (ec)
+		return 0;
+	// the directory order differs between systems
+	std::ranges::sort(files);
+
+	uint64_t fingerprint = 0xCBF29CE484222325ull;
+	for (const fs::path& file : files)
+	{
+		const uint64_t size = fs::file_size(file, ec);
+		if (ec)
+			return 0;
+		const fs::file_time_type time = fs::last_write_time(file, ec);
+		if (ec)
+			return 0;
+
+		MixFingerprint(fingerprint, std::hash<std::string>{}(fs::relative(file, scriptsDir, ec).generic_string()));
+		MixFingerprint(fingerprint, size);
+		MixFingerprint(fingerprint, static_cast<uint64_t>(time.time_since_epoch().count()));
+	}
+	// 0 means there are no scripts to fingerprint
+	return fingerprint == 0 ? 1 : fingerprint;
+}
+
+static ReplayResult<std::vector<EntitySpec>> LoadSpecs(const fs::path& file, uint64_t fingerprint)
+{
+	const File specFile = File::Open(file, File::Flags::Open | File::Flags::Read | File::Flags::ShareRead);
+	if (!specFile)
+	{
+		return PA_REPLAY_ERROR("Failed to open entity specs: {}", File::LastError());
+	}
+
+	std::vector<Byte> data;
+	if (!specFile.ReadAll(data))
+	{
+		return PA_REPLAY_ERROR("Failed to read entity specs: {}", File::LastError());
+	}
+
+	std::span<const Byte> span{ data };
+	if (span.size() < g_specMagic.size() || std::memcmp(Take(span, g_specMagic.size()).data(), g_specMagic.data(), g_specMagic.size()) != 0)
+	{
+		return PA_REPLAY_ERROR("Entity specs have invalid file signature.");
+	}
+
+	uint32_t formatVersion;
+	uint64_t storedFingerprint;
+	if (!TakeInto(span, formatVersion) || !TakeInto(span, storedFingerprint))
+	{
+		return PA_REPLAY_ERROR("Entity specs are truncated.");
+	}
+
+	if (formatVersion != g_specFormatVersion || storedFingerprint != fingerprint)
+	{
+		return PA_REPLAY_ERROR("Entity specs are outdated.");
+	}
+
+	return DeserializeSpecs(span);
+}
+
+static bool StoreSpecs(const fs::path& file, const std::vector<EntitySpec>& specs, uint64_t fingerprint)
+{
+	std::vector<Byte> data;
+	data.insert(data.end(), g_specMagic.begin(), g_specMagic.end());
+	SpecWriter writer(data);
+	writer.Write(g_specFormatVersion);
+	writer.Write(fingerprint);
+	const std::vector<Byte> payload = SerializeSpecs(specs);
+	data.insert(data.end(), payload.begin(), payload.end());
+
+	// write to a temporary file first, so other processes never see a partial file
+	fs::path tmp = file;
+	tmp += ".tmp";
+	{
+		const File specFile = File::Open(tmp, File::Flags::Create | File::Flags::Truncate | File::Flags::Write);
+		if (!specFile || !specFile.Write<Byte>(data))
+		{
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(tmp, file, ec);
+	return !ec;
+}
+
+struct SpecCacheEntry
+{
+	std::mutex Mutex;
+	EntitySpecs Specs;
+};
+
+static std::mutex g_specCacheMutex;
+[[clang::no_destroy]] static std::unordered_map<std::string, std::shared_ptr<SpecCacheEntry>> g_specCache;
+
+// only the client methods and the properties are ever decoded from a replay
+static void CompileSpec(EntitySpec& spec)
+{
+	for (Method& method : spec.ClientMethods)
+	{
+		method.Program = CompileDecodeProgram(method.Args);
+		method.NameId = InternName(method.Name);
+		method.Known = ResolveWellKnownMethod(method.Name);
+	}
+	for (Property& property : spec.AllProperties)
+	{
+		property.Program = CompileDecodeProgram({ &property.Type, 1 });
+		property.NameId = InternName(property.Name);
+	}
+
+	// internal properties are stored in the slots of the client properties, those with no such slot point past the end
+	spec.ClientPropertiesInternalSlots.clear();
+	for (const Property& internal : spec.ClientPropertiesInternal)
+	{
+		const auto slot = std::ranges::find_if(spec.ClientProperties, [&internal](const Property& property)
+		{
+			return &property == &internal;
+		});
+		spec.ClientPropertiesInternalSlots.emplace_back(static_cast<uint32_t>(slot - spec.ClientProperties.begin()));
+	}
+}
+
+}  // namespace
+
 static ReplayResult<std::unordered_map<std::string, ArgType>> ParseAliases(const fs::path& path)
 {
 	XMLDocument doc;
@@ -124,6 +520,7 @@ ReplayResult<std::vector<EntitySpec>> rp::ParseScripts(Version version, const fs
 
 			std::ranges::stable_sort(clientProperties, [](const Property& a, const Property& b) -> bool { return TypeSize(a.Type) < TypeSize(b.Type); });
 			specs.emplace_back(EntitySpec{ entityName, std::move(merged.BaseMethods), std::move(merged.CellMethods), std::move(merged.ClientMethods), std::move(merged.Properties), clientProperties, clientPropertiesInternal, cellProperties, baseProperties });
+			CompileSpec(specs.back());
 		}
 	}
 	else
@@ -133,3 +530,129 @@ ReplayResult<std::vector<EntitySpec>> rp::ParseScripts(Version version, const fs
 
 	return specs;
 }
+
+std::vector<Byte> rp::SerializeSpecs(const std::vector<EntitySpec>& specs)
+{
+	std::vector<Byte> data;
+	SpecWriter writer(data);
+
+	writer.Write(static_cast<uint32_t>(specs.size()));
+	for (const EntitySpec& spec : specs)
+	{
+		writer.Write(std::string_view(spec.Name));
+		writer.Write(spec.BaseMethods);
+		writer.Write(spec.CellMethods);
+		writer.Write(spec.ClientMethods);
+
+		writer.Write(static_cast<uint32_t>(spec.AllProperties.size()));
+		for (const Property& property : spec.AllProperties)
+		{
+			writer.Write(std::string_view(property.Name));
+			writer.Write(property.Type);
+			writer.Write(static_cast<uint32_t>(property.Flag));
+		}
+
+		writer.Write(spec.ClientProperties, spec.AllProperties);
+		writer.Write(spec.ClientPropertiesInternal, spec.AllProperties);
+		writer.Write(spec.CellProperties, spec.AllProperties);
+		writer.Write(spec.BaseProperties, spec.AllProperties);
+	}
+
+	return data;
+}
+
+ReplayResult<std::vector<EntitySpec>> rp::DeserializeSpecs(std::span<const Byte> data)
+{
+	SpecReader reader(data);
+
+	PA_TRY(count, reader.Read<uint32_t>());
+	std::vector<EntitySpec> specs;
+	specs.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		EntitySpec spec;
+		PA_TRYA(spec.Name, reader.ReadString());
+		PA_TRYA(spec.BaseMethods, reader.ReadMethods());
+		PA_TRYA(spec.CellMethods, reader.ReadMethods());
+		PA_TRYA(spec.ClientMethods, reader.ReadMethods());
+
+		PA_TRY(propertyCount, reader.Read<uint32_t>());
+		spec.AllProperties.reserve(propertyCount);
+		for (uint32_t j = 0; j < propertyCount; j++)
+		{
+			Property property;
+			PA_TRYA(property.Name, reader.ReadString());
+			PA_TRYA(property.Type, reader.ReadType());
+			PA_TRY(flag, reader.Read<uint32_t>());
+			property.Flag = static_cast<PropertyFlag>(flag);
+			spec.AllProperties.emplace_back(std::move(property));
+		}
+
+		PA_TRYA(spec.ClientProperties, reader.ReadPropertyRefs(spec.AllProperties));
+		PA_TRYA(spec.ClientPropertiesInternal, reader.ReadPropertyRefs(spec.AllProperties));
+		PA_TRYA(spec.CellProperties, reader.ReadPropertyRefs(spec.AllProperties));
+		PA_TRYA(spec.BaseProperties, reader.ReadPropertyRefs(spec.AllProperties));
+
+		CompileSpec(spec);
+		specs.emplace_back(std::move(spec));
+	}
+
+	if (!reader.Remaining().empty())
+	{
+		return PA_REPLAY_ERROR("Entity specs have {} trailing bytes.", reader.Remaining().size());
+	}
+
+	return specs;
+}
+
+ReplayResult<EntitySpecs> rp::GetEntitySpecs(Version version, const fs::path& gameFilePath, bool persist)
+{
+	const fs::path versionDir = gameFilePath / version.ToString(".", true);
+	const std::string key = versionDir.string();
+
+	std::shared_ptr<SpecCacheEntry> entry;
+	{
+		std::scoped_lock lock(g_specCacheMutex);
+		std::shared_ptr<SpecCacheEntry>& slot = g_specCache[key];
+		if (!slot)
+			slot = std::make_shared<SpecCacheEntry>();
+		entry = slot;
+	}
+
+	// parsing happens under the lock of the entry only, so other versions are not blocked
+	std::scoped_lock lock(entry->Mutex);
+	if (entry->Specs)
+	{
+		return entry->Specs;
+	}
+
+	const fs::path scriptsDir = versionDir / "scripts";
+	const fs::path specFile = versionDir / g_specFileName;
+	const uint64_t fingerprint = ScriptsFingerprint(scriptsDir);
+
+	if (persist && fingerprint != 0)
+	{
+		if (ReplayResult<std::vector<EntitySpec>> specs = LoadSpecs(specFile, fingerprint); specs && !specs->empty())
+		{
+			entry->Specs = std::make_shared<const std::vector<EntitySpec>>(std::move(*specs));
+			return entry->Specs;
+		}
+	}
+
+	PA_TRY(specs, ParseScripts(version, gameFilePath));
+
+	if (persist && fingerprint != 0)
+	{
+		// failing to store them is fine, the scripts directory might not be writable
+		StoreSpecs(specFile, specs, fingerprint);
+	}
+
+	entry->Specs = std::make_shared<const std::vector<EntitySpec>>(std::move(specs));
+	return entry->Specs;
+}
+
+void rp::ClearEntitySpecCache()
+{
+	std::scoped_lock lock(g_specCacheMutex);
+	g_specCache.clear();
+}
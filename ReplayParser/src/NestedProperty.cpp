@@ -15,6 +15,9 @@
 namespace rp = PotatoAlert::ReplayParser;
 using PotatoAlert::ReplayParser::ArrayType;
 using PotatoAlert::ReplayParser::ArgType;
+using PotatoAlert::ReplayParser::ArgArray;
+using PotatoAlert::ReplayParser::ArgDict;
+using PotatoAlert::ReplayParser::ArgString;
 using PotatoAlert::ReplayParser::ArgValue;
 using PotatoAlert::ReplayParser::BitReader;
 using PotatoAlert::ReplayParser::FixedDictType;
@@ -46,18 +49,18 @@ ReplayResult<PropertyNesting> GetNestedUpdateCommand(bool isSlice, const ArgType
 			std::span<const Byte> remaining = bitReader.GetAll();
 
 			const FixedDictProperty prop = arg.Properties[entryIndex];
-			PA_TRY(propValue, ParseValue(remaining, *prop.Type));
 
 			// we can safely use std::get here
-			std::unordered_map<std::string, ArgValue>& value = std::get<std::unordered_map<std::string, ArgValue>>(*argValue);
-			value.insert_or_assign(prop.Name, propValue);
+			ArgDict& value = std::get<ArgDict>(*argValue);
+			PA_TRY(propValue, ParseValue(remaining, *prop.Type, value.get_allocator().resource()));
+			const auto it = value.insert_or_assign(ArgString(prop.Name, value.get_allocator()), std::move(propValue)).first;
 
-			return PropertyNesting{ {}, UpdateActionSetKey{ prop.Name, propValue } };
+			return PropertyNesting{ {}, UpdateActionSetKey{ prop.Name, it->second } };
 		}
 		else if constexpr (std::is_same_v<T, ArrayType>)
 		{
 			// we can safely use std::get here
-			std::vector<ArgValue>& value = std::get<std::vector<ArgValue>>(*argValue);
+			ArgArray& value = std::get<ArgArray>(*argValue);
 
 			if (isSlice)
 			{
@@ -76,7 +79,7 @@ ReplayResult<PropertyNesting> GetNestedUpdateCommand(bool isSlice, const ArgType
 
 				std::span<const Byte> remaining = bitReader.GetAll();
 
-				auto SliceInsert = []<typename T>(size_t idx1, size_t idx2, std::vector<T>& target, const std::vector<T>& source)
+				auto SliceInsert = [](size_t idx1, size_t idx2, ArgArray& target, const ArgArray& source)
 				{
 					if (idx1 != idx2)
 					{
@@ -85,21 +88,21 @@ ReplayResult<PropertyNesting> GetNestedUpdateCommand(bool isSlice, const ArgType
 
 					for (size_t i = 0; i < source.size(); i++)
 					{
-						target.insert(target.begin() + std::min(idx1 + i, target.size()), source[i]);
+						target.insert(target.begin() + std::min(idx1 + i, target.size()), CloneValue(source[i], target.get_allocator().resource()));
 					}
 				};
 
 				if (remaining.empty())
 				{
-					const std::vector<ArgValue> a{};
+					const ArgArray a{};
 					SliceInsert(idx1, idx2, value, a);
 					return PropertyNesting{ {}, UpdateActionRemoveRange{ idx1, idx2 } };
 				}
 
-				std::vector<ArgValue> newValues;
+				ArgArray newValues(value.get_allocator());
 				while (!remaining.empty())
 				{
-					PA_TRY(newValue, ParseValue(remaining, *arg.SubType));
+					PA_TRY(newValue, ParseValue(remaining, *arg.SubType, value.get_allocator().resource()));
 					newValues.emplace_back(std::move(newValue));
 				}
 
@@ -122,15 +125,15 @@ ReplayResult<PropertyNesting> GetNestedUpdateCommand(bool isSlice, const ArgType
 					return PA_REPLAY_ERROR("FixedDict ArrayType has no data remaining");
 				}
 
-				std::vector<ArgValue> newValues;
+				ArgArray newValues(value.get_allocator());
 				while (!remaining.empty())
 				{
-					PA_TRY(newValue, ParseValue(remaining, *arg.SubType));
+					PA_TRY(newValue, ParseValue(remaining, *arg.SubType, value.get_allocator().resource()));
 					newValues.emplace_back(std::move(newValue));
 				}
 				newValues.erase(newValues.begin());
 
-				value[index] = newValues;
+				value[index] = std::move(newValues);
 
 				return PropertyNesting{ {}, UpdateActionSetElement{ index, value[index] } };
 			}
@@ -163,11 +166,11 @@ ReplayResult<PropertyNesting> rp::GetNestedPropertyPath(bool isSlice, const ArgT
 
 			const ArgValue* newArgValue;
 
-			ReplayResult<void> setRes = VariantGet<std::unordered_map<std::string, ArgValue>>(*argValue, [&prop, &newArgValue](const auto& value) -> ReplayResult<void>
+			ReplayResult<void> setRes = VariantGet<ArgDict>(*argValue, [&prop, &newArgValue](const auto& value) -> ReplayResult<void>
 			{
-				if (value.contains(prop.Name))
+				if (const auto it = value.find(ArgString(prop.Name)); it != value.end())
 				{
-					newArgValue = &value.at(prop.Name);
+					newArgValue = &it->second;
 					return {};
 				}
 				return PA_REPLAY_ERROR("Nested Property Path does not contain property named ''", prop.Name);
@@ -184,13 +187,13 @@ ReplayResult<PropertyNesting> rp::GetNestedPropertyPath(bool isSlice, const ArgT
 		}
 		else if constexpr (std::is_same_v<T, ArrayType>)
 		{
-			// this always has to be std::vector<ArgValue>
-			std::vector<ArgValue>& arr = std::get<std::vector<ArgValue>>(*argValue);
+			// this always has to be ArgArray
+			ArgArray& arr = std::get<ArgArray>(*argValue);
 			const size_t propIndex = bitReader.Get(BitReader::BitsRequired(static_cast<int>(arr.size())));
 
 			if (propIndex == arr.size())
 			{
-				PA_TRY(value, GetDefaultValue(*arg.SubType));
+				PA_TRY(value, GetDefaultValue(*arg.SubType, arr.get_allocator().resource()));
 				arr.push_back(std::move(value));
 			}
 			else if (propIndex > arr.size())
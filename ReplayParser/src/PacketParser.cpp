@@ -2,6 +2,7 @@
 
 #include "Core/Bytes.hpp"
 #include "Core/Log.hpp"
+#include "Core/TypeTraits.hpp"
 #include "Core/Version.hpp"
 
 #include "ReplayParser/BitReader.hpp"
@@ -9,15 +10,18 @@
 #include "ReplayParser/Packets.hpp"
 #include "ReplayParser/Result.hpp"
 
+#include <algorithm>
 #include <cstdint>
 #include <optional>
 #include <span>
 #include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
 
 using namespace PotatoAlert::ReplayParser;
+using PotatoAlert::Core::always_false;
 using PotatoAlert::Core::FormatBytes;
 using PotatoAlert::Core::Take;
 using PotatoAlert::Core::TakeInto;
@@ -70,11 +74,14 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 	return false;
 }
 
-[[maybe_unused]] static ReplayResult<EntityMethodPacket> ParseEntityMethodPacket(std::span<const Byte>& data, PacketParser& parser, float clock)
+static Entity MakeEntity(uint16_t type, const EntitySpec& spec, std::pmr::memory_resource* memory)
 {
-	EntityMethodPacket packet;
-	packet.Type = PacketBaseType::EntityMethod;
-	packet.Clock = clock;
+	return Entity{ type, spec, PropertySlots(spec.BaseProperties.size(), memory), PropertySlots(spec.ClientProperties.size(), memory) };
+}
+
+[[maybe_unused]] static ReplayResult<std::optional<EntityMethodPacket>> ParseEntityMethodPacket(std::span<const Byte>& data, PacketParser& parser, float clock)
+{
+	EntityMethodPacket packet{ { PacketBaseType::EntityMethod, clock }, {}, {}, {}, {}, {}, ArgArray(parser.Memory) };
 
 	auto err = [data]()
 	{
@@ -95,11 +102,12 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 		return PA_REPLAY_ERROR("Invalid payload size on EntityMethodPacket: {} != {}", data.size(), size);
 	}
 
-	if (!parser.Entities.contains(packet.EntityId))
+	const Entity* entity = parser.Entities.Find(packet.EntityId);
+	if (entity == nullptr)
 	{
 		return PA_REPLAY_ERROR("Entity {} does not exist for EntityMethodPacket", packet.EntityId);
 	}
-	const uint16_t entityType = parser.Entities.at(packet.EntityId).Type;
+	const uint16_t entityType = entity->Type;
 
 	const int specId = entityType - 1;
 	if (specId < 0 || static_cast<size_t>(specId) >= parser.Specs.size())
@@ -113,27 +121,28 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 		return PA_REPLAY_ERROR("Invalid methodId {} for EntityMethodPacket", packet.MethodId);
 	}
 	const Method& method = spec.ClientMethods[packet.MethodId];
-	packet.MethodName = method.Name;
 
-	packet.Values.reserve(method.Args.size());
-	for (const ArgType& argType : method.Args)
+	if (parser.Interest && !PacketInterest::Wants(parser.Interest->ClientMethods, specId, packet.MethodId))
 	{
-		PA_TRY_OR_ELSE(value, ParseValue(data, argType),
-		{
-			return PA_REPLAY_ERROR("Failed to parse value for EntityMethodPacket: {}", error);
-		});
-		packet.Values.emplace_back(value);
+		return std::nullopt;
 	}
 
+	packet.MethodNameId = method.NameId;
+	packet.Method = method.Known;
+	packet.MethodName = method.Name;
+
+	PA_TRYV_OR_ELSE(DecodeValues(method.Program, data, packet.Values, parser.Memory),
+	{
+		return PA_REPLAY_ERROR("Failed to parse value for EntityMethodPacket: {}", error);
+	});
+
 	parser.Callbacks.Invoke(packet);
 	return packet;
 }
 
 [[maybe_unused]] static ReplayResult<EntityCreatePacket> ParseEntityCreatePacket(std::span<const Byte>& data, PacketParser& parser, float clock)
 {
-	EntityCreatePacket packet;
-	packet.Type = PacketBaseType::EntityCreate;
-	packet.Clock = clock;
+	EntityCreatePacket packet{ { PacketBaseType::EntityCreate, clock }, {}, {}, {}, {}, {}, {}, ArgDict(parser.Memory) };
 
 	auto err = [data]()
 	{
@@ -153,7 +162,7 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 	if (!TakeInto(data, packet.Rotation))
 		return err();
 
-	if (parser.Entities.contains(packet.EntityId))
+	if (parser.Entities.Contains(packet.EntityId))
 	{
 		// LOG_TRACE("Entity {} already exists for EntityCreatePacket", packet.EntityId);
 		// return InvalidPacket{};
@@ -183,8 +192,7 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 
 	packet.Values.reserve(propertyCount);
 
-	std::unordered_map<std::string, ArgValue> clientPropertyValues;
-	clientPropertyValues.reserve(propertyCount);
+	Entity entity = MakeEntity(packet.EntityType, spec, parser.Memory);
 
 	for (uint8_t i = 0; i < propertyCount; i++)
 	{
@@ -195,15 +203,24 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 		}
 		if (propertyId < spec.ClientProperties.size())
 		{
-			const auto& [name, type, flag] = spec.ClientProperties[propertyId].get();
+			const auto& [name, type, flag, program, nameId] = spec.ClientProperties[propertyId].get();
 
-			PA_TRY_OR_ELSE(value, ParseValue(data, type),
+			if (parser.Interest && !PacketInterest::Wants(parser.Interest->ClientProperties, specId, propertyId))
+			{
+				PA_TRYV_OR_ELSE(SkipValues(program, data),
+				{
+					return PA_REPLAY_ERROR("Failed to skip value for EntityCreatePacket: {}", error);
+				});
+				continue;
+			}
+
+			PA_TRY_OR_ELSE(value, DecodeValue(program, data, parser.Memory),
 			{
 				return PA_REPLAY_ERROR("Failed to parse value for EntityCreatePacket: {}", error);
 			});
 
-			packet.Values[name] = value;
-			clientPropertyValues.insert_or_assign(name, value);
+			entity.ClientPropertiesValues[propertyId] = CloneValue(value, parser.Memory);
+			packet.Values.insert_or_assign(ArgString(name, parser.Memory), std::move(value));
 		}
 		else
 		{
@@ -211,13 +228,13 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 		}
 	}
 
-	parser.Entities.insert_or_assign(packet.EntityId, Entity{ packet.EntityType, spec, {}, clientPropertyValues, {} });
+	parser.Entities.InsertOrAssign(packet.EntityId, std::move(entity));
 
 	parser.Callbacks.Invoke(packet);
 	return packet;
 }
 
-[[maybe_unused]] static ReplayResult<EntityPropertyPacket> ParseEntityPropertyPacket(std::span<const Byte>& data, PacketParser& parser, float clock)
+[[maybe_unused]] static ReplayResult<std::optional<EntityPropertyPacket>> ParseEntityPropertyPacket(std::span<const Byte>& data, PacketParser& parser, float clock)
 {
 	EntityPropertyPacket packet;
 	packet.Clock = clock;
@@ -242,11 +259,12 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 		return PA_REPLAY_ERROR("Invalid payload size on EntityPropertyPacket: {} != {}", data.size(), size);
 	}
 
-	if (!parser.Entities.contains(packet.EntityId))
+	Entity* entity = parser.Entities.Find(packet.EntityId);
+	if (entity == nullptr)
 	{
 		return PA_REPLAY_ERROR("Entity {} does not exist for EntityPropertyPacket", packet.EntityId);
 	}
-	const uint16_t entityType = parser.Entities.at(packet.EntityId).Type;
+	const uint16_t entityType = entity->Type;
 
 	const int specId = entityType - 1;
 	if (specId < 0 || static_cast<size_t>(specId) >= parser.Specs.size())
@@ -260,21 +278,22 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 		return PA_REPLAY_ERROR("Invalid methodId {} for EntityPropertyPacket", packet.MethodId);
 	}
 	const Property& property = spec.ClientProperties[packet.MethodId];
-	packet.PropertyName = property.Name;
 
-	if (!parser.Entities.contains(packet.EntityId))
+	if (parser.Interest && !PacketInterest::Wants(parser.Interest->ClientProperties, specId, packet.MethodId))
 	{
-		return PA_REPLAY_ERROR("Entity {} does not exist for EntityPropertyPacket", packet.EntityId);
+		return std::nullopt;
 	}
-	Entity& entity = parser.Entities.at(packet.EntityId);
 
-	PA_TRY_OR_ELSE(value, ParseValue(data, property.Type),
+	packet.PropertyNameId = property.NameId;
+	packet.PropertyName = property.Name;
+
+	PA_TRY_OR_ELSE(value, DecodeValue(property.Program, data, parser.Memory),
 	{
 		return PA_REPLAY_ERROR("Failed to parse value for EntityPropertyPacket: {}", error);
 	});
 
-	packet.Value = value;
-	entity.ClientPropertiesValues.insert_or_assign(property.Name, value);
+	entity->ClientPropertiesValues[packet.MethodId] = CloneValue(value, parser.Memory);
+	packet.Value = std::move(value);
 
 	parser.Callbacks.Invoke(packet);
 	return packet;
@@ -304,22 +323,30 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 	const EntitySpec& spec = parser.Specs[specId];
 
 	const size_t propertyCount = spec.BaseProperties.size();
-	std::unordered_map<std::string, ArgValue> basePropertyValues;
-	basePropertyValues.reserve(propertyCount);
+	Entity entity = MakeEntity(packet.EntityType, spec, parser.Memory);
 
 	for (uint8_t i = 0; i < propertyCount; i++)
 	{
-		const auto& [name, type, flag] = spec.BaseProperties[i].get();
+		const auto& [name, type, flag, program, nameId] = spec.BaseProperties[i].get();
+
+		if (parser.Interest && !PacketInterest::Wants(parser.Interest->BaseProperties, specId, i))
+		{
+			PA_TRYV_OR_ELSE(SkipValues(program, data),
+			{
+				return PA_REPLAY_ERROR("Failed to skip value for BasePlayerCreatePacket: {}", error);
+			});
+			continue;
+		}
 
-		PA_TRY_OR_ELSE(value, ParseValue(data, type),
+		PA_TRY_OR_ELSE(value, DecodeValue(program, data, parser.Memory),
 		{
 			return PA_REPLAY_ERROR("Failed to parse value for EntityCreatePacket: {}", error);
 		});
 
-		basePropertyValues.emplace(name, value);
+		entity.BasePropertiesValues[i] = std::move(value);
 	}
 
-	parser.Entities.emplace(packet.EntityId, Entity{ packet.EntityType, spec, basePropertyValues, {}, {} });  // TODO: parse the state
+	parser.Entities.TryEmplace(packet.EntityId, std::move(entity));  // TODO: parse the state
 
 	std::span<const Byte> state = Take(data, data.size());
 	packet.Data = { state.begin(), state.end() };
@@ -330,9 +357,7 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 
 [[maybe_unused]] static ReplayResult<CellPlayerCreatePacket> ParseCellPlayerCreatePacket(std::span<const Byte>& data, PacketParser& parser, float clock)
 {
-	CellPlayerCreatePacket packet;
-	packet.Type = PacketBaseType::CellPlayerCreate;
-	packet.Clock = clock;
+	CellPlayerCreatePacket packet{ { PacketBaseType::CellPlayerCreate, clock }, {}, {}, {}, {}, {}, {}, ArgDict(parser.Memory) };
 
 	auto err = [data]()
 	{
@@ -359,12 +384,12 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 		return PA_REPLAY_ERROR("Invalid payload size on CellPlayerCreatePacket: {} != {}", data.size(), size);
 	}
 
-	if (!parser.Entities.contains(packet.EntityId))
+	if (!parser.Entities.Contains(packet.EntityId))
 	{
 		return PA_REPLAY_ERROR("Entity {} does not exist for CellPlayerCreatePacket", packet.EntityId);
 	}
 
-	const uint16_t entityType = parser.Entities.at(packet.EntityId).Type;
+	const uint16_t entityType = parser.Entities.Find(packet.EntityId)->Type;
 
 	const int specId = entityType - 1;
 	if (specId < 0 || static_cast<size_t>(specId) >= parser.Specs.size())
@@ -373,22 +398,36 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 	}
 	const EntitySpec& spec = parser.Specs[specId];
 
-	if (!parser.Entities.contains(packet.EntityId))
+	if (!parser.Entities.Contains(packet.EntityId))
 	{
 		LOG_WARN("CellPlayerCreatePacket created non-existing entity {}", packet.EntityId);
-		parser.Entities.emplace(packet.EntityId, Entity{ entityType, spec, {}, {}, {} });
 	}
+	Entity& entity = parser.Entities.TryEmplace(packet.EntityId, MakeEntity(entityType, spec, parser.Memory));
 
 	packet.Values.reserve(spec.ClientPropertiesInternal.size());
-	for (auto property : spec.ClientPropertiesInternal)
+	for (size_t i = 0; i < spec.ClientPropertiesInternal.size(); i++)
 	{
-		PA_TRY_OR_ELSE(value, ParseValue(data, property.get().Type),
+		const std::reference_wrapper<const Property> property = spec.ClientPropertiesInternal[i];
+
+		if (parser.Interest && !PacketInterest::Wants(parser.Interest->ClientPropertiesInternal, specId, i))
+		{
+			PA_TRYV_OR_ELSE(SkipValues(property.get().Program, data),
+			{
+				return PA_REPLAY_ERROR("Failed to skip value for CellPlayerCreatePacket: {}", error);
+			});
+			continue;
+		}
+
+		PA_TRY_OR_ELSE(value, DecodeValue(property.get().Program, data, parser.Memory),
 		{
 			return PA_REPLAY_ERROR("Failed to parse value for CellPlayerCreatePacket: {}", error);
 		});
 
-		packet.Values[property.get().Name] = value;
-		parser.Entities.at(packet.EntityId).ClientPropertiesValues.emplace(property.get().Name, value);
+		if (const uint32_t slot = spec.ClientPropertiesInternalSlots[i]; slot < entity.ClientPropertiesValues.size() && !entity.ClientPropertiesValues[slot])
+		{
+			entity.ClientPropertiesValues[slot] = CloneValue(value, parser.Memory);
+		}
+		packet.Values.insert_or_assign(ArgString(property.get().Name, parser.Memory), std::move(value));
 	}
 
 	bool unknown;
@@ -475,7 +514,7 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 	return packet;
 }
 
-[[maybe_unused]] static ReplayResult<NestedPropertyUpdatePacket> ParseNestedPropertyUpdatePacket(std::span<const Byte>& data, PacketParser& parser, float clock)
+[[maybe_unused]] static ReplayResult<std::optional<NestedPropertyUpdatePacket>> ParseNestedPropertyUpdatePacket(std::span<const Byte>& data, PacketParser& parser, float clock)
 {
 	NestedPropertyUpdatePacket packet;
 	packet.Type = PacketBaseType::NestedPropertyUpdate;
@@ -504,12 +543,12 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 
 	std::span<const Byte> payload = Take(data, size);
 
-	if (!parser.Entities.contains(packet.EntityId))
+	Entity* entity = parser.Entities.Find(packet.EntityId);
+	if (entity == nullptr)
 	{
 		return PA_REPLAY_ERROR("Entity {} does not exist for EntityPropertyPacket", packet.EntityId);
 	}
-	packet.EntityPtr = &parser.Entities.at(packet.EntityId);
-	const EntitySpec& spec = packet.EntityPtr->Spec;
+	const EntitySpec& spec = entity->Spec;
 
 	BitReader bitReader(payload);
 	const int cont = bitReader.Get(1);
@@ -526,15 +565,22 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 
 	const Property& prop = spec.ClientProperties[propIndex].get();
 
+	if (parser.Interest && !PacketInterest::Wants(parser.Interest->ClientProperties, entity->Type - 1, propIndex))
+	{
+		return std::nullopt;
+	}
+
 	packet.PropertyIndex = propIndex;
+	packet.PropertyNameId = prop.NameId;
 	packet.PropertyName = prop.Name;
 
-	if (!packet.EntityPtr->ClientPropertiesValues.contains(prop.Name))
+	std::optional<ArgValue>& propValue = entity->ClientPropertiesValues[propIndex];
+	if (!propValue)
 	{
 		return PA_REPLAY_ERROR("Entity is missing property value for '{}' in NestedPropertyUpdatePacket", prop.Name);
 	}
 
-	PA_TRY(nesting, GetNestedPropertyPath(isSlice, prop.Type, &packet.EntityPtr->ClientPropertiesValues[prop.Name], bitReader));
+	PA_TRY(nesting, GetNestedPropertyPath(isSlice, prop.Type, &*propValue, bitReader));
 	packet.Nesting = nesting;
 
 	if (!data.empty())
@@ -578,7 +624,7 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 [[maybe_unused]] static ReplayResult<PlayerPositionPacket> ParsePlayerPositionPacketPacket(std::span<const Byte>& data, const PacketParser& parser, float clock)
 {
 	PlayerPositionPacket packet;
-	packet.Type = PacketBaseType::PlayerOrientation;
+	packet.Type = PacketBaseType::PlayerPosition;
 	packet.Clock = clock;
 
 	auto err = [data]()
@@ -850,10 +896,175 @@ static constexpr bool IsPacket(PacketBaseType type, uint32_t id, Version version
 	return packet;
 }
 
+template<typename P>
+static ReplayResult<PacketType> Dispatch(std::span<const Byte> raw, PacketParser& parser, float clock)
+{
+	PA_TRY(packet, ParsePacketAs<P>(raw, clock, parser));
+	if (!packet)
+		return UnknownPacket{ { *PacketBaseTypeOf<P>(), clock } };
+	return std::move(*packet);
+}
+
+static PacketDispatchTable::ParseFunction GetParseFunction(PacketBaseType type)
+{
+	switch (type)
+	{
+		case PacketBaseType::EntityCreate:         return &Dispatch<EntityCreatePacket>;
+		case PacketBaseType::BasePlayerCreate:     return &Dispatch<BasePlayerCreatePacket>;
+		case PacketBaseType::CellPlayerCreate:     return &Dispatch<CellPlayerCreatePacket>;
+		case PacketBaseType::EntityMethod:         return &Dispatch<EntityMethodPacket>;
+		case PacketBaseType::EntityProperty:       return &Dispatch<EntityPropertyPacket>;
+		case PacketBaseType::NestedPropertyUpdate: return &Dispatch<NestedPropertyUpdatePacket>;
+		case PacketBaseType::PlayerPosition:       return &Dispatch<PlayerPositionPacket>;
+		case PacketBaseType::PlayerOrientation:    return &Dispatch<PlayerOrientationPacket>;
+		case PacketBaseType::EntityLeave:          return &Dispatch<EntityLeavePacket>;
+#ifdef PA_PARSE_EXTRA_PACKETS
+		case PacketBaseType::Version:              return &Dispatch<VersionPacket>;
+		case PacketBaseType::EntityControl:        return &Dispatch<EntityControlPacket>;
+		case PacketBaseType::EntityEnter:          return &Dispatch<EntityEnterPacket>;
+		case PacketBaseType::PlayerEntity:         return &Dispatch<PlayerEntityPacket>;
+		case PacketBaseType::Camera:               return &Dispatch<CameraPacket>;
+		case PacketBaseType::Map:                  return &Dispatch<MapPacket>;
+		case PacketBaseType::CameraFreeLook:       return &Dispatch<CameraFreeLookPacket>;
+		case PacketBaseType::CameraMode:           return &Dispatch<CameraModePacket>;
+		case PacketBaseType::CruiseState:          return &Dispatch<CruiseStatePacket>;
+		case PacketBaseType::Result:               return &Dispatch<ResultPacket>;
+#endif  // PA_PARSE_EXTRA_PACKETS
+		default:
+			return nullptr;
+	}
+}
 
 }  // namespace
 
-ReplayResult<PacketType> PotatoAlert::ReplayParser::ParsePacket(std::span<const Byte>& data, PacketParser& parser, Version version)
+template<typename P>
+ReplayResult<std::optional<P>> PotatoAlert::ReplayParser::ParsePacketAs(std::span<const Byte> payload, float clock, PacketParser& parser)
+{
+	if constexpr (std::is_same_v<P, EntityCreatePacket>) return ParseEntityCreatePacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, BasePlayerCreatePacket>) return ParseBasePlayerCreatePacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, CellPlayerCreatePacket>) return ParseCellPlayerCreatePacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, EntityMethodPacket>) return ParseEntityMethodPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, EntityPropertyPacket>) return ParseEntityPropertyPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, NestedPropertyUpdatePacket>) return ParseNestedPropertyUpdatePacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, PlayerPositionPacket>) return ParsePlayerPositionPacketPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, PlayerOrientationPacket>) return ParsePlayerOrientationPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, EntityLeavePacket>) return ParseEntityLeavePacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, VersionPacket>) return ParseVersionPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, EntityControlPacket>) return ParseEntityControlPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, EntityEnterPacket>) return ParseEntityEnterPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, PlayerEntityPacket>) return ParsePlayerEntityPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, CameraPacket>) return ParseCameraPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, MapPacket>) return ParseMapPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, CameraFreeLookPacket>) return ParseCameraFreeLookPacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, CameraModePacket>) return ParseCameraModePacket(payload, parser, clock, parser.Dispatch.GameVersion());
+	else if constexpr (std::is_same_v<P, CruiseStatePacket>) return ParseCruiseStatePacket(payload, parser, clock);
+	else if constexpr (std::is_same_v<P, ResultPacket>) return ParseResultPacket(payload, parser, clock);
+	else static_assert(always_false<P>, "packet type is never parsed");
+}
+
+#define PA_INSTANTIATE_PARSE_PACKET_AS(P) \
+	template ReplayResult<std::optional<P>> PotatoAlert::ReplayParser::ParsePacketAs<P>(std::span<const Byte>, float, PacketParser&);
+PA_INSTANTIATE_PARSE_PACKET_AS(BasePlayerCreatePacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(CellPlayerCreatePacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(EntityControlPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(EntityEnterPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(EntityLeavePacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(EntityCreatePacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(EntityMethodPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(EntityPropertyPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(PlayerPositionPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(PlayerOrientationPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(MapPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(NestedPropertyUpdatePacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(VersionPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(CameraPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(PlayerEntityPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(CruiseStatePacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(CameraFreeLookPacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(CameraModePacket)
+PA_INSTANTIATE_PARSE_PACKET_AS(ResultPacket)
+#undef PA_INSTANTIATE_PARSE_PACKET_AS
+
+PacketDispatchTable::PacketDispatchTable(Version version) : m_version(version)
+{
+	for (uint32_t id = 0; id < Size; id++)
+	{
+		if (const std::optional<PacketBaseType> type = GetPacketBaseType(id, version))
+		{
+			m_entries[id] = Entry{ *type, GetParseFunction(*type) };
+		}
+	}
+}
+
+PacketInterest PotatoAlert::ReplayParser::ResolvePacketFilter(const PacketFilter& filter, std::span<const EntitySpec> specs)
+{
+	PacketInterest interest;
+
+	for (const PacketBaseType type : filter.PacketTypes)
+	{
+		interest.PacketTypes |= 1u << static_cast<uint32_t>(type);
+	}
+
+	auto resolve = [](const auto& elements, const std::vector<std::string_view>& names, auto&& getName)
+	{
+		std::vector<bool> ids(elements.size(), false);
+		for (size_t i = 0; i < elements.size(); i++)
+		{
+			ids[i] = std::ranges::find(names, std::string_view(getName(elements[i]))) != names.end();
+		}
+		return ids;
+	};
+	auto methodName = [](const Method& method) -> const std::string& { return method.Name; };
+	auto propertyName = [](const Property& property) -> const std::string& { return property.Name; };
+
+	for (const EntitySpec& spec : specs)
+	{
+		interest.ClientMethods.emplace_back(resolve(spec.ClientMethods, filter.Methods, methodName));
+		interest.ClientProperties.emplace_back(resolve(spec.ClientProperties, filter.Properties, propertyName));
+		interest.ClientPropertiesInternal.emplace_back(resolve(spec.ClientPropertiesInternal, filter.Properties, propertyName));
+		interest.BaseProperties.emplace_back(resolve(spec.BaseProperties, filter.Properties, propertyName));
+	}
+
+	return interest;
+}
+
+std::optional<PacketBaseType> PotatoAlert::ReplayParser::GetPacketBaseType(uint32_t type, Version version)
+{
+	// the order matters, some ids are shared between versions
+	static constexpr PacketBaseType candidates[] =
+	{
+		PacketBaseType::EntityCreate,
+		PacketBaseType::BasePlayerCreate,
+		PacketBaseType::CellPlayerCreate,
+		PacketBaseType::EntityMethod,
+		PacketBaseType::EntityProperty,
+		PacketBaseType::NestedPropertyUpdate,
+		PacketBaseType::PlayerPosition,
+		PacketBaseType::PlayerOrientation,
+		PacketBaseType::EntityLeave,
+#ifdef PA_PARSE_EXTRA_PACKETS
+		PacketBaseType::Version,
+		PacketBaseType::EntityControl,
+		PacketBaseType::EntityEnter,
+		PacketBaseType::PlayerEntity,
+		PacketBaseType::Camera,
+		PacketBaseType::Map,
+		PacketBaseType::CameraFreeLook,
+		PacketBaseType::CameraMode,
+		PacketBaseType::CruiseState,
+		PacketBaseType::Result,
+#endif
+	};
+
+	for (const PacketBaseType candidate : candidates)
+	{
+		if (IsPacket(candidate, type, version))
+			return candidate;
+	}
+	return std::nullopt;
+}
+
+ReplayResult<PacketType> PotatoAlert::ReplayParser::ParsePacket(std::span<const Byte>& data, PacketParser& parser)
 {
 	uint32_t size;
 	if (!TakeInto(data, size))
@@ -865,49 +1076,22 @@ ReplayResult<PacketType> PotatoAlert::ReplayParser::ParsePacket(std::span<const
 	if (!TakeInto(data, clock))
 		return PA_REPLAY_ERROR("Packet had invalid size {}", data.size());
 
-	std::span<const Byte> raw = Take(data, size);
-
-	if (IsPacket(PacketBaseType::EntityCreate, type, version))
-		return ParseEntityCreatePacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::BasePlayerCreate, type, version))
-		return ParseBasePlayerCreatePacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::CellPlayerCreate, type, version))
-		return ParseCellPlayerCreatePacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::EntityMethod, type, version))
-		return ParseEntityMethodPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::EntityProperty, type, version))
-		return ParseEntityPropertyPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::NestedPropertyUpdate, type, version))
-		return ParseNestedPropertyUpdatePacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::PlayerPosition, type, version))
-		return ParsePlayerPositionPacketPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::PlayerOrientation, type, version))
-		return ParsePlayerOrientationPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::EntityLeave, type, version))
-		return ParseEntityLeavePacket(raw, parser, clock);
+	if (data.size() < size)
+		return PA_REPLAY_ERROR("Packet is truncated {} < {}", data.size(), size);
 
-#ifdef PA_PARSE_EXTRA_PACKETS
-	if (IsPacket(PacketBaseType::Version, type, version))
-		return ParseVersionPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::EntityControl, type, version))
-		return ParseEntityControlPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::EntityEnter, type, version))
-		return ParseEntityEnterPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::PlayerEntity, type, version))
-		return ParsePlayerEntityPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::Camera, type, version))
-		return ParseCameraPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::Map, type, version))
-		return ParseMapPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::CameraFreeLook, type, version))
-		return ParseCameraFreeLookPacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::CameraMode, type, version))
-		return ParseCameraModePacket(raw, parser, clock, version);
-	if (IsPacket(PacketBaseType::CruiseState, type, version))
-		return ParseCruiseStatePacket(raw, parser, clock);
-	if (IsPacket(PacketBaseType::Result, type, version))
-		return ParseResultPacket(raw, parser, clock);
-#endif  // NDEBUG
+	return ParsePacket(Take(data, size), type, clock, parser);
+}
+
+ReplayResult<PacketType> PotatoAlert::ReplayParser::ParsePacket(std::span<const Byte> raw, uint32_t type, float clock, PacketParser& parser)
+{
+	const PacketDispatchTable::Entry* entry = parser.Dispatch.Find(type);
+	if (entry == nullptr)
+		return UnknownPacket{};
+
+	if (parser.Interest && !parser.Interest->Wants(entry->Type) && !ChangesEntityState(entry->Type))
+		return UnknownPacket{ { entry->Type, clock } };
+
+	return entry->Parse(raw, parser, clock);
 
 #if 0
 		case 0xE:
@@ -1003,6 +1187,73 @@ ReplayResult<PacketType> PotatoAlert::ReplayParser::ParsePacket(std::span<const
 			break;
 		}
 #endif  // 0
+}
 
-	return UnknownPacket{};
+Entity* EntityTable::Find(TypeEntityId id)
+{
+	return const_cast<Entity*>(std::as_const(*this).Find(id));
+}
+
+const Entity* EntityTable::Find(TypeEntityId id) const
+{
+	const auto it = std::ranges::lower_bound(m_index, id, {}, &IndexEntry::Id);
+	if (it == m_index.end() || it->Id != id)
+	{
+		return nullptr;
+	}
+	return &m_entities[it->Index];
+}
+
+Entity& EntityTable::InsertOrAssign(TypeEntityId id, Entity&& entity)
+{
+	const auto it = std::ranges::lower_bound(m_index, id, {}, &IndexEntry::Id);
+	if (it != m_index.end() && it->Id == id)
+	{
+		Entity& existing = m_entities[it->Index];
+		existing = std::move(entity);
+		return existing;
+	}
+
+	m_index.insert(it, IndexEntry{ id, static_cast<uint32_t>(m_entities.size()) });
+	m_ids.push_back(id);
+	return m_entities.emplace_back(std::move(entity));
+}
+
+Entity& EntityTable::TryEmplace(TypeEntityId id, Entity&& entity)
+{
+	const auto it = std::ranges::lower_bound(m_index, id, {}, &IndexEntry::Id);
+	if (it != m_index.end() && it->Id == id)
+	{
+		return m_entities[it->Index];
+	}
+
+	m_index.insert(it, IndexEntry{ id, static_cast<uint32_t>(m_entities.size()) });
+	m_ids.push_back(id);
+	return m_entities.emplace_back(std::move(entity));
+}
+
+EntityTable EntityTable::Clone(std::pmr::memory_resource* memory) const
+{
+	const auto cloneSlots = [memory](const PropertySlots& slots)
+	{
+		PropertySlots copy(slots.size(), memory);
+		for (size_t i = 0; i < slots.size(); i++)
+		{
+			if (slots[i])
+			{
+				copy[i] = CloneValue(*slots[i], memory);
+			}
+		}
+		return copy;
+	};
+
+	EntityTable table;
+	table.m_ids = m_ids;
+	table.m_index = m_index;
+	table.m_entities.reserve(m_entities.size());
+	for (const Entity& entity : m_entities)
+	{
+		table.m_entities.emplace_back(Entity{ entity.Type, entity.Spec, cloneSlots(entity.BasePropertiesValues), cloneSlots(entity.ClientPropertiesValues) });
+	}
+	return table;
 }
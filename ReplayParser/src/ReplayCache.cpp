@@ -0,0 +1,516 @@
+// Copyright 2024 <github.com/razaqq>
+
+#include "Core/Bytes.hpp"
+#include "Core/File.hpp"
+#include "Core/FileMapping.hpp"
+#include "Core/Format.hpp"
+#include "Core/Log.hpp"
+
+#include "ReplayParser/ReplayCache.hpp"
+#include "ReplayParser/Result.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace fs = std::filesystem;
+
+using namespace PotatoAlert::Core;
+using PotatoAlert::ReplayParser::CachedReplay;
+using PotatoAlert::ReplayParser::PacketIndexEntry;
+using PotatoAlert::ReplayParser::ReplayCache;
+using PotatoAlert::ReplayParser::ReplayResult;
+
+namespace {
+
+// bump this whenever the layout of the entries changes
+static constexpr uint32_t g_cacheFormatVersion = 1;
+static constexpr std::array<Byte, 4> g_cacheMagic = { 'P', 'A', 'R', 'C' };
+static constexpr std::string_view g_cacheExtension = ".replaycache";
+static constexpr std::array<Byte, 4> g_keyframesMagic = { 'P', 'A', 'R', 'K' };
+static constexpr std::string_view g_keyframesExtension = ".keyframes";
+
+// The entries are the header, the packet index and the packet stream back to back, all in their in-memory layout,
+// so a loaded entry is used right out of the mapped file.
+struct CacheHeader
+{
+	std::array<Byte, 4> Magic;
+	uint32_t FormatVersion;
+	uint32_t IndexCount;
+	uint32_t Reserved;
+	uint64_t DataSize;
+};
+static_assert(std::is_trivially_copyable_v<CacheHeader> && sizeof(CacheHeader) == 24);
+static_assert(sizeof(CacheHeader) % alignof(PacketIndexEntry) == 0);
+
+// keyframes are stored next to the entry of their replay, as serialized by the view
+struct KeyframesHeader
+{
+	std::array<Byte, 4> Magic;
+	uint32_t FormatVersion;
+	float Interval;
+	uint32_t Reserved;
+};
+static_assert(std::is_trivially_copyable_v<KeyframesHeader> && sizeof(KeyframesHeader) == 16);
+static_assert(std::is_trivially_copyable_v<PacketIndexEntry> && sizeof(PacketIndexEntry) == 16);
+
+// the hashes end up in file names, so only hex digits are accepted
+static bool IsValidHash(std::string_view hash)
+{
+	return !hash.empty() && std::ranges::all_of(hash, [](char c)
+	{
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+	});
+}
+
+// a file that is not there anymore counts as removed
+static bool RemoveFile(const fs::path& path)
+{
+	std::error_code ec;
+	fs::remove(path, ec);
+	if (ec)
+	{
+		LOG_WARN("Failed to remove replay cache file {}: {}", path, ec.message());
+		return false;
+	}
+	return true;
+}
+
+enum class ReadStatus
+{
+	Ok,
+	Unreadable,
+	Corrupt,
+};
+
+// the mapping is validated only, the entry hands out views into it
+static ReadStatus ValidateEntry(std::span<const Byte> entry, std::span<const PacketIndexEntry>& index, std::span<const Byte>& data)
+{
+	if (entry.size() < sizeof(CacheHeader))
+		return ReadStatus::Corrupt;
+
+	CacheHeader header;
+	TakeInto(entry, header);
+	if (header.Magic != g_cacheMagic || header.FormatVersion != g_cacheFormatVersion)
+		return ReadStatus::Corrupt;
+
+	const uint64_t indexSize = static_cast<uint64_t>(header.IndexCount) * sizeof(PacketIndexEntry);
+	if (entry.size() != indexSize + header.DataSize)
+		return ReadStatus::Corrupt;
+
+	// the header keeps the index aligned within the page aligned mapping
+	index = { reinterpret_cast<const PacketIndexEntry*>(Take(entry, indexSize).data()), header.IndexCount };
+	data = entry;
+
+	// every payload has to be inside the stream, the view hands them out without checking
+	const bool inBounds = std::ranges::all_of(index, [&data](const PacketIndexEntry& e)
+	{
+		return static_cast<uint64_t>(e.Offset) + e.Size <= data.size();
+	});
+	return inBounds ? ReadStatus::Ok : ReadStatus::Corrupt;
+}
+
+}  // namespace
+
+CachedReplay::CachedReplay(CachedReplay&& src) noexcept
+	: m_file(std::move(src.m_file)), m_fileMapping(std::move(src.m_fileMapping)), m_mapping(std::exchange(src.m_mapping, {})),
+	  m_index(std::exchange(src.m_index, {})), m_data(std::exchange(src.m_data, {}))
+{
+}
+
+CachedReplay& CachedReplay::operator=(CachedReplay&& src) noexcept
+{
+	if (this != &src)
+	{
+		Unmap();
+		m_file = std::move(src.m_file);
+		m_fileMapping = std::move(src.m_fileMapping);
+		m_mapping = std::exchange(src.m_mapping, {});
+		m_index = std::exchange(src.m_index, {});
+		m_data = std::exchange(src.m_data, {});
+	}
+	return *this;
+}
+
+CachedReplay::~CachedReplay()
+{
+	Unmap();
+}
+
+void CachedReplay::Unmap()
+{
+	if (!m_mapping.empty())
+	{
+		m_fileMapping.Unmap(m_mapping.data(), m_mapping.size());
+	}
+	m_mapping = {};
+	m_index = {};
+	m_data = {};
+}
+
+ReplayCache::ReplayCache(const fs::path& directory, uint64_t maxSize) : m_directory(directory), m_maxSize(maxSize)
+{
+	struct Found
+	{
+		Entry Cached;
+		fs::file_time_type LastUsed;
+	};
+	std::vector<Found> found;
+	std::unordered_map<std::string, uint64_t> keyframes;
+
+	std::error_code ec;
+	fs::create_directories(m_directory, ec);
+	for (const fs::directory_entry& file : fs::directory_iterator(m_directory, ec))
+	{
+		const fs::path& path = file.path();
+		if (path.extension() == ".tmp")
+		{
+			// left behind by a store that never finished
+			RemoveFile(path);
+			continue;
+		}
+
+		const std::string hash = path.stem().string();
+		if ((path.extension() != g_cacheExtension && path.extension() != g_keyframesExtension) || !IsValidHash(hash))
+			continue;
+
+		const uint64_t size = file.file_size(ec);
+		if (ec)
+			continue;
+		if (path.extension() == g_keyframesExtension)
+		{
+			keyframes.emplace(hash, size);
+			continue;
+		}
+		const fs::file_time_type lastUsed = file.last_write_time(ec);
+		if (ec)
+			continue;
+		found.emplace_back(Found{ { hash, size }, lastUsed });
+	}
+
+	// the modification time is bumped on every load, so it gives back the order of the last run
+	std::ranges::sort(found, [](const Found& a, const Found& b) { return a.LastUsed > b.LastUsed; });
+
+	std::scoped_lock lock(m_mutex);
+	for (Found& entry : found)
+	{
+		if (const auto it = keyframes.find(entry.Cached.Hash); it != keyframes.end())
+		{
+			entry.Cached.KeyframesSize = it->second;
+			keyframes.erase(it);
+		}
+		m_size += entry.Cached.Size + entry.Cached.KeyframesSize;
+		m_entries.emplace_back(std::move(entry.Cached));
+		m_lookup.emplace(m_entries.back().Hash, std::prev(m_entries.end()));
+	}
+
+	// the entry they belong to is gone
+	for (const auto& [hash, size] : keyframes)
+	{
+		Entry orphan{ hash, 0, size };
+		m_size += size;
+		if (!RemoveFiles(orphan))
+			m_pending.emplace_back(std::move(orphan));
+	}
+	Trim();
+}
+
+fs::path ReplayCache::EntryPath(std::string_view hash) const
+{
+	return m_directory / fmt::format("{}{}", hash, g_cacheExtension);
+}
+
+fs::path ReplayCache::KeyframesPath(std::string_view hash) const
+{
+	return m_directory / fmt::format("{}{}", hash, g_keyframesExtension);
+}
+
+bool ReplayCache::Load(std::string_view hash, CachedReplay& entry)
+{
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_lookup.find(std::string(hash));
+		if (it == m_lookup.end())
+			return false;
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+	}
+
+	const fs::path path = EntryPath(hash);
+	CachedReplay loaded;
+	ReadStatus status = ReadStatus::Unreadable;
+	loaded.m_file = File::Open(path, File::Flags::Open | File::Flags::Read | File::Flags::ShareRead);
+	if (loaded.m_file)
+	{
+		const uint64_t fileSize = loaded.m_file.Size();
+		loaded.m_fileMapping = FileMapping::Open(loaded.m_file, FileMapping::Flags::Read, fileSize);
+		const void* mapping = loaded.m_fileMapping && fileSize > 0 ? loaded.m_fileMapping.Map(FileMapping::Flags::Read, 0, fileSize) : nullptr;
+		if (mapping != nullptr)
+		{
+			loaded.m_mapping = { static_cast<const Byte*>(mapping), fileSize };
+			status = ValidateEntry(loaded.m_mapping, loaded.m_index, loaded.m_data);
+		}
+		else if (fileSize == 0)
+		{
+			status = ReadStatus::Corrupt;
+		}
+	}
+
+	if (status != ReadStatus::Ok)
+	{
+		// a file that could not be opened may just be replaced by a store right now, so it is left alone
+		if (status == ReadStatus::Corrupt)
+		{
+			loaded = CachedReplay();
+			std::scoped_lock lock(m_mutex);
+			Remove(hash);
+		}
+		return false;
+	}
+
+	entry = std::move(loaded);
+	std::error_code ec;
+	fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+	return true;
+}
+
+ReplayResult<void> ReplayCache::Store(std::string_view hash, std::span<const PacketIndexEntry> index, std::span<const Byte> data)
+{
+	if (!IsValidHash(hash))
+	{
+		return PA_REPLAY_ERROR("Replay hash '{}' is not a valid cache key.", hash);
+	}
+
+	if (index.size() > UINT32_MAX)
+	{
+		return PA_REPLAY_ERROR("Replay has too many packets to be cached.");
+	}
+
+	const uint64_t size = sizeof(CacheHeader) + index.size_bytes() + data.size();
+	if (size > m_maxSize)
+	{
+		// it would only push out everything else and then itself
+		return {};
+	}
+
+	{
+		std::scoped_lock lock(m_mutex);
+		if (!RemovePending(hash))
+		{
+			return PA_REPLAY_ERROR("Replay cache entry {} is still in use.", hash);
+		}
+	}
+
+	const CacheHeader header
+	{
+		.Magic = g_cacheMagic,
+		.FormatVersion = g_cacheFormatVersion,
+		.IndexCount = static_cast<uint32_t>(index.size()),
+		.Reserved = 0,
+		.DataSize = data.size(),
+	};
+
+	// written to a temporary file first, so a concurrent load never sees a partial entry
+	const fs::path path = EntryPath(hash);
+	fs::path tmp = path;
+	tmp += fmt::format(".{}.tmp", m_tempCounter++);
+	{
+		const File file = File::Open(tmp, File::Flags::Create | File::Flags::Truncate | File::Flags::Write);
+		const bool written = file
+			&& file.Write(std::as_bytes(std::span{ &header, 1 }))
+			&& file.Write(std::as_bytes(index), false)
+			&& file.Write(data, false);
+		if (!written)
+		{
+			const std::string error = File::LastError();
+			RemoveFile(tmp);
+			return PA_REPLAY_ERROR("Failed to write replay cache entry: {}", error);
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(tmp, path, ec);
+	if (ec)
+	{
+		RemoveFile(tmp);
+		return PA_REPLAY_ERROR("Failed to move replay cache entry into place: {}", ec.message());
+	}
+
+	std::scoped_lock lock(m_mutex);
+	// the keyframes of a replaced entry stay, they were built from the same packets
+	uint64_t keyframesSize = 0;
+	if (const auto it = m_lookup.find(std::string(hash)); it != m_lookup.end())
+	{
+		keyframesSize = it->second->KeyframesSize;
+		m_size -= it->second->Size + keyframesSize;
+		m_entries.erase(it->second);
+		m_lookup.erase(it);
+	}
+	m_entries.emplace_front(Entry{ std::string(hash), size, keyframesSize });
+	m_lookup.emplace(std::string(hash), m_entries.begin());
+	m_size += size + keyframesSize;
+	Trim();
+
+	return {};
+}
+
+bool ReplayCache::LoadKeyframes(std::string_view hash, float interval, std::vector<Byte>& data)
+{
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto it = m_lookup.find(std::string(hash));
+		if (it == m_lookup.end() || it->second->KeyframesSize == 0)
+			return false;
+	}
+
+	const File file = File::Open(KeyframesPath(hash), File::Flags::Open | File::Flags::Read | File::Flags::ShareRead);
+	if (!file || !file.ReadAll(data))
+		return false;
+
+	std::span<const Byte> stored = data;
+	KeyframesHeader header;
+	if (!TakeInto(stored, header) || header.Magic != g_keyframesMagic || header.FormatVersion != g_cacheFormatVersion || header.Interval != interval)
+	{
+		data.clear();
+		return false;
+	}
+
+	data.erase(data.begin(), data.begin() + sizeof(KeyframesHeader));
+	return true;
+}
+
+ReplayResult<void> ReplayCache::StoreKeyframes(std::string_view hash, float interval, std::span<const Byte> data)
+{
+	{
+		// without the entry the keyframes could never be used
+		std::scoped_lock lock(m_mutex);
+		if (!m_lookup.contains(std::string(hash)))
+			return {};
+		if (!RemovePending(hash))
+		{
+			return PA_REPLAY_ERROR("Replay keyframes {} are still in use.", hash);
+		}
+	}
+
+	const KeyframesHeader header
+	{
+		.Magic = g_keyframesMagic,
+		.FormatVersion = g_cacheFormatVersion,
+		.Interval = interval,
+		.Reserved = 0,
+	};
+
+	const fs::path path = KeyframesPath(hash);
+	fs::path tmp = path;
+	tmp += fmt::format(".{}.tmp", m_tempCounter++);
+	{
+		const File file = File::Open(tmp, File::Flags::Create | File::Flags::Truncate | File::Flags::Write);
+		if (!file || !file.Write(std::as_bytes(std::span{ &header, 1 })) || !file.Write(data, false))
+		{
+			const std::string error = File::LastError();
+			RemoveFile(tmp);
+			return PA_REPLAY_ERROR("Failed to write replay keyframes: {}", error);
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(tmp, path, ec);
+	if (ec)
+	{
+		RemoveFile(tmp);
+		return PA_REPLAY_ERROR("Failed to move replay keyframes into place: {}", ec.message());
+	}
+
+	std::scoped_lock lock(m_mutex);
+	const uint64_t size = sizeof(KeyframesHeader) + data.size();
+	const auto it = m_lookup.find(std::string(hash));
+	if (it == m_lookup.end())
+	{
+		// the entry was evicted in the meantime
+		Entry orphan{ std::string(hash), 0, size };
+		m_size += size;
+		if (!RemoveFiles(orphan))
+			m_pending.emplace_back(std::move(orphan));
+		return {};
+	}
+	m_size = m_size - it->second->KeyframesSize + size;
+	it->second->KeyframesSize = size;
+	Trim();
+
+	return {};
+}
+
+bool ReplayCache::Contains(std::string_view hash) const
+{
+	std::scoped_lock lock(m_mutex);
+	return m_lookup.contains(std::string(hash));
+}
+
+uint64_t ReplayCache::Size() const
+{
+	std::scoped_lock lock(m_mutex);
+	return m_size;
+}
+
+bool ReplayCache::RemoveFiles(Entry& entry)
+{
+	if (entry.Size > 0 && RemoveFile(EntryPath(entry.Hash)))
+	{
+		m_size -= entry.Size;
+		entry.Size = 0;
+	}
+	if (entry.KeyframesSize > 0 && RemoveFile(KeyframesPath(entry.Hash)))
+	{
+		m_size -= entry.KeyframesSize;
+		entry.KeyframesSize = 0;
+	}
+	return entry.Size == 0 && entry.KeyframesSize == 0;
+}
+
+bool ReplayCache::RemovePending(std::string_view hash)
+{
+	const auto it = std::ranges::find(m_pending, hash, &Entry::Hash);
+	if (it == m_pending.end())
+		return true;
+	if (!RemoveFiles(*it))
+		return false;
+	m_pending.erase(it);
+	return true;
+}
+
+void ReplayCache::Remove(std::string_view hash)
+{
+	const auto it = m_lookup.find(std::string(hash));
+	if (it == m_lookup.end())
+		return;
+
+	Entry entry = std::move(*it->second);
+	m_entries.erase(it->second);
+	m_lookup.erase(it);
+	if (!RemoveFiles(entry))
+	{
+		m_pending.emplace_back(std::move(entry));
+	}
+}
+
+void ReplayCache::Trim()
+{
+	// whatever was still in use before might not be anymore
+	std::erase_if(m_pending, [this](Entry& entry) { return RemoveFiles(entry); });
+
+	while (m_size > m_maxSize && !m_entries.empty())
+	{
+		const std::string hash = m_entries.back().Hash;
+		Remove(hash);
+	}
+}
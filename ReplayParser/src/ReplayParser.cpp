@@ -7,15 +7,23 @@
 #include "Core/FileMapping.hpp"
 #include "Core/Instrumentor.hpp"
 #include "Core/Json.hpp"
+#include "Core/Log.hpp"
+#include "Core/Sha256.hpp"
 #include "Core/Zlib.hpp"
 
 #include "ReplayParser/GameFiles.hpp"
 #include "ReplayParser/PacketParser.hpp"
 #include "ReplayParser/Packets.hpp"
+#include "ReplayParser/ReplayCache.hpp"
 #include "ReplayParser/ReplayParser.hpp"
+#include "ReplayParser/ReplayView.hpp"
 #include "ReplayParser/Result.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <filesystem>
+#include <functional>
 #include <ranges>
 #include <span>
 #include <string>
@@ -29,10 +37,185 @@ using namespace PotatoAlert::ReplayParser;
 namespace rp = PotatoAlert::ReplayParser;
 using PotatoAlert::ReplayParser::ReplayResult;
 
-ReplayResult<Replay> Replay::FromFile(const fs::path& filePath, const fs::path& gameFilePath)
+namespace {
+
+static constexpr std::array<Byte, 16> g_replayKey = { 0x29, 0xB7, 0xC9, 0x09, 0x38, 0x3F, 0x84, 0x88, 0xFA, 0x98, 0xEC, 0x4E, 0x13, 0x19, 0x79, 0xFB };
+
+// how much of the encrypted payload is decrypted and inflated at once
+static constexpr size_t g_decodeChunkSize = 64 * 1024;
+
+// size of the [size][type][clock] header in front of every packet
+static constexpr size_t g_packetHeaderSize = 12;
+
+using FrameCallback = std::function<ReplayResult<void>(std::span<const Byte>)>;
+using ChunkCallback = std::function<bool(std::span<const Byte>)>;
+
+// decrypts the replay payload chunk by chunk, the callback can return false to stop early
+static ReplayResult<void> DecryptPayload(std::span<const Byte> data, const ChunkCallback& onChunk)
+{
+	if (data.size() % Blowfish::BlockSize() != 0)
+	{
+		return PA_REPLAY_ERROR("Replay data is not a multiple of blowfish block size.");
+	}
+
+	const Blowfish blowfish(g_replayKey);
+	std::vector<Byte> decrypted(std::min(data.size(), g_decodeChunkSize));
+	std::array<Byte, Blowfish::BlockSize()> chain = {};
+
+	while (!data.empty())
+	{
+		const std::span<const Byte> encrypted = Take(data, std::min(data.size(), g_decodeChunkSize));
+		if (!blowfish.DecryptChained(encrypted, decrypted, chain))
+		{
+			return PA_REPLAY_ERROR("Failed to decrypt replay data.");
+		}
+
+		if (!onChunk(std::span{ decrypted.data(), encrypted.size() }))
+			break;
+	}
+
+	return {};
+}
+
+// hands every complete frame at the front of data to the callback and removes it
+static ReplayResult<void> SplitFrames(std::span<const Byte>& data, const FrameCallback& onFrame)
+{
+	while (data.size() >= g_packetHeaderSize)
+	{
+		uint32_t size;
+		std::memcpy(&size, data.data(), sizeof(size));
+		if (data.size() - g_packetHeaderSize < size)
+			break;
+
+		PA_TRYV(onFrame(Take(data, g_packetHeaderSize + size)));
+	}
+	return {};
+}
+
+// Decrypts and inflates the replay payload chunk by chunk and hands every complete packet frame to the callback.
+// Only one chunk of decrypted data and the bytes of a partially received packet are held in memory at any time.
+static ReplayResult<void> DecodePayload(std::span<const Byte> data, uint32_t decompressedSize, const FrameCallback& onFrame)
+{
+	PA_PROFILE_FUNCTION();
+
+	Zlib::Inflater inflater;
+	if (!inflater)
+	{
+		return PA_REPLAY_ERROR("Failed to initialize zlib stream.");
+	}
+
+	// only a packet split across two inflated chunks is ever copied
+	std::vector<Byte> partial;
+	std::string frameError;
+
+	const Zlib::Inflater::Sink sink = [&](std::span<const Byte> chunk) -> bool
+	{
+		if (!partial.empty())
+		{
+			uint32_t size = 0;
+			const size_t missingHeader = g_packetHeaderSize - std::min(partial.size(), g_packetHeaderSize);
+			partial.insert(partial.end(), chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(std::min(missingHeader, chunk.size())));
+			chunk = chunk.subspan(std::min(missingHeader, chunk.size()));
+			if (partial.size() < g_packetHeaderSize)
+				return true;
+
+			std::memcpy(&size, partial.data(), sizeof(size));
+			const size_t missing = std::min(g_packetHeaderSize + size - partial.size(), chunk.size());
+			partial.insert(partial.end(), chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(missing));
+			chunk = chunk.subspan(missing);
+			if (partial.size() < g_packetHeaderSize + size)
+				return true;
+
+			if (ReplayResult<void> res = onFrame(partial); !res)
+			{
+				frameError = std::move(res.error());
+				return false;
+			}
+			partial.clear();
+		}
+
+		if (ReplayResult<void> res = SplitFrames(chunk, onFrame); !res)
+		{
+			frameError = std::move(res.error());
+			return false;
+		}
+		partial.assign(chunk.begin(), chunk.end());
+		return true;
+	};
+
+	bool inflated = true;
+	PA_TRYV(DecryptPayload(data, [&inflater, &sink, &inflated](std::span<const Byte> decrypted) -> bool
+	{
+		inflated = inflater.Feed(decrypted, sink);
+		return inflated && !inflater.Finished();
+	}));
+
+	if (!inflated)
+	{
+		if (!frameError.empty())
+			return PA_REPLAY_ERROR("{}", frameError);
+		return PA_REPLAY_ERROR("Failed to inflate decrypted replay data with zlib.");
+	}
+
+	if (!inflater.Finished())
+	{
+		return PA_REPLAY_ERROR("Replay zlib stream ended unexpectedly.");
+	}
+
+	if (inflater.TotalOut() != decompressedSize)
+	{
+		return PA_REPLAY_ERROR("Replay decompressed data != decompressedSize");
+	}
+
+	if (!partial.empty())
+	{
+		return PA_REPLAY_ERROR("Replay has a truncated packet of {} bytes at the end.", partial.size());
+	}
+
+	return {};
+}
+
+// Decrypts and inflates the whole replay payload straight into out, which has to be exactly decompressedSize long.
+static ReplayResult<void> DecodePayloadInto(std::span<const Byte> data, std::span<Byte> out)
 {
 	PA_PROFILE_FUNCTION();
 
+	Zlib::Inflater inflater;
+	if (!inflater)
+	{
+		return PA_REPLAY_ERROR("Failed to initialize zlib stream.");
+	}
+
+	std::span<Byte> remaining = out;
+	bool inflated = true;
+	PA_TRYV(DecryptPayload(data, [&inflater, &remaining, &inflated](std::span<const Byte> decrypted) -> bool
+	{
+		inflated = inflater.Feed(decrypted, remaining);
+		return inflated && !inflater.Finished();
+	}));
+
+	if (!inflated)
+	{
+		return PA_REPLAY_ERROR("Failed to inflate decrypted replay data with zlib.");
+	}
+
+	if (!inflater.Finished())
+	{
+		return PA_REPLAY_ERROR("Replay zlib stream ended unexpectedly.");
+	}
+
+	if (!remaining.empty())
+	{
+		return PA_REPLAY_ERROR("Replay decompressed data != decompressedSize");
+	}
+
+	return {};
+}
+
+// maps the replay file for the duration of the callback
+template<typename F>
+static ReplayResult<void> MapReplayFile(const fs::path& filePath, F&& then)
+{
 	File file = File::Open(filePath, File::Flags::Open | File::Flags::Read | File::Flags::ShareRead | File::Flags::ShareWrite);
 	if (!file)
 	{
@@ -48,16 +231,43 @@ ReplayResult<Replay> Replay::FromFile(const fs::path& filePath, const fs::path&
 	}
 
 	void* mapping = fileMapping.Map(FileMapping::Flags::Read, 0, fileSize);
-	std::span<const Byte> data{ static_cast<const Byte*>(mapping), fileSize };
+	if (mapping == nullptr)
+	{
+		return PA_REPLAY_ERROR("Failed to map view of replay file: {}", fileMapping.LastError());
+	}
 
-	Replay replay;
+	ReplayResult<void> result = then(std::span<const Byte>{ static_cast<const Byte*>(mapping), fileSize });
+
+	fileMapping.Unmap(mapping, fileSize);
+	fileMapping.Close();
+	file.Close();
+
+	return result;
+}
+
+// magic, blocksCount and metaSize in front of the meta json
+static constexpr size_t g_preambleSize = 12;
+
+static ReplayResult<void> ParseMeta(std::string_view metaString, ReplayMeta& meta)
+{
+	PA_TRY_OR_ELSE(js, ParseJson(metaString),
+	{
+		return PA_REPLAY_ERROR("Failed to parse replay meta as JSON: {}", error);
+	});
+	PA_TRYV(FromJson(js, meta));
+	return {};
+}
+
+static ReplayResult<ReplayLayout> ParseHeader(std::span<const Byte> data)
+{
+	ReplayLayout header;
 
 	if (data.size() < 8)
 	{
 		return PA_REPLAY_ERROR("Replay has invalid length {} < 8.", data.size());
 	}
 
-	if (!Core::FileMagic<'\x12', '2', '4', '\x11'>(data))
+	if (!FileMagic<'\x12', '2', '4', '\x11'>(data))
 	{
 		return PA_REPLAY_ERROR("Replay has invalid file signature.");
 	}
@@ -78,14 +288,10 @@ ReplayResult<Replay> Replay::FromFile(const fs::path& filePath, const fs::path&
 	{
 		return PA_REPLAY_ERROR("Replay is missing meta info.");
 	}
-	replay.MetaString.resize(metaSize);
-	std::memcpy(replay.MetaString.data(), Take(data, metaSize).data(), metaSize);
+	header.MetaString.resize(metaSize);
+	std::memcpy(header.MetaString.data(), Take(data, metaSize).data(), metaSize);
 
-	PA_TRY_OR_ELSE(js, Core::ParseJson(replay.MetaString),
-	{
-		return PA_REPLAY_ERROR("Failed to parse replay meta as JSON: {}", error);
-	});
-	PA_TRYV(FromJson(js, replay.Meta));
+	PA_TRYV(ParseMeta(header.MetaString, header.Meta));
 
 	for (size_t i = 0; i < blocksCount - 1; i++)
 	{
@@ -94,12 +300,15 @@ ReplayResult<Replay> Replay::FromFile(const fs::path& filePath, const fs::path&
 		{
 			return PA_REPLAY_ERROR("Replay is missing blockSize.");
 		}
+		if (blockSize > data.size())
+		{
+			return PA_REPLAY_ERROR("Replay block is truncated.");
+		}
 		if (blockSize > 0)
 			Take(data, blockSize);
 	}
-	
-	uint32_t decompressedSize;
-	if (!TakeInto(data, decompressedSize))
+
+	if (!TakeInto(data, header.DecompressedSize))
 	{
 		return PA_REPLAY_ERROR("Replay is missing decompressedSize.");
 	}
@@ -115,92 +324,204 @@ ReplayResult<Replay> Replay::FromFile(const fs::path& filePath, const fs::path&
 		//return PA_REPLAY_ERROR("Replay data != streamSize");
 	}
 
-	if (data.size() % Blowfish::BlockSize() != 0)
+	header.Payload = data;
+	return header;
+}
+
+static ReplayResult<EntitySpecs> LoadEntitySpecs(Version version, const fs::path& gameFilePath)
+{
+	PA_TRY(specs, GetEntitySpecs(version, gameFilePath));
+	if (specs->empty())
 	{
-		return PA_REPLAY_ERROR("Replay data is not a multiple of blowfish block size.");
+		return PA_REPLAY_ERROR("Empty entity specs");
 	}
+	return specs;
+}
 
-	std::vector<Byte> decrypted{};
-	decrypted.resize(data.size(), Byte{ 0 });
+}  // namespace
 
-	constexpr std::array<Byte, 16> key = { 0x29, 0xB7, 0xC9, 0x09, 0x38, 0x3F, 0x84, 0x88, 0xFA, 0x98, 0xEC, 0x4E, 0x13, 0x19, 0x79, 0xFB };
-	const Blowfish blowfish(key);
+ReplayResult<Replay> Replay::FromFile(const fs::path& filePath, const fs::path& gameFilePath)
+{
+	PA_PROFILE_FUNCTION();
 
-	Byte prev[8] = { Byte{ 0 } };
-	for (size_t i = 0; i < data.size() / Blowfish::BlockSize(); i++)
+	Replay replay;
+
+	PA_TRYV(MapReplayFile(filePath, [&replay, &gameFilePath](std::span<const Byte> data) -> ReplayResult<void>
 	{
-		const size_t offset = i * Blowfish::BlockSize();
+		PA_TRY(header, ParseHeader(data));
+		replay.MetaString = std::move(header.MetaString);
+		replay.Meta = std::move(header.Meta);
 
-		uint32_t block[2];
-		std::memcpy(block, data.data() + offset, sizeof(block));
+		// the specs are needed before the first packet comes out of the stream
+		PA_TRYA(replay.Specs, LoadEntitySpecs(replay.Meta.ClientVersionFromExe, gameFilePath));
+		replay.m_packetParser.Specs = *replay.Specs;
+		replay.m_packetParser.Memory = replay.m_arena->Resource();
+		replay.m_packetParser.Dispatch = PacketDispatchTable(replay.Meta.ClientVersionFromExe);
 
-		Blowfish::ReverseByteOrder(block[0]);
-		Blowfish::ReverseByteOrder(block[1]);
-		blowfish.DecryptBlock(&block[0], &block[1]);
-		Blowfish::ReverseByteOrder(block[0]);
-		Blowfish::ReverseByteOrder(block[1]);
+		return DecodePayload(header.Payload, header.DecompressedSize, [&replay](std::span<const Byte> frame) -> ReplayResult<void>
+		{
+			PA_TRY(packet, ParsePacket(frame, replay.m_packetParser));
+			replay.Packets.emplace_back(std::move(packet));
+			return {};
+		});
+	}));
 
-		std::memcpy(decrypted.data() + offset, block, sizeof(block));
+	return replay;
+}
 
-		for (size_t j = 0; j < Blowfish::BlockSize(); j++)
+ReplayResult<ReplayView> ReplayView::FromFile(const fs::path& filePath, const fs::path& gameFilePath, ReplayCache* cache)
+{
+	PA_PROFILE_FUNCTION();
+
+	ReplayView view;
+
+	PA_TRYV(MapReplayFile(filePath, [&view, &gameFilePath, cache](std::span<const Byte> data) -> ReplayResult<void>
+	{
+		PA_TRY(header, ParseHeader(data));
+		view.MetaString = std::move(header.MetaString);
+		view.Meta = std::move(header.Meta);
+
+		PA_TRYA(view.Specs, LoadEntitySpecs(view.Meta.ClientVersionFromExe, gameFilePath));
+		view.m_packetParser.Specs = *view.Specs;
+		view.m_packetParser.Memory = view.m_arena->Resource();
+		view.m_packetParser.Dispatch = PacketDispatchTable(view.Meta.ClientVersionFromExe);
+
+		// keyed like the ReplaySummary, so the replay is found again no matter where the file was moved to
+		std::string hash;
+		if (cache != nullptr)
 		{
-			decrypted[offset + j] = decrypted[offset + j] ^ prev[j];
-			prev[j] = decrypted[offset + j];
+			if (!Sha256(view.MetaString, hash))
+			{
+				return PA_REPLAY_ERROR("Failed to get SHA256 hash of replay meta");
+			}
+			view.m_cache = cache;
+			view.m_cacheKey = hash;
+
+			if (cache->Load(hash, view.m_cached))
+			{
+				view.m_data = view.m_cached.Data();
+				view.m_index = view.m_cached.Index();
+				return {};
+			}
 		}
-	}
 
-	fileMapping.Close();
-	file.Close();
+		view.m_decodedData.resize(header.DecompressedSize);
+		PA_TRYV(DecodePayloadInto(header.Payload, view.m_decodedData));
+
+		std::span<const Byte> frames = view.m_decodedData;
+		PA_TRYV(SplitFrames(frames, [&view](std::span<const Byte> frame) -> ReplayResult<void>
+		{
+			PacketIndexEntry entry;
+			std::memcpy(&entry.Size, frame.data(), sizeof(entry.Size));
+			std::memcpy(&entry.Type, frame.data() + 4, sizeof(entry.Type));
+			std::memcpy(&entry.Clock, frame.data() + 8, sizeof(entry.Clock));
+			entry.Offset = static_cast<uint32_t>(frame.data() - view.m_decodedData.data() + g_packetHeaderSize);
 
-	const std::vector<Byte> decompressed = Zlib::Inflate(decrypted);
-	if (decompressed.empty())
+			view.m_decodedIndex.emplace_back(entry);
+			return {};
+		}));
+
+		if (!frames.empty())
+		{
+			return PA_REPLAY_ERROR("Replay has a truncated packet of {} bytes at the end.", frames.size());
+		}
+
+		view.m_data = view.m_decodedData;
+		view.m_index = view.m_decodedIndex;
+
+		if (cache != nullptr)
+		{
+			if (ReplayResult<void> stored = cache->Store(hash, view.m_index, view.m_data); !stored)
+			{
+				LOG_WARN("Failed to store replay in cache: {}", stored.error());
+			}
+		}
+		return {};
+	}));
+
+	return view;
+}
+
+ReplayResult<rp::ReplayHeader> rp::ReadReplayHeader(const fs::path& filePath)
+{
+	PA_PROFILE_FUNCTION();
+
+	const File file = File::Open(filePath, File::Flags::Open | File::Flags::Read | File::Flags::ShareRead | File::Flags::ShareWrite);
+	if (!file)
 	{
-		return PA_REPLAY_ERROR("Failed to inflate decrypted replay data with zlib.");
+		return PA_REPLAY_ERROR("Failed to open replay file: {}", File::LastError());
+	}
+
+	const uint64_t fileSize = file.Size();
+	std::vector<Byte> preamble;
+	if (fileSize < g_preambleSize || !file.Read(preamble, g_preambleSize))
+	{
+		return PA_REPLAY_ERROR("Replay has invalid length {} < {}.", fileSize, g_preambleSize);
 	}
 
-	if (decompressed.size() != decompressedSize)
+	std::span<const Byte> data = preamble;
+	if (!FileMagic<'\x12', '2', '4', '\x11'>(data))
 	{
-		return PA_REPLAY_ERROR("Replay decompressed data != decompressedSize");
+		return PA_REPLAY_ERROR("Replay has invalid file signature.");
 	}
 
-	// free memory of decrypted data
-	decrypted.clear();
-	decrypted.shrink_to_fit();
+	uint32_t blocksCount;
+	uint32_t metaSize;
+	TakeInto(data, blocksCount);
+	TakeInto(data, metaSize);
+	if (fileSize - g_preambleSize < metaSize)
+	{
+		return PA_REPLAY_ERROR("Replay is missing meta info.");
+	}
 
-	PA_TRYA(replay.Specs, ParseScripts(replay.Meta.ClientVersionFromExe, gameFilePath));
+	ReplayHeader header;
+	if (!file.ReadAllString(header.MetaString, metaSize, false) || header.MetaString.size() != metaSize)
+	{
+		return PA_REPLAY_ERROR("Failed to read replay meta: {}", File::LastError());
+	}
+	PA_TRYV(ParseMeta(header.MetaString, header.Meta));
 
-	if (replay.Specs.empty())
+	if (!Sha256(header.MetaString, header.Hash))
 	{
-		return PA_REPLAY_ERROR("Empty entity specs");
+		return PA_REPLAY_ERROR("Failed to get SHA256 hash of replay meta");
 	}
 
-	replay.m_packetParser.Specs = replay.Specs;
+	return header;
+}
 
-	std::span out{ decompressed };
-	do {
-		PA_TRY(packet, ParsePacket(out, replay.m_packetParser, replay.Meta.ClientVersionFromExe));
-		replay.Packets.emplace_back(std::move(packet));
-	} while (!out.empty());
+ReplayResult<ReplayLayout> rp::ReadReplayLayout(std::span<const Byte> data)
+{
+	return ParseHeader(data);
+}
 
-	// sort the packets by game time
-	// std::ranges::sort(replay.Packets, [](const PacketType& a, const PacketType& b)
-	// {
-	// 	const Packet& aPacket = std::visit([](const auto& x) -> const Packet& { return x; }, a);
-	// 	const Packet& bPacket = std::visit([](const auto& x) -> const Packet& { return x; }, b);
-	// 	return aPacket.Clock < bPacket.Clock;
-	// });
+ReplayResult<void> rp::DecryptReplayPayload(std::span<const Byte> payload, std::span<Byte> out)
+{
+	if (payload.size() % Blowfish::BlockSize() != 0)
+	{
+		return PA_REPLAY_ERROR("Replay data is not a multiple of blowfish block size.");
+	}
 
-	return replay;
+	if (out.size() != payload.size())
+	{
+		return PA_REPLAY_ERROR("Replay decryption buffer has size {} != {}.", out.size(), payload.size());
+	}
+
+	std::array<Byte, Blowfish::BlockSize()> chain = {};
+	if (!Blowfish(g_replayKey).DecryptChained(payload, out, chain))
+	{
+		return PA_REPLAY_ERROR("Failed to decrypt replay data.");
+	}
+	return {};
 }
 
-ReplayResult<ReplaySummary> rp::AnalyzeReplay(const fs::path& file, const fs::path& gameFilePath)
+ReplayResult<ReplaySummary> rp::AnalyzeReplay(const fs::path& file, const fs::path& gameFilePath, ReplayCache* cache)
 {
-	PA_TRY(replay, Replay::FromFile(file, gameFilePath));
+	PA_TRY(replay, ReplayView::FromFile(file, gameFilePath, cache));
 	PA_TRY(summary, replay.Analyze());
 	return summary;
 }
 
 bool rp::HasGameScripts(Version gameVersion, const fs::path& gameFilePath)
 {
-	return ParseScripts(gameVersion, gameFilePath).has_value();
+	return GetEntitySpecs(gameVersion, gameFilePath).has_value();
 }
@@ -0,0 +1,422 @@
+// Copyright 2024 <github.com/razaqq>
+
+#include "Core/Bytes.hpp"
+#include "Core/Instrumentor.hpp"
+#include "Core/Log.hpp"
+
+#include "ReplayParser/PacketParser.hpp"
+#include "ReplayParser/Packets.hpp"
+#include "ReplayParser/ReplayCache.hpp"
+#include "ReplayParser/ReplayView.hpp"
+#include "ReplayParser/Result.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+
+using PotatoAlert::Core::Take;
+using PotatoAlert::Core::TakeInto;
+using PotatoAlert::ReplayParser::ReplayView;
+using namespace PotatoAlert::ReplayParser;
+
+namespace {
+
+// bump this whenever the layout of the serialized keyframes changes
+static constexpr uint32_t g_keyframeFormatVersion = 1;
+static constexpr std::array<Byte, 4> g_keyframeMagic = { 'P', 'A', 'K', 'F' };
+
+class KeyframeWriter
+{
+public:
+	explicit KeyframeWriter(std::vector<Byte>& out) : m_out(out) {}
+
+	template<typename T> requires std::is_trivially_copyable_v<T>
+	void Write(T value)
+	{
+		const size_t pos = m_out.size();
+		m_out.resize(pos + sizeof(T));
+		std::memcpy(m_out.data() + pos, &value, sizeof(T));
+	}
+
+	void Write(std::span<const Byte> bytes)
+	{
+		Write(static_cast<uint32_t>(bytes.size()));
+		m_out.insert(m_out.end(), bytes.begin(), bytes.end());
+	}
+
+	void Write(const ArgValue& value)
+	{
+		Write(static_cast<uint8_t>(value.index()));
+		std::visit([this]<typename T>(const T& v)
+		{
+			if constexpr (std::is_same_v<T, ArgString>)
+			{
+				Write(std::span{ reinterpret_cast<const Byte*>(v.data()), v.size() });
+			}
+			else if constexpr (std::is_same_v<T, ArgBlob>)
+			{
+				Write(std::span<const Byte>(v));
+			}
+			else if constexpr (std::is_same_v<T, ArgArray>)
+			{
+				Write(static_cast<uint32_t>(v.size()));
+				for (const ArgValue& element : v)
+				{
+					Write(element);
+				}
+			}
+			else if constexpr (std::is_same_v<T, ArgDict>)
+			{
+				Write(static_cast<uint32_t>(v.size()));
+				for (const auto& [key, element] : v)
+				{
+					Write(std::span{ reinterpret_cast<const Byte*>(key.data()), key.size() });
+					Write(element);
+				}
+			}
+			else
+			{
+				Write<T>(v);
+			}
+		}, static_cast<const ValueVariant&>(value));
+	}
+
+	void Write(const PropertySlots& slots)
+	{
+		Write(static_cast<uint32_t>(slots.size()));
+		for (const std::optional<ArgValue>& slot : slots)
+		{
+			Write(static_cast<uint8_t>(slot.has_value()));
+			if (slot)
+			{
+				Write(*slot);
+			}
+		}
+	}
+
+private:
+	std::vector<Byte>& m_out;
+};
+
+class KeyframeReader
+{
+public:
+	KeyframeReader(std::span<const Byte> data, std::pmr::memory_resource* memory) : m_data(data), m_memory(memory) {}
+
+	template<typename T> requires std::is_trivially_copyable_v<T>
+	ReplayResult<T> Read()
+	{
+		T value;
+		if (!TakeInto(m_data, value))
+		{
+			return PA_REPLAY_ERROR("Keyframes are truncated.");
+		}
+		return value;
+	}
+
+	ReplayResult<std::span<const Byte>> ReadBytes()
+	{
+		PA_TRY(size, Read<uint32_t>());
+		if (m_data.size() < size)
+		{
+			return PA_REPLAY_ERROR("Keyframes are truncated.");
+		}
+		return Take(m_data, size);
+	}
+
+	ReplayResult<ArgValue> ReadValue()
+	{
+		PA_TRY(index, Read<uint8_t>());
+		return ReadAlternative(index);
+	}
+
+	ReplayResult<PropertySlots> ReadSlots(size_t expected)
+	{
+		PA_TRY(size, Read<uint32_t>());
+		if (size != expected)
+		{
+			return PA_REPLAY_ERROR("Keyframe entity has {} properties instead of {}.", size, expected);
+		}
+
+		PropertySlots slots(size, m_memory);
+		for (std::optional<ArgValue>& slot : slots)
+		{
+			PA_TRY(present, Read<uint8_t>());
+			if (present)
+			{
+				PA_TRY(value, ReadValue());
+				slot = std::move(value);
+			}
+		}
+		return slots;
+	}
+
+	[[nodiscard]] bool Empty() const
+	{
+		return m_data.empty();
+	}
+
+private:
+	template<size_t I = 0>
+	ReplayResult<ArgValue> ReadAlternative(size_t index)
+	{
+		if constexpr (I == std::variant_size_v<ValueVariant>)
+		{
+			return PA_REPLAY_ERROR("Keyframes have an invalid value type {}.", index);
+		}
+		else
+		{
+			if (index != I)
+			{
+				return ReadAlternative<I + 1>(index);
+			}
+
+			using T = std::variant_alternative_t<I, ValueVariant>;
+			if constexpr (std::is_same_v<T, ArgString>)
+			{
+				PA_TRY(bytes, ReadBytes());
+				return ArgValue(ArgString(reinterpret_cast<const char*>(bytes.data()), bytes.size(), m_memory));
+			}
+			else if constexpr (std::is_same_v<T, ArgBlob>)
+			{
+				PA_TRY(bytes, ReadBytes());
+				return ArgValue(ArgBlob(bytes.begin(), bytes.end(), m_memory));
+			}
+			else if constexpr (std::is_same_v<T, ArgArray>)
+			{
+				PA_TRY(size, Read<uint32_t>());
+				ArgArray array(m_memory);
+				for (uint32_t i = 0; i < size; i++)
+				{
+					PA_TRY(element, ReadValue());
+					array.emplace_back(std::move(element));
+				}
+				return ArgValue(std::move(array));
+			}
+			else if constexpr (std::is_same_v<T, ArgDict>)
+			{
+				PA_TRY(size, Read<uint32_t>());
+				ArgDict dict(m_memory);
+				for (uint32_t i = 0; i < size; i++)
+				{
+					PA_TRY(key, ReadBytes());
+					PA_TRY(element, ReadValue());
+					dict.emplace(ArgString(reinterpret_cast<const char*>(key.data()), key.size(), m_memory), std::move(element));
+				}
+				return ArgValue(std::move(dict));
+			}
+			else
+			{
+				PA_TRY(value, Read<T>());
+				return ArgValue(value);
+			}
+		}
+	}
+
+	std::span<const Byte> m_data;
+	std::pmr::memory_resource* m_memory;
+};
+
+}  // namespace
+
+void ReplayView::BeginVisit(const PacketFilter& filter)
+{
+	// nothing allocated by a previous visit is alive anymore once the entities are gone
+	m_packetParser.Entities.Clear();
+	m_arena->Release();
+	m_packetParser.Interest = ResolvePacketFilter(filter, m_packetParser.Specs);
+}
+
+ReplayResult<void> ReplayView::Visit(const PacketFilter& filter, const Visitor& visitor)
+{
+	PA_PROFILE_FUNCTION();
+
+	return VisitPackets(filter, visitor);
+}
+
+ReplayResult<size_t> ReplayView::ApplyEntityPackets(size_t begin, float clock)
+{
+	// the packets are only replayed to get to the entity state, the callbacks are not told about them again
+	PacketCallbacks callbacks = std::exchange(m_packetParser.Callbacks, {});
+	const ReplayResult<size_t> result = [this, begin, clock]() -> ReplayResult<size_t>
+	{
+		for (size_t i = begin; i < m_index.size(); i++)
+		{
+			const PacketIndexEntry& entry = m_index[i];
+			if (entry.Clock > clock)
+				return i;
+
+			const PacketDispatchTable::Entry* dispatch = m_packetParser.Dispatch.Find(entry.Type);
+			if (dispatch == nullptr || !ChangesEntityState(dispatch->Type))
+				continue;
+
+			PA_TRYD(ParsePacket(Payload(entry), entry.Type, entry.Clock, m_packetParser));
+		}
+		return m_index.size();
+	}();
+	m_packetParser.Callbacks = std::move(callbacks);
+	return result;
+}
+
+ReplayResult<void> ReplayView::BuildKeyframes(float interval)
+{
+	PA_PROFILE_FUNCTION();
+
+	if (!(interval > 0.0f))
+	{
+		return PA_REPLAY_ERROR("Keyframe interval has to be positive, was {}", interval);
+	}
+
+	m_packetParser.Entities.Clear();
+	m_arena->Release();
+
+	std::vector<Byte> stored;
+	if (m_cache != nullptr && m_cache->LoadKeyframes(m_cacheKey, interval, stored) && LoadKeyframes(stored))
+	{
+		return {};
+	}
+
+	m_keyframes.clear();
+	m_keyframeArena->Release();
+
+	size_t position = 0;
+	for (size_t step = 1; position < m_index.size(); step++)
+	{
+		const float clock = interval * static_cast<float>(step);
+		PA_TRYA(position, ApplyEntityPackets(position, clock));
+
+		// nothing happened since the last one, so this would be the very same snapshot
+		if (position == m_index.size() || (!m_keyframes.empty() && m_keyframes.back().Position == position))
+			continue;
+
+		m_keyframes.emplace_back(Keyframe{ clock, static_cast<uint32_t>(position), m_packetParser.Entities.Clone(m_keyframeArena->Resource()) });
+	}
+
+	if (m_cache != nullptr)
+	{
+		if (ReplayResult<void> result = m_cache->StoreKeyframes(m_cacheKey, interval, SerializeKeyframes()); !result)
+		{
+			LOG_WARN("Failed to store replay keyframes in cache: {}", result.error());
+		}
+	}
+	return {};
+}
+
+ReplayResult<void> ReplayView::SeekTo(float clock)
+{
+	PA_PROFILE_FUNCTION();
+
+	m_packetParser.Entities.Clear();
+	m_arena->Release();
+
+	size_t position = 0;
+	if (const auto next = std::ranges::upper_bound(m_keyframes, clock, {}, &Keyframe::Clock); next != m_keyframes.begin())
+	{
+		const Keyframe& keyframe = *std::prev(next);
+		m_packetParser.Entities = keyframe.Entities.Clone(m_arena->Resource());
+		position = keyframe.Position;
+	}
+
+	PA_TRYD(ApplyEntityPackets(position, clock));
+	return {};
+}
+
+std::vector<Byte> ReplayView::SerializeKeyframes() const
+{
+	std::vector<Byte> data;
+	data.insert(data.end(), g_keyframeMagic.begin(), g_keyframeMagic.end());
+	KeyframeWriter writer(data);
+	writer.Write(g_keyframeFormatVersion);
+	writer.Write(static_cast<uint32_t>(m_index.size()));
+	writer.Write(static_cast<uint32_t>(m_keyframes.size()));
+
+	for (const Keyframe& keyframe : m_keyframes)
+	{
+		writer.Write(keyframe.Clock);
+		writer.Write(keyframe.Position);
+		writer.Write(static_cast<uint32_t>(keyframe.Entities.Size()));
+		for (size_t i = 0; i < keyframe.Entities.Size(); i++)
+		{
+			const Entity& entity = keyframe.Entities.Entities()[i];
+			writer.Write(keyframe.Entities.Id(i));
+			writer.Write(entity.Type);
+			writer.Write(entity.BasePropertiesValues);
+			writer.Write(entity.ClientPropertiesValues);
+		}
+	}
+
+	return data;
+}
+
+ReplayResult<void> ReplayView::LoadKeyframes(std::span<const Byte> data)
+{
+	PA_PROFILE_FUNCTION();
+
+	if (data.size() < g_keyframeMagic.size() || !std::equal(g_keyframeMagic.begin(), g_keyframeMagic.end(), data.begin()))
+	{
+		return PA_REPLAY_ERROR("Keyframes have an invalid signature.");
+	}
+
+	// everything is read into a fresh arena first, so a broken file leaves the current keyframes alone
+	std::unique_ptr<ReplayArena> arena = std::make_unique<ReplayArena>();
+	KeyframeReader reader(data.subspan(g_keyframeMagic.size()), arena->Resource());
+
+	PA_TRY(formatVersion, reader.Read<uint32_t>());
+	if (formatVersion != g_keyframeFormatVersion)
+	{
+		return PA_REPLAY_ERROR("Keyframes have format version {} instead of {}.", formatVersion, g_keyframeFormatVersion);
+	}
+	PA_TRY(packetCount, reader.Read<uint32_t>());
+	if (packetCount != m_index.size())
+	{
+		return PA_REPLAY_ERROR("Keyframes were built for a replay with {} packets instead of {}.", packetCount, m_index.size());
+	}
+
+	PA_TRY(keyframeCount, reader.Read<uint32_t>());
+	std::vector<Keyframe> keyframes;
+	for (uint32_t i = 0; i < keyframeCount; i++)
+	{
+		PA_TRY(clock, reader.Read<float>());
+		PA_TRY(position, reader.Read<uint32_t>());
+		if (position > m_index.size() || (!keyframes.empty() && clock < keyframes.back().Clock))
+		{
+			return PA_REPLAY_ERROR("Keyframe {} is out of order.", i);
+		}
+
+		PA_TRY(entityCount, reader.Read<uint32_t>());
+		EntityTable entities;
+		for (uint32_t j = 0; j < entityCount; j++)
+		{
+			PA_TRY(id, reader.Read<TypeEntityId>());
+			PA_TRY(type, reader.Read<uint16_t>());
+			if (type == 0 || type > m_packetParser.Specs.size())
+			{
+				return PA_REPLAY_ERROR("Keyframe entity {} has invalid type {}.", id, type);
+			}
+
+			const EntitySpec& spec = m_packetParser.Specs[type - 1];
+			PA_TRY(baseProperties, reader.ReadSlots(spec.BaseProperties.size()));
+			PA_TRY(clientProperties, reader.ReadSlots(spec.ClientProperties.size()));
+			entities.InsertOrAssign(id, Entity{ type, spec, std::move(baseProperties), std::move(clientProperties) });
+		}
+
+		keyframes.emplace_back(Keyframe{ clock, position, std::move(entities) });
+	}
+
+	if (!reader.Empty())
+	{
+		return PA_REPLAY_ERROR("Keyframes have trailing data.");
+	}
+
+	m_keyframes = std::move(keyframes);
+	m_keyframeArena = std::move(arena);
+	return {};
+}
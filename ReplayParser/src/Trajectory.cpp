@@ -0,0 +1,281 @@
+// Copyright 2024 <github.com/razaqq>
+
+#include "Core/Bytes.hpp"
+#include "Core/Math.hpp"
+
+#include "ReplayParser/Packets.hpp"
+#include "ReplayParser/ReplayView.hpp"
+#include "ReplayParser/Result.hpp"
+#include "ReplayParser/Trajectory.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <variant>
+#include <vector>
+
+
+using namespace PotatoAlert::ReplayParser;
+
+namespace {
+
+// bump this whenever the layout of the serialized trajectories changes
+static constexpr uint32_t g_trajectoryFormatVersion = 1;
+static constexpr std::array<Byte, 4> g_trajectoryMagic = { 'P', 'A', 'T', 'R' };
+
+static constexpr double g_clockScale = 1000.0;
+static constexpr double g_positionScale = 100.0;
+static constexpr double g_yawScale = 10000.0;
+
+static void WriteVarint(std::vector<Byte>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<Byte>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<Byte>(value));
+}
+
+static bool ReadVarint(std::span<const Byte>& data, uint64_t& value)
+{
+	value = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7)
+	{
+		if (data.empty())
+			return false;
+		const uint8_t byte = static_cast<uint8_t>(data.front());
+		data = data.subspan(1);
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+static uint64_t ZigZag(int64_t value)
+{
+	return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t UnZigZag(uint64_t value)
+{
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// each value is stored as the difference to the one before, so a smooth track is mostly single bytes
+static void WriteColumn(std::vector<Byte>& out, const std::vector<float>& column, double scale)
+{
+	int64_t previous = 0;
+	for (const float value : column)
+	{
+		const int64_t quantized = std::llround(static_cast<double>(value) * scale);
+		WriteVarint(out, ZigZag(quantized - previous));
+		previous = quantized;
+	}
+}
+
+static bool ReadColumn(std::span<const Byte>& data, std::vector<float>& column, size_t size, double scale)
+{
+	column.reserve(size);
+	int64_t previous = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		uint64_t delta;
+		if (!ReadVarint(data, delta))
+			return false;
+		previous += UnZigZag(delta);
+		column.push_back(static_cast<float>(static_cast<double>(previous) / scale));
+	}
+	return true;
+}
+
+}  // namespace
+
+void TrajectoryStore::Add(TypeEntityId entityId, float clock, const Vec3& position, float yaw)
+{
+	Trajectory& trajectory = m_trajectories[entityId];
+
+	if (m_tolerance > 0.0f && trajectory.Size() >= 2)
+	{
+		std::vector<Sample>& dropped = m_dropped[entityId];
+		const size_t last = trajectory.Size() - 1;
+		const Sample anchor{ trajectory.Clock[last - 1], { trajectory.X[last - 1], trajectory.Y[last - 1], trajectory.Z[last - 1] } };
+		const Sample candidate{ trajectory.Clock[last], { trajectory.X[last], trajectory.Y[last], trajectory.Z[last] } };
+
+		const auto withinTolerance = [this, &anchor, clock, &position](const Sample& sample)
+		{
+			const float t = (sample.Clock - anchor.Clock) / (clock - anchor.Clock);
+			const float dx = anchor.Position.X + (position.X - anchor.Position.X) * t - sample.Position.X;
+			const float dy = anchor.Position.Y + (position.Y - anchor.Position.Y) * t - sample.Position.Y;
+			const float dz = anchor.Position.Z + (position.Z - anchor.Position.Z) * t - sample.Position.Z;
+			return dx * dx + dy * dy + dz * dz <= m_tolerance * m_tolerance;
+		};
+
+		// the last sample is replaced by the new one, if the line from the anchor still runs close enough by everything in between
+		if (clock > anchor.Clock && withinTolerance(candidate) && std::ranges::all_of(dropped, withinTolerance))
+		{
+			dropped.push_back(candidate);
+			trajectory.Clock[last] = clock;
+			trajectory.X[last] = position.X;
+			trajectory.Y[last] = position.Y;
+			trajectory.Z[last] = position.Z;
+			trajectory.Yaw[last] = yaw;
+			return;
+		}
+		dropped.clear();
+	}
+
+	trajectory.Add(clock, position, yaw);
+}
+
+void TrajectoryStore::Add(const PlayerPositionPacket& packet)
+{
+	Add(packet.EntityId, packet.Clock, packet.Position, packet.Rotation.Yaw);
+}
+
+void TrajectoryStore::Add(const PlayerOrientationPacket& packet)
+{
+	if (packet.ParentId != 0)
+		return;
+	Add(static_cast<TypeEntityId>(packet.Pid), packet.Clock, packet.Position, packet.Rotation.Yaw);
+}
+
+const Trajectory* TrajectoryStore::Find(TypeEntityId entityId) const
+{
+	if (const auto it = m_trajectories.find(entityId); it != m_trajectories.end())
+	{
+		return &it->second;
+	}
+	return nullptr;
+}
+
+std::vector<Byte> TrajectoryStore::Serialize() const
+{
+	std::vector<Byte> data(g_trajectoryMagic.begin(), g_trajectoryMagic.end());
+	WriteVarint(data, g_trajectoryFormatVersion);
+
+	// sorted, so the same trajectories always give the same bytes
+	std::vector<TypeEntityId> ids;
+	ids.reserve(m_trajectories.size());
+	for (const auto& [id, trajectory] : m_trajectories)
+	{
+		ids.push_back(id);
+	}
+	std::ranges::sort(ids);
+
+	WriteVarint(data, ids.size());
+	for (const TypeEntityId id : ids)
+	{
+		const Trajectory& trajectory = m_trajectories.at(id);
+		WriteVarint(data, ZigZag(id));
+		WriteVarint(data, trajectory.Size());
+		WriteColumn(data, trajectory.Clock, g_clockScale);
+		WriteColumn(data, trajectory.X, g_positionScale);
+		WriteColumn(data, trajectory.Y, g_positionScale);
+		WriteColumn(data, trajectory.Z, g_positionScale);
+		WriteColumn(data, trajectory.Yaw, g_yawScale);
+	}
+
+	return data;
+}
+
+ReplayResult<TrajectoryStore> TrajectoryStore::Deserialize(std::span<const Byte> data)
+{
+	if (data.size() < g_trajectoryMagic.size() || !std::equal(g_trajectoryMagic.begin(), g_trajectoryMagic.end(), data.begin()))
+	{
+		return PA_REPLAY_ERROR("Trajectories have an invalid signature.");
+	}
+	data = data.subspan(g_trajectoryMagic.size());
+
+	uint64_t formatVersion;
+	if (!ReadVarint(data, formatVersion) || formatVersion != g_trajectoryFormatVersion)
+	{
+		return PA_REPLAY_ERROR("Trajectories have an unsupported format version.");
+	}
+
+	uint64_t count;
+	if (!ReadVarint(data, count))
+	{
+		return PA_REPLAY_ERROR("Trajectories are truncated.");
+	}
+
+	TrajectoryStore store;
+	for (uint64_t i = 0; i < count; i++)
+	{
+		uint64_t id;
+		uint64_t size;
+		if (!ReadVarint(data, id) || !ReadVarint(data, size))
+		{
+			return PA_REPLAY_ERROR("Trajectories are truncated.");
+		}
+		// every sample takes at least one byte per column
+		if (size > data.size())
+		{
+			return PA_REPLAY_ERROR("Trajectory of entity {} has an invalid size {}.", UnZigZag(id), size);
+		}
+
+		Trajectory& trajectory = store.m_trajectories[static_cast<TypeEntityId>(UnZigZag(id))];
+		if (trajectory.Size() != 0)
+		{
+			return PA_REPLAY_ERROR("Trajectory of entity {} is stored twice.", UnZigZag(id));
+		}
+		if (!ReadColumn(data, trajectory.Clock, size, g_clockScale) ||
+			!ReadColumn(data, trajectory.X, size, g_positionScale) ||
+			!ReadColumn(data, trajectory.Y, size, g_positionScale) ||
+			!ReadColumn(data, trajectory.Z, size, g_positionScale) ||
+			!ReadColumn(data, trajectory.Yaw, size, g_yawScale))
+		{
+			return PA_REPLAY_ERROR("Trajectories are truncated.");
+		}
+	}
+
+	if (!data.empty())
+	{
+		return PA_REPLAY_ERROR("Trajectories have trailing data.");
+	}
+
+	return store;
+}
+
+TrajectoryStore PotatoAlert::ReplayParser::CollectTrajectories(std::span<const PacketType> packets, float tolerance)
+{
+	TrajectoryStore store(tolerance);
+	for (const PacketType& packet : packets)
+	{
+		if (const PlayerPositionPacket* position = std::get_if<PlayerPositionPacket>(&packet))
+		{
+			store.Add(*position);
+		}
+		else if (const PlayerOrientationPacket* orientation = std::get_if<PlayerOrientationPacket>(&packet))
+		{
+			store.Add(*orientation);
+		}
+	}
+	return store;
+}
+
+ReplayResult<TrajectoryStore> PotatoAlert::ReplayParser::CollectTrajectories(ReplayView& view, float tolerance)
+{
+	struct Collector
+	{
+		TrajectoryStore& Store;
+
+		void operator()(const PlayerPositionPacket& packet) const
+		{
+			Store.Add(packet);
+		}
+
+		void operator()(const PlayerOrientationPacket& packet) const
+		{
+			Store.Add(packet);
+		}
+	};
+
+	TrajectoryStore store(tolerance);
+	Collector collector{ store };
+	PA_TRYV(view.Visit(collector));
+	return store;
+}
@@ -8,6 +8,9 @@
 #include "ReplayParser/Result.hpp"
 #include "ReplayParser/Types.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <span>
@@ -27,7 +30,7 @@ using Core::TakeString;
 
 namespace {
 
-static ReplayResult<ArgValue> ParsePrimitive(PrimitiveType type, std::span<const Byte>& data)
+static ReplayResult<ArgValue> ParsePrimitive(PrimitiveType type, std::span<const Byte>& data, std::pmr::memory_resource* memory)
 {
 	switch (type.Type)
 	{
@@ -160,7 +163,7 @@ static ReplayResult<ArgValue> ParsePrimitive(PrimitiveType type, std::span<const
 				{
 					break;
 				}
-				std::string str;
+				ArgString str(memory);
 				if (TakeString(data, str, stringSize))
 				{
 					return str;
@@ -168,7 +171,7 @@ static ReplayResult<ArgValue> ParsePrimitive(PrimitiveType type, std::span<const
 			}
 			else
 			{
-				std::string str;
+				ArgString str(memory);
 				if (TakeString(data, str, size))
 				{
 					return str;
@@ -200,7 +203,7 @@ static ReplayResult<ArgValue> ParsePrimitive(PrimitiveType type, std::span<const
 				if (data.size() >= blobSize)
 				{
 					auto s = Take(data, blobSize);
-					return std::vector<Byte>{ s.begin(), s.end() };
+					return ArgBlob(s.begin(), s.end(), memory);
 				}
 			}
 			else
@@ -208,7 +211,7 @@ static ReplayResult<ArgValue> ParsePrimitive(PrimitiveType type, std::span<const
 				if (data.size() >= size)
 				{
 					auto s = Take(data, size);
-					return std::vector<Byte>{ s.begin(), s.end() };
+					return ArgBlob(s.begin(), s.end(), memory);
 				}
 			}
 			break;
@@ -218,6 +221,477 @@ static ReplayResult<ArgValue> ParsePrimitive(PrimitiveType type, std::span<const
 	return PA_REPLAY_ERROR("Failed to parse ArgValue into PrimitiveType {}, only had {} bytes ({})", ToSting(type.Type), data.size(), Core::FormatBytes(data));
 }
 
+static ReplayResult<void> SkipPrimitive(PrimitiveType type, std::span<const Byte>& data)
+{
+	size_t size = PrimitiveSize(type.Type);
+	if (size == Infinity)
+	{
+		uint8_t shortSize;
+		if (!TakeInto(data, shortSize))
+		{
+			return PA_REPLAY_ERROR("Failed to skip PrimitiveType {}, missing size", ToSting(type.Type));
+		}
+
+		size = shortSize;
+		if (shortSize == std::numeric_limits<uint8_t>::max())
+		{
+			uint16_t longSize;
+			bool unknown;
+			if (!TakeInto(data, longSize) || !TakeInto(data, unknown))
+			{
+				return PA_REPLAY_ERROR("Failed to skip PrimitiveType {}, missing size", ToSting(type.Type));
+			}
+			size = longSize;
+		}
+	}
+
+	if (data.size() < size)
+	{
+		return PA_REPLAY_ERROR("Failed to skip PrimitiveType {}, only had {} of {} bytes", ToSting(type.Type), data.size(), size);
+	}
+	Take(data, size);
+	return {};
+}
+
+// fixed layouts without zero sized parts, these can be decoded after a single bounds check
+static bool IsFixedLayout(const ArgType& type)
+{
+	const size_t size = TypeSize(type);
+	if (size == 0 || size == Infinity)
+	{
+		return false;
+	}
+
+	return std::visit([](auto&& t) -> bool
+	{
+		using T = std::decay_t<decltype(t)>;
+		if constexpr (std::is_same_v<T, ArrayType>)
+		{
+			// the size of an array is read as a single byte
+			return t.Size.value() <= std::numeric_limits<uint8_t>::max() && IsFixedLayout(*t.SubType);
+		}
+		else if constexpr (std::is_same_v<T, TupleType>)
+		{
+			return IsFixedLayout(*t.SubType);
+		}
+		else if constexpr (std::is_same_v<T, FixedDictType>)
+		{
+			return std::ranges::all_of(t.Properties, [](const FixedDictProperty& property)
+			{
+				return IsFixedLayout(*property.Type);
+			});
+		}
+		return true;
+	}, type);
+}
+
+static void EmitFixed(const ArgType& type, DecodeProgram& program)
+{
+	const size_t at = program.Code.size();
+	std::visit([&program](auto&& t)
+	{
+		using T = std::decay_t<decltype(t)>;
+		if constexpr (std::is_same_v<T, PrimitiveType>)
+		{
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Primitive, .Type = t.Type });
+		}
+		else if constexpr (std::is_same_v<T, ArrayType>)
+		{
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Array, .Flag = true, .Count = static_cast<uint32_t>(t.Size.value()) });
+			EmitFixed(*t.SubType, program);
+		}
+		else if constexpr (std::is_same_v<T, TupleType>)
+		{
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Tuple, .Count = static_cast<uint32_t>(t.Size) });
+			EmitFixed(*t.SubType, program);
+		}
+		else if constexpr (std::is_same_v<T, FixedDictType>)
+		{
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Dict, .Count = static_cast<uint32_t>(t.Properties.size()), .Name = static_cast<uint32_t>(program.Names.size()) });
+			for (const FixedDictProperty& property : t.Properties)
+			{
+				program.Names.emplace_back(property.Name);
+			}
+			for (const FixedDictProperty& property : t.Properties)
+			{
+				EmitFixed(*property.Type, program);
+			}
+		}
+	}, type);
+	program.Code[at].Length = static_cast<uint32_t>(program.Code.size() - at);
+}
+
+static void EmitValue(const ArgType& type, DecodeProgram& program);
+
+// runs of fixed layout values are merged into a single block
+static void EmitSequence(std::span<const ArgType* const> types, DecodeProgram& program)
+{
+	std::optional<size_t> block;
+	for (const ArgType* type : types)
+	{
+		if (!IsFixedLayout(*type))
+		{
+			block.reset();
+			EmitValue(*type, program);
+			continue;
+		}
+
+		if (!block)
+		{
+			block = program.Code.size();
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Fixed });
+		}
+		program.Code[*block].Count++;
+		program.Code[*block].Size += static_cast<uint32_t>(TypeSize(*type));
+		EmitFixed(*type, program);
+		program.Code[*block].Length = static_cast<uint32_t>(program.Code.size() - *block);
+	}
+}
+
+static void EmitValue(const ArgType& type, DecodeProgram& program)
+{
+	if (IsFixedLayout(type))
+	{
+		const ArgType* types[] = { &type };
+		EmitSequence(types, program);
+		return;
+	}
+
+	const size_t at = program.Code.size();
+	std::visit([&program](auto&& t)
+	{
+		using T = std::decay_t<decltype(t)>;
+		if constexpr (std::is_same_v<T, PrimitiveType>)
+		{
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Primitive, .Type = t.Type });
+		}
+		else if constexpr (std::is_same_v<T, ArrayType>)
+		{
+			// a fixed size is truncated to a byte, just like ParseValue does
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Array, .Flag = t.Size.has_value(), .Count = static_cast<uint8_t>(t.Size.value_or(0)) });
+			EmitValue(*t.SubType, program);
+		}
+		else if constexpr (std::is_same_v<T, TupleType>)
+		{
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Tuple, .Count = static_cast<uint32_t>(t.Size) });
+			EmitValue(*t.SubType, program);
+		}
+		else if constexpr (std::is_same_v<T, FixedDictType>)
+		{
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Dict, .Flag = t.AllowNone, .Count = static_cast<uint32_t>(t.Properties.size()), .Name = static_cast<uint32_t>(program.Names.size()) });
+			std::vector<const ArgType*> types;
+			types.reserve(t.Properties.size());
+			for (const FixedDictProperty& property : t.Properties)
+			{
+				program.Names.emplace_back(property.Name);
+				types.emplace_back(property.Type.get());
+			}
+			EmitSequence(types, program);
+		}
+		else if constexpr (std::is_same_v<T, UserType>)
+		{
+			// blobs are not wrapped, see ParseValue
+			const PrimitiveType* prim = std::get_if<PrimitiveType>(&*t.Type);
+			if (prim == nullptr || prim->Type != BasicType::Blob)
+			{
+				program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::User, .Flag = t.IsNullable });
+			}
+			EmitValue(*t.Type, program);
+		}
+		else
+		{
+			program.Code.emplace_back(DecodeInstruction{ .Op = DecodeOp::Unknown });
+		}
+	}, type);
+	program.Code[at].Length = static_cast<uint32_t>(program.Code.size() - at);
+}
+
+template<typename T>
+static T Read(const Byte*& p)
+{
+	T value;
+	std::memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return value;
+}
+
+// decodes a value of a fixed block, the bounds of the whole block have been checked already
+static ArgValue DecodeFixed(const DecodeInstruction* pc, const Byte*& p, const DecodeProgram& program, std::pmr::memory_resource* memory)
+{
+	switch (pc->Op)
+	{
+		case DecodeOp::Primitive:
+		{
+			switch (pc->Type)
+			{
+				case BasicType::Uint8: return Read<uint8_t>(p);
+				case BasicType::Uint16: return Read<uint16_t>(p);
+				case BasicType::Uint32: return Read<uint32_t>(p);
+				case BasicType::Uint64: return Read<uint64_t>(p);
+				case BasicType::Int8: return Read<int8_t>(p);
+				case BasicType::Int16: return Read<int16_t>(p);
+				case BasicType::Int32: return Read<int32_t>(p);
+				case BasicType::Int64: return Read<int64_t>(p);
+				case BasicType::Float32: return Read<float>(p);
+				case BasicType::Float64: return Read<double>(p);
+				case BasicType::Vector2: return Read<Vec2>(p);
+				case BasicType::Vector3: return Read<Vec3>(p);
+				default: return {};  // never part of a fixed block
+			}
+		}
+		case DecodeOp::Array:
+		case DecodeOp::Tuple:
+		{
+			ArgArray values(memory);
+			values.reserve(pc->Count);
+			for (uint32_t i = 0; i < pc->Count; i++)
+			{
+				values.emplace_back(DecodeFixed(pc + 1, p, program, memory));
+			}
+			return values;
+		}
+		case DecodeOp::Dict:
+		{
+			ArgDict dict(memory);
+			dict.reserve(pc->Count);
+			const DecodeInstruction* property = pc + 1;
+			for (uint32_t i = 0; i < pc->Count; i++)
+			{
+				dict.emplace(program.Names[pc->Name + i], DecodeFixed(property, p, program, memory));
+				property += property->Length;
+			}
+			return dict;
+		}
+		default:
+			return {};
+	}
+}
+
+static ReplayResult<std::span<const Byte>> TakeFixed(std::span<const Byte>& data, size_t size)
+{
+	if (data.size() < size)
+	{
+		return PA_REPLAY_ERROR("Failed to decode fixed block, only had {} of {} bytes", data.size(), size);
+	}
+	return Take(data, size);
+}
+
+static ReplayResult<void> SkipFixed(std::span<const Byte>& data, size_t size)
+{
+	if (data.size() < size)
+	{
+		return PA_REPLAY_ERROR("Failed to skip fixed block, only had {} of {} bytes", data.size(), size);
+	}
+	Take(data, size);
+	return {};
+}
+
+static ReplayResult<ArgValue> DecodeOne(const DecodeInstruction* pc, std::span<const Byte>& data, const DecodeProgram& program, std::pmr::memory_resource* memory);
+
+template<typename Sink>
+static ReplayResult<void> DecodeSequence(const DecodeInstruction* pc, uint32_t count, std::span<const Byte>& data, const DecodeProgram& program, std::pmr::memory_resource* memory, Sink&& sink)
+{
+	while (count > 0)
+	{
+		if (pc->Op == DecodeOp::Fixed)
+		{
+			PA_TRY(block, TakeFixed(data, pc->Size));
+			const Byte* p = block.data();
+			const DecodeInstruction* value = pc + 1;
+			for (uint32_t i = 0; i < pc->Count; i++)
+			{
+				sink(DecodeFixed(value, p, program, memory));
+				value += value->Length;
+			}
+			count -= pc->Count;
+		}
+		else
+		{
+			PA_TRY(value, DecodeOne(pc, data, program, memory));
+			sink(std::move(value));
+			count--;
+		}
+		pc += pc->Length;
+	}
+	return {};
+}
+
+static ReplayResult<ArgValue> DecodeOne(const DecodeInstruction* pc, std::span<const Byte>& data, const DecodeProgram& program, std::pmr::memory_resource* memory)
+{
+	if (data.empty())
+	{
+		return PA_REPLAY_ERROR("ParseValue has empty data");
+	}
+
+	switch (pc->Op)
+	{
+		case DecodeOp::Primitive:
+			return ParsePrimitive(PrimitiveType{ pc->Type }, data, memory);
+		case DecodeOp::Fixed:
+		{
+			PA_TRY(block, TakeFixed(data, pc->Size));
+			const Byte* p = block.data();
+			return DecodeFixed(pc + 1, p, program, memory);
+		}
+		case DecodeOp::Array:
+		case DecodeOp::Tuple:
+		{
+			uint32_t count = pc->Count;
+			if (pc->Op == DecodeOp::Array && !pc->Flag)
+			{
+				uint8_t size;
+				TakeInto(data, size);
+				count = size;
+			}
+
+			ArgArray values(memory);
+			values.reserve(count);
+			const DecodeInstruction* element = pc + 1;
+			if (element->Op == DecodeOp::Fixed && count > 0)
+			{
+				// the elements are checked all at once
+				PA_TRY(block, TakeFixed(data, static_cast<size_t>(element->Size) * count));
+				const Byte* p = block.data();
+				for (uint32_t i = 0; i < count; i++)
+				{
+					values.emplace_back(DecodeFixed(element + 1, p, program, memory));
+				}
+				return values;
+			}
+			for (uint32_t i = 0; i < count; i++)
+			{
+				PA_TRY(value, DecodeOne(element, data, program, memory));
+				values.emplace_back(std::move(value));
+			}
+			return values;
+		}
+		case DecodeOp::Dict:
+		{
+			ArgDict dict(memory);
+			if (pc->Flag)
+			{
+				uint8_t flag;
+				TakeInto(data, flag);
+				if (flag == 0)
+				{
+					return dict;
+				}
+				if (flag != 1)
+				{
+					return {};  // Unknown fixed dict flag
+				}
+			}
+
+			dict.reserve(pc->Count);
+			uint32_t name = pc->Name;
+			PA_TRYV(DecodeSequence(pc + 1, pc->Count, data, program, memory, [&dict, &program, &name](ArgValue&& value)
+			{
+				dict.emplace(program.Names[name++], std::move(value));
+			}));
+			return dict;
+		}
+		case DecodeOp::User:
+		{
+			Take(data, 1);
+			if (pc->Flag && data.empty())
+			{
+				return {};
+			}
+			return DecodeOne(pc + 1, data, program, memory);
+		}
+		case DecodeOp::Unknown:
+			return {};
+	}
+	return {};
+}
+
+static ReplayResult<void> SkipOne(const DecodeInstruction* pc, std::span<const Byte>& data);
+
+static ReplayResult<void> SkipSequence(const DecodeInstruction* pc, uint32_t count, std::span<const Byte>& data)
+{
+	while (count > 0)
+	{
+		if (pc->Op == DecodeOp::Fixed)
+		{
+			PA_TRYV(SkipFixed(data, pc->Size));
+			count -= pc->Count;
+		}
+		else
+		{
+			PA_TRYV(SkipOne(pc, data));
+			count--;
+		}
+		pc += pc->Length;
+	}
+	return {};
+}
+
+static ReplayResult<void> SkipOne(const DecodeInstruction* pc, std::span<const Byte>& data)
+{
+	if (data.empty())
+	{
+		return PA_REPLAY_ERROR("SkipValue has empty data");
+	}
+
+	switch (pc->Op)
+	{
+		case DecodeOp::Primitive:
+			return SkipPrimitive(PrimitiveType{ pc->Type }, data);
+		case DecodeOp::Fixed:
+		{
+			return SkipFixed(data, pc->Size);
+		}
+		case DecodeOp::Array:
+		case DecodeOp::Tuple:
+		{
+			uint32_t count = pc->Count;
+			if (pc->Op == DecodeOp::Array && !pc->Flag)
+			{
+				uint8_t size;
+				TakeInto(data, size);
+				count = size;
+			}
+
+			const DecodeInstruction* element = pc + 1;
+			if (element->Op == DecodeOp::Fixed)
+			{
+				PA_TRYV(SkipFixed(data, static_cast<size_t>(element->Size) * count));
+				return {};
+			}
+			for (uint32_t i = 0; i < count; i++)
+			{
+				PA_TRYV(SkipOne(element, data));
+			}
+			return {};
+		}
+		case DecodeOp::Dict:
+		{
+			if (pc->Flag)
+			{
+				uint8_t flag;
+				TakeInto(data, flag);
+				if (flag != 1)
+				{
+					return {};
+				}
+			}
+			return SkipSequence(pc + 1, pc->Count, data);
+		}
+		case DecodeOp::User:
+		{
+			Take(data, 1);
+			if (pc->Flag && data.empty())
+			{
+				return {};
+			}
+			return SkipOne(pc + 1, data);
+		}
+		case DecodeOp::Unknown:
+			return {};
+	}
+	return {};
+}
+
 }
 
 ReplayResult<ArgType> rp::ParseType(XMLElement* elem, const AliasType& aliases)
@@ -465,23 +939,23 @@ std::string rp::PrintType(const ArgType& type)
 }
 #endif
 
-ReplayResult<ArgValue> rp::ParseValue(std::span<const Byte>& data, const ArgType& type)
+ReplayResult<ArgValue> rp::ParseValue(std::span<const Byte>& data, const ArgType& type, std::pmr::memory_resource* memory)
 {
 	if (data.empty())
 	{
 		return PA_REPLAY_ERROR("ParseValue has empty data");
 	}
 
-	return std::visit([&data](auto&& t) -> ReplayResult<ArgValue>
+	return std::visit([&data, memory](auto&& t) -> ReplayResult<ArgValue>
 	{
 		using T = std::decay_t<decltype(t)>;
 		if constexpr (std::is_same_v<T, PrimitiveType>)
 		{
-			return ParsePrimitive(t, data);
+			return ParsePrimitive(t, data, memory);
 		}
 		else if constexpr (std::is_same_v<T, ArrayType>)
 		{
-			std::vector<ArgValue> values;
+			ArgArray values(memory);
 			uint8_t size = 0;
 			if (!t.Size)
 			{
@@ -494,16 +968,17 @@ ReplayResult<ArgValue> rp::ParseValue(std::span<const Byte>& data, const ArgType
 			{
 				size = t.Size.value();
 			}
+			values.reserve(size);
 			for (size_t i = 0; i < size; i++)
 			{
-				PA_TRY(value, ParseValue(data, *t.SubType));
+				PA_TRY(value, ParseValue(data, *t.SubType, memory));
 				values.emplace_back(std::move(value));
 			}
 			return values;
 		}
 		else if constexpr (std::is_same_v<T, FixedDictType>)
 		{
- 			std::unordered_map<std::string, ArgValue> dict;
+			ArgDict dict(memory);
 			if (t.AllowNone)
 			{
 				uint8_t flag;
@@ -522,9 +997,10 @@ ReplayResult<ArgValue> rp::ParseValue(std::span<const Byte>& data, const ArgType
 				}
 			}
 
+			dict.reserve(t.Properties.size());
 			for (const FixedDictProperty& property : t.Properties)
 			{
-				PA_TRY(value, ParseValue(data, *property.Type));
+				PA_TRY(value, ParseValue(data, *property.Type, memory));
 				dict.emplace(property.Name, std::move(value));
 			}
 
@@ -532,10 +1008,11 @@ ReplayResult<ArgValue> rp::ParseValue(std::span<const Byte>& data, const ArgType
 		}
 		else if constexpr (std::is_same_v<T, TupleType>)
 		{
-			std::vector<ArgValue> values;
+			ArgArray values(memory);
+			values.reserve(t.Size);
 			for (size_t i = 0; i < t.Size; i++)
 			{
-				PA_TRY(value, ParseValue(data, *t.SubType));
+				PA_TRY(value, ParseValue(data, *t.SubType, memory));
 				values.emplace_back(std::move(value));
 			}
 			return values;
@@ -546,7 +1023,7 @@ ReplayResult<ArgValue> rp::ParseValue(std::span<const Byte>& data, const ArgType
 			{
 				if (prim->Type == BasicType::Blob)
 				{
-					return ParseValue(data, *t.Type);
+					return ParseValue(data, *t.Type, memory);
 				}
 			}
 			if (data.size() == 0)
@@ -558,15 +1035,117 @@ ReplayResult<ArgValue> rp::ParseValue(std::span<const Byte>& data, const ArgType
 			{
 				return {};
 			}
-			return ParseValue(data, *t.Type);
+			return ParseValue(data, *t.Type, memory);
 		}
 		return {};
 	}, type);
 }
 
-ReplayResult<ArgValue> rp::GetDefaultValue(const ArgType& type)
+ReplayResult<void> rp::SkipValue(std::span<const Byte>& data, const ArgType& type)
 {
-	return std::visit([](auto&& t) -> ReplayResult<ArgValue>
+	if (data.empty())
+	{
+		return PA_REPLAY_ERROR("SkipValue has empty data");
+	}
+
+	return std::visit([&data](auto&& t) -> ReplayResult<void>
+	{
+		using T = std::decay_t<decltype(t)>;
+		if constexpr (std::is_same_v<T, PrimitiveType>)
+		{
+			return SkipPrimitive(t, data);
+		}
+		else if constexpr (std::is_same_v<T, ArrayType>)
+		{
+			uint8_t size = 0;
+			if (!t.Size)
+			{
+				if (!TakeInto(data, size))
+				{
+					return {};
+				}
+			}
+			else
+			{
+				size = t.Size.value();
+			}
+
+			// arrays of fixed layout elements can be skipped in one go, zero sized values still have to
+			// be visited since ParseValue fails on them once the data is exhausted
+			if (IsFixedLayout(*t.SubType))
+			{
+				const size_t elementSize = TypeSize(*t.SubType);
+				if (data.size() < elementSize * size)
+				{
+					return PA_REPLAY_ERROR("Failed to skip ArrayType, only had {} of {} bytes", data.size(), elementSize * size);
+				}
+				Take(data, elementSize * size);
+				return {};
+			}
+
+			for (size_t i = 0; i < size; i++)
+			{
+				PA_TRYV(SkipValue(data, *t.SubType));
+			}
+			return {};
+		}
+		else if constexpr (std::is_same_v<T, FixedDictType>)
+		{
+			if (t.AllowNone)
+			{
+				uint8_t flag;
+				if (!TakeInto(data, flag))
+				{
+					return {};
+				}
+
+				if (flag != 1)
+				{
+					return {};
+				}
+			}
+
+			for (const FixedDictProperty& property : t.Properties)
+			{
+				PA_TRYV(SkipValue(data, *property.Type));
+			}
+			return {};
+		}
+		else if constexpr (std::is_same_v<T, TupleType>)
+		{
+			for (size_t i = 0; i < t.Size; i++)
+			{
+				PA_TRYV(SkipValue(data, *t.SubType));
+			}
+			return {};
+		}
+		else if constexpr (std::is_same_v<T, UserType>)
+		{
+			if (const PrimitiveType* prim = std::get_if<PrimitiveType>(&*t.Type))
+			{
+				if (prim->Type == BasicType::Blob)
+				{
+					return SkipValue(data, *t.Type);
+				}
+			}
+			if (data.size() == 0)
+			{
+				return PA_REPLAY_ERROR("UserType did not have size > 1");
+			}
+			Take(data, 1);
+			if (t.IsNullable && data.size() == 0)
+			{
+				return {};
+			}
+			return SkipValue(data, *t.Type);
+		}
+		return {};
+	}, type);
+}
+
+ReplayResult<ArgValue> rp::GetDefaultValue(const ArgType& type, std::pmr::memory_resource* memory)
+{
+	return std::visit([memory](auto&& t) -> ReplayResult<ArgValue>
 	{
 		using T = std::decay_t<decltype(t)>;
 		if constexpr (std::is_same_v<T, PrimitiveType>)
@@ -598,20 +1177,20 @@ ReplayResult<ArgValue> rp::GetDefaultValue(const ArgType& type)
 				case BasicType::Vector3:
 					return Vec3{ 0, 0, 0 };
 				case BasicType::String:
-					return std::string("");
+					return ArgString(memory);
 				case BasicType::UnicodeString:
-					return std::string("");
+					return ArgString(memory);
 				case BasicType::Blob:
-					return std::vector<Byte>{};
+					return ArgBlob(memory);
 			}
 		}
 		else if constexpr (std::is_same_v<T, ArrayType>)
 		{
-			return std::vector<ArgValue>{};
+			return ArgArray(memory);
 		}
 		else if constexpr (std::is_same_v<T, FixedDictType>)
 		{
-			return std::unordered_map<std::string, ArgValue>{};
+			return ArgDict(memory);
 		}
 		else if constexpr (std::is_same_v<T, TupleType>)
 		{
@@ -619,9 +1198,83 @@ ReplayResult<ArgValue> rp::GetDefaultValue(const ArgType& type)
 		}
 		else if constexpr (std::is_same_v<T, UserType>)
 		{
-			return GetDefaultValue(*t.Type);
+			return GetDefaultValue(*t.Type, memory);
 		}
 
 		return ArgValue{};
 	}, type);
 }
+
+ArgValue rp::CloneValue(const ArgValue& value, std::pmr::memory_resource* memory)
+{
+	return std::visit([memory](const auto& v) -> ArgValue
+	{
+		using T = std::decay_t<decltype(v)>;
+		if constexpr (std::is_same_v<T, ArgString> || std::is_same_v<T, ArgBlob>)
+		{
+			return T(v, memory);
+		}
+		else if constexpr (std::is_same_v<T, ArgArray>)
+		{
+			ArgArray values(memory);
+			values.reserve(v.size());
+			for (const ArgValue& element : v)
+			{
+				values.emplace_back(CloneValue(element, memory));
+			}
+			return values;
+		}
+		else if constexpr (std::is_same_v<T, ArgDict>)
+		{
+			ArgDict dict(memory);
+			dict.reserve(v.size());
+			for (const auto& [key, element] : v)
+			{
+				dict.emplace(key, CloneValue(element, memory));
+			}
+			return dict;
+		}
+		else
+		{
+			return v;
+		}
+	}, static_cast<const ValueVariant&>(value));
+}
+
+DecodeProgram rp::CompileDecodeProgram(std::span<const ArgType> types)
+{
+	std::vector<const ArgType*> pointers;
+	pointers.reserve(types.size());
+	for (const ArgType& type : types)
+	{
+		pointers.emplace_back(&type);
+	}
+
+	DecodeProgram program;
+	EmitSequence(pointers, program);
+	program.Values = static_cast<uint32_t>(types.size());
+	return program;
+}
+
+ReplayResult<void> rp::DecodeValues(const DecodeProgram& program, std::span<const Byte>& data, ArgArray& out, std::pmr::memory_resource* memory)
+{
+	out.reserve(out.size() + program.Values);
+	return DecodeSequence(program.Code.data(), program.Values, data, program, memory, [&out](ArgValue&& value)
+	{
+		out.emplace_back(std::move(value));
+	});
+}
+
+ReplayResult<ArgValue> rp::DecodeValue(const DecodeProgram& program, std::span<const Byte>& data, std::pmr::memory_resource* memory)
+{
+	if (program.Values != 1)
+	{
+		return PA_REPLAY_ERROR("DecodeValue needs a program of one value, but it has {}", program.Values);
+	}
+	return DecodeOne(program.Code.data(), data, program, memory);
+}
+
+ReplayResult<void> rp::SkipValues(const DecodeProgram& program, std::span<const Byte>& data)
+{
+	return SkipSequence(program.Code.data(), program.Values, data);
+}
@@ -13,17 +13,21 @@
 #include "Core/Sha256.hpp"
 #include "Core/String.hpp"
 #include "Core/Time.hpp"
+#include "Core/TimerWheel.hpp"
 #include "Core/Version.hpp"
 #include "Core/Zlib.hpp"
 
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <filesystem>
 #include <string>
 #include <span>
 #include <ranges>
+#include <thread>
 #include <vector>
 
 
@@ -152,6 +156,86 @@ TEST_CASE( "BlowFishDecryptTest" )
 	REQUIRE(std::equal(out.begin(), out.end(), solution.begin(), solution.end()));
 }
 
+TEST_CASE( "BlowFishDecryptChainedTest" )
+{
+	auto key = FromString<Byte>("just some random key lol");
+	Blowfish blowfish(key);
+
+	std::vector<Byte> src(1024 * 1024 + 5 * Blowfish::BlockSize());
+	for (size_t i = 0; i < src.size(); i++)
+	{
+		src[i] = static_cast<Byte>(i * 31 + i / 7);
+	}
+
+	// reference: decrypt block by block and xor with the previous plaintext block
+	std::vector<Byte> expected(src.size());
+	REQUIRE(blowfish.Decrypt(src, expected));
+	Byte prev[8] = {};
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		expected[i] ^= prev[i % 8];
+		prev[i % 8] = expected[i];
+	}
+
+	std::array<Byte, 8> chain = {};
+	std::vector<Byte> out(src.size());
+	REQUIRE(blowfish.DecryptChained(src, out, chain));
+	REQUIRE(out == expected);
+	REQUIRE(std::equal(chain.begin(), chain.end(), expected.end() - 8));
+
+	// pieces that do not line up with the interleaving, chained through the iv
+	chain = {};
+	std::ranges::fill(out, Byte{ 0 });
+	const std::span<Byte> dst = out;
+	REQUIRE(blowfish.DecryptChained(std::span{ src }.first(24), dst.first(24), chain));
+	REQUIRE(blowfish.DecryptChained(std::span{ src }.subspan(24), dst.subspan(24), chain, 4));
+	REQUIRE(out == expected);
+
+	REQUIRE_FALSE(blowfish.DecryptChained(std::span{ src }.first(12), dst.first(12), chain));
+}
+
+TEST_CASE( "BlowFishBenchmark", "[.][benchmark]" )
+{
+	auto key = FromString<Byte>("just some random key lol");
+	Blowfish blowfish(key);
+
+	std::vector<Byte> src(4 * 1024 * 1024);
+	for (size_t i = 0; i < src.size(); i++)
+	{
+		src[i] = static_cast<Byte>(i * 31 + i / 7);
+	}
+	std::vector<Byte> dst(src.size());
+	std::array<Byte, 8> chain = {};
+
+	auto throughput = [&src](auto&& decrypt)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		decrypt();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return static_cast<double>(src.size()) / (1024.0 * 1024.0) / elapsed.count();
+	};
+
+	const double single = throughput([&]() { return blowfish.Decrypt(src, dst); });
+	const double chained = throughput([&]() { return blowfish.DecryptChained(src, dst, chain); });
+	const double threaded = throughput([&]() { return blowfish.DecryptChained(src, dst, chain, std::thread::hardware_concurrency()); });
+	WARN("Decrypt: " << single << " MB/s, DecryptChained: " << chained << " MB/s, DecryptChained threaded: " << threaded << " MB/s");
+
+	BENCHMARK("Decrypt 4 MiB")
+	{
+		return blowfish.Decrypt(src, dst);
+	};
+
+	BENCHMARK("DecryptChained 4 MiB")
+	{
+		return blowfish.DecryptChained(src, dst, chain);
+	};
+
+	BENCHMARK("DecryptChained 4 MiB threaded")
+	{
+		return blowfish.DecryptChained(src, dst, chain, std::thread::hardware_concurrency());
+	};
+}
+
 TEST_CASE( "FileMappingTest" )
 {
 	File file = File::Open(GetFile("lorem.txt"), File::Flags::Open | File::Flags::Read);
@@ -391,6 +475,43 @@ TEST_CASE( "TimeTest" )
 	}
 }
 
+TEST_CASE( "TimerWheelTest" )
+{
+	using namespace std::chrono_literals;
+
+	TimerWheel wheel(100ms, 4);
+	std::vector<int> fired;
+
+	wheel.Schedule(100ms, [&fired]() { fired.emplace_back(1); });
+	wheel.Schedule(250ms, [&fired]() { fired.emplace_back(3); });
+	wheel.Schedule(1000ms, [&fired]() { fired.emplace_back(10); });
+	const TimerWheel::TimerId cancelled = wheel.Schedule(200ms, [&fired]() { fired.emplace_back(2); });
+	REQUIRE(wheel.Pending() == 4);
+	REQUIRE(wheel.Cancel(cancelled));
+	REQUIRE_FALSE(wheel.Cancel(cancelled));
+
+	REQUIRE(wheel.Advance() == 1);
+	REQUIRE(fired == std::vector{ 1 });
+	REQUIRE(wheel.Advance(2) == 1);
+	REQUIRE(fired == std::vector{ 1, 3 });
+
+	// timers scheduled from a callback land in a later tick
+	wheel.Schedule(0ms, [&wheel, &fired]()
+	{
+		fired.emplace_back(4);
+		wheel.Schedule(100ms, [&fired]() { fired.emplace_back(5); });
+	});
+	REQUIRE(wheel.Advance() == 1);
+	REQUIRE(wheel.Advance() == 1);
+	REQUIRE(fired == std::vector{ 1, 3, 4, 5 });
+
+	// the long timer wraps around the wheel twice before it expires at the tenth tick
+	REQUIRE(wheel.Advance(4) == 0);
+	REQUIRE(wheel.Advance() == 1);
+	REQUIRE(fired == std::vector{ 1, 3, 4, 5, 10 });
+	REQUIRE(wheel.Empty());
+}
+
 TEST_CASE( "VersionTest" )
 {
 	REQUIRE(Version("3.7.8.0") == Version("3.7.8.0"));
@@ -487,4 +608,52 @@ TEST_CASE( "ZlibTest" )
 
 	REQUIRE(vec.size() == string.size());
 	CHECK(std::memcmp(vec.data(), string.data(), vec.size()) == 0);
+
+	Zlib::Inflater inflater;
+	REQUIRE(inflater);
+	std::vector<Byte> streamed;
+	std::span<const Byte> in{ binary };
+	while (!in.empty())
+	{
+		REQUIRE(inflater.Feed(Take(in, std::min<size_t>(in.size(), 7)), [&streamed](std::span<const Byte> chunk)
+		{
+			streamed.insert(streamed.end(), chunk.begin(), chunk.end());
+			return true;
+		}));
+	}
+	CHECK(inflater.Finished());
+	CHECK(inflater.TotalOut() == string.size());
+	REQUIRE(streamed.size() == string.size());
+	CHECK(std::memcmp(streamed.data(), string.data(), streamed.size()) == 0);
+
+	REQUIRE(Zlib::Inflate(binary, true, string.size()) == vec);
+	REQUIRE(Zlib::Inflate(binary, true, 1) == vec);
+
+	std::vector<Byte> exact(string.size());
+	REQUIRE(Zlib::Inflate(binary, exact));
+	REQUIRE(exact == vec);
+	std::vector<Byte> tooSmall(string.size() - 1);
+	REQUIRE_FALSE(Zlib::Inflate(binary, tooSmall));
+	std::vector<Byte> tooBig(string.size() + 1);
+	REQUIRE_FALSE(Zlib::Inflate(binary, tooBig));
+
+	size_t sunk = 0;
+	REQUIRE(Zlib::Inflate(binary, [&sunk](std::span<const Byte> chunk)
+	{
+		sunk += chunk.size();
+		return true;
+	}));
+	REQUIRE(sunk == string.size());
+
+	Zlib::Inflater direct;
+	std::vector<Byte> directOut(string.size());
+	std::span<Byte> remaining{ directOut };
+	in = binary;
+	while (!in.empty())
+	{
+		REQUIRE(direct.Feed(Take(in, std::min<size_t>(in.size(), 7)), remaining));
+	}
+	CHECK(direct.Finished());
+	CHECK(remaining.empty());
+	REQUIRE(directOut == vec);
 }
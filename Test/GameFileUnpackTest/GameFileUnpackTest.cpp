@@ -12,7 +12,12 @@
 #include <catch2/reporters/catch_reporter_event_listener.hpp>
 #include <catch2/reporters/catch_reporter_registrars.hpp>
 
+#include <array>
+#include <cstring>
 #include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
 
 #include <QDir>
 #include <QStandardPaths>
@@ -54,6 +59,27 @@ static fs::path GetGameFilePath(std::string_view fileName)
 	return GetGameFileRootPath() / fileName;
 }
 
+// an empty directory to put changed copies of the test index into
+static fs::path MakeIdxDirectory(std::string_view name)
+{
+	const fs::path dir = GetTempDirectory() / name;
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+	return dir;
+}
+
+static std::vector<Byte> ReadIdxFile()
+{
+	std::vector<Byte> data;
+	REQUIRE(File::Open(GetGameFilePath("vehicles_level6_usa.idx"), File::Flags::Open | File::Flags::Read).ReadAll(data));
+	return data;
+}
+
+static void WriteIdxFile(const fs::path& path, std::span<const Byte> data)
+{
+	REQUIRE(File::Open(path, File::Flags::Open | File::Flags::Write | File::Flags::Create).Write(data));
+}
+
 }
 
 class TestRunListener : public Catch::EventListenerBase
@@ -70,46 +96,65 @@ CATCH_REGISTER_LISTENER(TestRunListener)
 
 TEST_CASE("GameFileUnpackTest_DirectoryTreeTest")
 {
-	DirectoryTree tree;
+	const DirectoryTree tree({ "first.pkg", "second.pkg" }, {
+		PathRecord{ "content/testFile.txt", { .Pkg = 0 } },
+		PathRecord{ "content/sub/nested.txt", { .Pkg = 1 } },
+		PathRecord{ "content-other/testFile.txt", { .Pkg = 0 } },
+		PathRecord{ "content/testFile2.txt", { .Pkg = 0 } },
+		PathRecord{ "root.txt", { .Pkg = 1 } },
+	});
 
-	tree.Insert(FileRecord{ "", "content/testFile.txt" });
 	std::optional<TreeNode> record1 = tree.Find("content/testFile.txt");
 	REQUIRE(record1);
-	REQUIRE(record1->File);
-	REQUIRE(record1->File->Path == "content/testFile.txt");
+	REQUIRE(record1->File());
+	REQUIRE(record1->Path() == "content/testFile.txt");
+	REQUIRE(record1->Name() == "testFile.txt");
+	REQUIRE(record1->PkgName() == "first.pkg");
+	REQUIRE(record1->ChildCount() == 0);
 
-	tree.Insert(FileRecord{ "", "content/testFile2.txt" });
 	std::optional<TreeNode> record2 = tree.Find("content/");
 	REQUIRE(record2);
-	REQUIRE_FALSE(record2->File);
-	REQUIRE(record2->Nodes.contains("testFile.txt"));
-	REQUIRE(record2->Nodes.contains("testFile2.txt"));
-	REQUIRE_FALSE(record2->File.has_value());
+	REQUIRE_FALSE(record2->File());
+	REQUIRE(record2->PkgName().empty());
+	REQUIRE(record2->Path() == "content");
+	REQUIRE(record2->ChildCount() == 3);
+	REQUIRE(record2->FindChild("testFile.txt"));
+	REQUIRE(record2->FindChild("testFile2.txt"));
+	REQUIRE(record2->FindChild("sub"));
+	REQUIRE_FALSE(record2->FindChild("nested.txt"));
+
+	std::optional<TreeNode> record3 = tree.Find("content/sub/nested.txt");
+	REQUIRE(record3);
+	REQUIRE(record3->File());
+	REQUIRE(record3->Path() == "content/sub/nested.txt");
+	REQUIRE(record3->PkgName() == "second.pkg");
+
+	REQUIRE(tree.Find("root.txt"));
+	REQUIRE(tree.Find("content-other/testFile.txt"));
+	REQUIRE_FALSE(tree.Find("content/missing.txt"));
+	REQUIRE_FALSE(tree.Find("content/testFile.txt/more"));
+	REQUIRE(tree.Root().ChildCount() == 3);
+	REQUIRE(tree.Root().Path().empty());
 }
 
 TEST_CASE("GameFileUnpackTest_IdxFileTest")
 {
-	fs::path idxFilePath = GetGameFilePath("vehicles_level6_usa.idx");
-	fs::path pkgFilePath = GetGameFilePath("vehicles_level6_usa_0001.pkg");
+	Unpacker unpacker(GetGameFileRootPath(), GetGameFileRootPath());
+	REQUIRE(unpacker.Parse());
+	const DirectoryTree& tree = unpacker.Tree();
+	REQUIRE(tree.Files().size() == 39);
+	REQUIRE(tree.PkgNames().size() == 1);
 
-	File file = File::Open(idxFilePath, File::Flags::Open | File::Flags::Read);
-	REQUIRE(file);
-	std::vector<Byte> data;
-	REQUIRE(file.ReadAll(data));
-	UnpackResult<IdxFile> idxFileRes = IdxFile::Parse(data);
-	REQUIRE(idxFileRes);
-	IdxFile& idxFile = *idxFileRes;
-	REQUIRE(idxFile.Files.size() == 39);
-	REQUIRE(idxFile.Nodes.size() == 54);
-
-	REQUIRE(idxFile.Files[4].Size == 1799);
-	REQUIRE(idxFile.Files[4].UncompressedSize == 2872);
-	REQUIRE(idxFile.Files[4].NodeId == 9050552029570354906);
-	REQUIRE(idxFile.Files[4].Offset == 0x6226F);
-	REQUIRE(idxFile.Files[4].Path ==
-			"content/gameplay/usa/gun/secondary/textures/AGS206_3in50_MK21_Sub_ao.dds");
-	REQUIRE(idxFile.Nodes[1704543301444328984].Name == "AGS206_3in50_MK21_Sub_mg.dds");
-	REQUIRE(idxFile.PkgName == "vehicles_level6_usa_0001.pkg");
+	std::optional<TreeNode> node = tree.Find("content/gameplay/usa/gun/secondary/textures/AGS206_3in50_MK21_Sub_ao.dds");
+	REQUIRE(node);
+	const FileRecord* record = node->File();
+	REQUIRE(record);
+	REQUIRE(record->Size == 1799);
+	REQUIRE(record->UncompressedSize == 2872);
+	REQUIRE(record->NodeId == 9050552029570354906);
+	REQUIRE(record->Offset == 0x6226F);
+	REQUIRE(node->PkgName() == "vehicles_level6_usa_0001.pkg");
+	REQUIRE(tree.Find("content/gameplay/usa/gun/secondary/textures/AGS206_3in50_MK21_Sub_mg.dds"));
 }
 
 TEST_CASE("GameFileUnpackTest_UnpackerTest")
@@ -121,3 +166,122 @@ TEST_CASE("GameFileUnpackTest_UnpackerTest")
 			GetTempDirectory())
 	);
 }
+
+TEST_CASE("GameFileUnpackTest_PrefixParseTest")
+{
+	const std::array<std::string_view, 1> prefixes = { "content/gameplay/usa/gun/secondary/textures/AGS206_3in50_MK21_Sub_ao.dds" };
+	Unpacker unpacker(GetGameFileRootPath(), GetGameFileRootPath());
+	REQUIRE(unpacker.Parse(prefixes));
+
+	REQUIRE(unpacker.Extract(prefixes[0], GetTempDirectory()));
+	// everything else in the index was skipped
+	REQUIRE_FALSE(unpacker.Extract("content/gameplay/usa/gun/secondary/textures/AGS206_3in50_MK21_Sub_mg.dds", GetTempDirectory()));
+	REQUIRE(unpacker.Tree().Files().size() == 1);
+
+	// the start of every path does not restrict anything
+	for (const std::string_view everything : { "", "/" })
+	{
+		Unpacker full(GetGameFileRootPath(), GetGameFileRootPath());
+		REQUIRE(full.Parse(std::span{ &everything, 1 }));
+		REQUIRE(full.Tree().Files().size() == 39);
+	}
+}
+
+TEST_CASE("GameFileUnpackTest_DuplicateRecordTest")
+{
+	static constexpr std::string_view path = "content/gameplay/usa/gun/secondary/textures/AGS206_3in50_MK21_Sub_ao.dds";
+	static constexpr uint64_t nodeId = 9050552029570354906;
+
+	std::vector<Byte> data = ReadIdxFile();
+	UnpackResult<IdxHeader> header = IdxHeader::Parse(std::span{ data }.subspan(0, HeaderSize));
+	REQUIRE(header);
+
+	// the record after the one of the texture gets its node, which gives both of them the same path
+	Byte* records = data.data() + header->FileRecordTablePtr + HeaderDataOffset;
+	REQUIRE(std::memcmp(records + 4 * FileRecordSize, &nodeId, sizeof(nodeId)) == 0);
+	std::memcpy(records + 5 * FileRecordSize, &nodeId, sizeof(nodeId));
+	uint64_t offset;
+	std::memcpy(&offset, records + 5 * FileRecordSize + 2 * sizeof(uint64_t), sizeof(offset));
+
+	const fs::path dir = MakeIdxDirectory("DuplicateRecord");
+	WriteIdxFile(dir / "vehicles_level6_usa.idx", data);
+
+	// the later record wins, no matter if the file was parsed completely or only until the path was found
+	Unpacker full(dir, dir);
+	REQUIRE(full.Parse());
+	REQUIRE(full.Tree().Find(path)->File()->Offset == offset);
+
+	const std::array<std::string_view, 1> prefixes = { path };
+	Unpacker prefix(dir, dir);
+	REQUIRE(prefix.Parse(prefixes));
+	REQUIRE(prefix.Tree().Files().size() == 1);
+	REQUIRE(prefix.Tree().Find(path)->File()->Offset == offset);
+}
+
+TEST_CASE("GameFileUnpackTest_DuplicateIdxFileTest")
+{
+	static constexpr std::string_view path = "content/gameplay/usa/gun/secondary/textures/AGS206_3in50_MK21_Sub_ao.dds";
+
+	// the second copy of the index names another pkg, so it can be told which one a path was taken from
+	const std::vector<Byte> first = ReadIdxFile();
+	std::vector<Byte> second = first;
+	const std::string_view text(reinterpret_cast<const char*>(second.data()), second.size());
+	const size_t pkgName = text.find("vehicles_level6_usa_0001.pkg");
+	REQUIRE(pkgName != std::string_view::npos);
+	second[pkgName + std::string_view("vehicles_level6_usa_000").size()] = '2';
+
+	const fs::path dir = MakeIdxDirectory("DuplicateIdxFile");
+	WriteIdxFile(dir / "a.idx", first);
+	WriteIdxFile(dir / "b.idx", second);
+
+	// the file that sorts last wins, no matter if every file was parsed or only until the path was found
+	const std::array<std::string_view, 1> prefixes = { path };
+	for (const size_t threadCount : { 1, 4 })
+	{
+		Unpacker full(dir, dir);
+		REQUIRE(full.Parse({}, threadCount));
+		REQUIRE(full.Tree().Files().size() == 2 * 39);
+		REQUIRE(full.Tree().Find(path)->PkgName() == "vehicles_level6_usa_0002.pkg");
+
+		Unpacker prefix(dir, dir);
+		REQUIRE(prefix.Parse(prefixes, threadCount));
+		REQUIRE(prefix.Tree().Files().size() == 1);
+		REQUIRE(prefix.Tree().Find(path)->PkgName() == "vehicles_level6_usa_0002.pkg");
+	}
+}
+
+TEST_CASE("GameFileUnpackTest_ParallelParseTest")
+{
+	Unpacker unpacker(GetGameFileRootPath(), GetGameFileRootPath());
+	REQUIRE(unpacker.Parse({}, 4));
+	REQUIRE(unpacker.Extract(
+			R"(content/gameplay/usa/gun/secondary/textures/AGS206_3in50_MK21_Sub_ao.dds)",
+			GetTempDirectory())
+	);
+}
+
+TEST_CASE("GameFileUnpackTest_ParallelExtractTest")
+{
+	Unpacker unpacker(GetGameFileRootPath(), GetGameFileRootPath());
+	REQUIRE(unpacker.Parse());
+
+	const fs::path serialDir = GetTempDirectory() / "SerialExtract";
+	const fs::path parallelDir = GetTempDirectory() / "ParallelExtract";
+	REQUIRE(unpacker.Extract("content/", serialDir, true, 1));
+	REQUIRE(unpacker.Extract("content/", parallelDir, true, 4));
+
+	size_t fileCount = 0;
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(serialDir))
+	{
+		if (!entry.is_regular_file())
+			continue;
+
+		std::vector<Byte> serial;
+		std::vector<Byte> parallel;
+		REQUIRE(File::Open(entry.path(), File::Flags::Open | File::Flags::Read).ReadAll(serial));
+		REQUIRE(File::Open(parallelDir / fs::relative(entry.path(), serialDir), File::Flags::Open | File::Flags::Read).ReadAll(parallel));
+		REQUIRE(serial == parallel);
+		fileCount++;
+	}
+	REQUIRE(fileCount == 39);
+}
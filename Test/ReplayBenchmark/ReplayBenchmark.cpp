@@ -0,0 +1,327 @@
+// Copyright 2024 <github.com/razaqq>
+
+#include "Core/Bytes.hpp"
+#include "Core/Directory.hpp"
+#include "Core/File.hpp"
+#include "Core/FileMapping.hpp"
+#include "Core/Json.hpp"
+#include "Core/Log.hpp"
+#include "Core/Result.hpp"
+#include "Core/StandardPaths.hpp"
+#include "Core/Zlib.hpp"
+
+#include "ReplayParser/Arena.hpp"
+#include "ReplayParser/GameFiles.hpp"
+#include "ReplayParser/PacketParser.hpp"
+#include "ReplayParser/ReplayParser.hpp"
+#include "ReplayParser/Result.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using namespace PotatoAlert::Core;
+using namespace PotatoAlert::ReplayParser;
+namespace fs = std::filesystem;
+
+namespace {
+
+static std::atomic<size_t> g_allocations = 0;
+static std::atomic<size_t> g_allocatedBytes = 0;
+
+}  // namespace
+
+// counts every allocation of the process except over-aligned ones, a stage is measured by the difference before and after it
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size == 0 ? 1 : size))
+		return ptr;
+	std::abort();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+namespace {
+
+// how much a single run of a stage went through, bytes of input or the number of things it produced
+struct StageWork
+{
+	size_t Bytes = 0;
+	size_t Items = 0;
+};
+
+struct StageResult
+{
+	std::string_view Name;
+	StageWork Work;
+	std::vector<int64_t> Nanos;
+	// the fewest of all runs, later runs can profit from caches warmed up by the first
+	size_t Allocations = 0;
+	size_t AllocatedBytes = 0;
+};
+
+struct ReplayResults
+{
+	std::string Name;
+	std::vector<StageResult> Stages;
+};
+
+template<typename F>
+static ReplayResult<StageResult> Measure(std::string_view name, size_t iterations, F&& run)
+{
+	StageResult result{ .Name = name };
+	result.Allocations = SIZE_MAX;
+	result.AllocatedBytes = SIZE_MAX;
+
+	for (size_t i = 0; i < iterations; i++)
+	{
+		const size_t allocations = g_allocations.load(std::memory_order_relaxed);
+		const size_t allocatedBytes = g_allocatedBytes.load(std::memory_order_relaxed);
+		const auto start = std::chrono::steady_clock::now();
+
+		PA_TRYA(result.Work, run());
+
+		const auto end = std::chrono::steady_clock::now();
+		result.Nanos.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		result.Allocations = std::min(result.Allocations, g_allocations.load(std::memory_order_relaxed) - allocations);
+		result.AllocatedBytes = std::min(result.AllocatedBytes, g_allocatedBytes.load(std::memory_order_relaxed) - allocatedBytes);
+	}
+
+	return result;
+}
+
+static ReplayResult<std::vector<Byte>> MapFile(const fs::path& filePath, StageWork& work)
+{
+	File file = File::Open(filePath, File::Flags::Open | File::Flags::Read | File::Flags::ShareRead);
+	if (!file)
+	{
+		return PA_REPLAY_ERROR("Failed to open replay file: {}", File::LastError());
+	}
+
+	const uint64_t fileSize = file.Size();
+	FileMapping fileMapping = FileMapping::Open(file, FileMapping::Flags::Read, fileSize);
+	if (!fileMapping)
+	{
+		return PA_REPLAY_ERROR("Failed to map replay file: {}", fileMapping.LastError());
+	}
+
+	void* mapping = fileMapping.Map(FileMapping::Flags::Read, 0, fileSize);
+	if (mapping == nullptr)
+	{
+		return PA_REPLAY_ERROR("Failed to map view of replay file: {}", fileMapping.LastError());
+	}
+
+	// copied out, so every page is actually faulted in and the later stages work on the same bytes
+	const Byte* begin = static_cast<const Byte*>(mapping);
+	std::vector<Byte> data(begin, begin + fileSize);
+
+	fileMapping.Unmap(mapping, fileSize);
+	fileMapping.Close();
+	file.Close();
+
+	work = { .Bytes = data.size(), .Items = 1 };
+	return data;
+}
+
+static ReplayResult<ReplayResults> RunReplay(const fs::path& filePath, const fs::path& gameFilePath, size_t iterations)
+{
+	ReplayResults results{ .Name = filePath.filename().string() };
+
+	std::vector<Byte> file;
+	PA_TRY(mapStage, Measure("mmap", iterations, [&]() -> ReplayResult<StageWork>
+	{
+		StageWork work;
+		PA_TRYA(file, MapFile(filePath, work));
+		return work;
+	}));
+	results.Stages.emplace_back(std::move(mapStage));
+
+	PA_TRY(layout, ReadReplayLayout(file));
+
+	std::vector<Byte> decrypted(layout.Payload.size());
+	PA_TRY(decryptStage, Measure("decrypt", iterations, [&]() -> ReplayResult<StageWork>
+	{
+		PA_TRYV(DecryptReplayPayload(layout.Payload, decrypted));
+		return StageWork{ .Bytes = decrypted.size(), .Items = 1 };
+	}));
+	results.Stages.emplace_back(std::move(decryptStage));
+
+	std::vector<Byte> inflated(layout.DecompressedSize);
+	PA_TRY(inflateStage, Measure("inflate", iterations, [&]() -> ReplayResult<StageWork>
+	{
+		if (!Zlib::Inflate(decrypted, inflated))
+		{
+			return PA_REPLAY_ERROR("Failed to inflate decrypted replay data with zlib.");
+		}
+		return StageWork{ .Bytes = decrypted.size(), .Items = 1 };
+	}));
+	results.Stages.emplace_back(std::move(inflateStage));
+
+	const Version version = layout.Meta.ClientVersionFromExe;
+	PA_TRY(scriptsStage, Measure("ParseScripts", iterations, [&]() -> ReplayResult<StageWork>
+	{
+		PA_TRY(specs, ParseScripts(version, gameFilePath));
+		return StageWork{ .Bytes = 0, .Items = specs.size() };
+	}));
+	results.Stages.emplace_back(std::move(scriptsStage));
+
+	PA_TRY(specs, GetEntitySpecs(version, gameFilePath));
+	PA_TRY(packetStage, Measure("ParsePacket", iterations, [&]() -> ReplayResult<StageWork>
+	{
+		ReplayArena arena;
+		PacketParser parser;
+		parser.Specs = *specs;
+		parser.Memory = arena.Resource();
+		parser.Dispatch = PacketDispatchTable(version);
+
+		StageWork work{ .Bytes = inflated.size(), .Items = 0 };
+		std::span<const Byte> data = inflated;
+		while (!data.empty())
+		{
+			PA_TRYD(ParsePacket(data, parser));
+			work.Items++;
+		}
+		return work;
+	}));
+	results.Stages.emplace_back(std::move(packetStage));
+
+	PA_TRY(replay, Replay::FromFile(filePath, gameFilePath));
+	PA_TRY(analyzeStage, Measure("Replay::Analyze", iterations, [&]() -> ReplayResult<StageWork>
+	{
+		PA_TRYD(replay.Analyze());
+		return StageWork{ .Bytes = 0, .Items = replay.Packets.size() };
+	}));
+	results.Stages.emplace_back(std::move(analyzeStage));
+
+	return results;
+}
+
+static std::string ResultsToJson(std::span<const ReplayResults> replays, size_t iterations)
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter writer(buffer);
+
+	writer.StartObject();
+	writer.Key("iterations");
+	writer.Uint64(iterations);
+	writer.Key("replays");
+	writer.StartArray();
+	for (const ReplayResults& replay : replays)
+	{
+		writer.StartObject();
+		writer.Key("name");
+		writer.String(replay.Name.c_str());
+		writer.Key("stages");
+		writer.StartArray();
+		for (const StageResult& stage : replay.Stages)
+		{
+			const int64_t min = *std::ranges::min_element(stage.Nanos);
+			const int64_t total = std::accumulate(stage.Nanos.begin(), stage.Nanos.end(), int64_t{ 0 });
+			const double seconds = static_cast<double>(std::max(min, int64_t{ 1 })) / 1e9;
+
+			writer.StartObject();
+			writer.Key("name");
+			writer.String(stage.Name.data(), static_cast<rapidjson::SizeType>(stage.Name.size()));
+			writer.Key("bytes");
+			writer.Uint64(stage.Work.Bytes);
+			writer.Key("items");
+			writer.Uint64(stage.Work.Items);
+			writer.Key("min_ns");
+			writer.Int64(min);
+			writer.Key("mean_ns");
+			writer.Int64(total / static_cast<int64_t>(stage.Nanos.size()));
+			writer.Key("bytes_per_second");
+			writer.Double(static_cast<double>(stage.Work.Bytes) / seconds);
+			writer.Key("items_per_second");
+			writer.Double(static_cast<double>(stage.Work.Items) / seconds);
+			writer.Key("allocations");
+			writer.Uint64(stage.Allocations);
+			writer.Key("allocated_bytes");
+			writer.Uint64(stage.AllocatedBytes);
+			writer.EndObject();
+		}
+		writer.EndArray();
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	return { buffer.GetString(), buffer.GetSize() };
+}
+
+}  // namespace
+
+// Runs every stage of parsing on all test replays and writes the timings and allocations as JSON.
+// usage: ReplayBenchmark [output.json] [iterations]
+int main(int argc, char* argv[])
+{
+	const Result<fs::path> rootPath = GetModuleRootPath();
+	if (!rootPath)
+	{
+		std::fprintf(stderr, "Failed to get module root path\n");
+		return 1;
+	}
+
+	Log::Init(AppDataPath("PotatoAlert") / "ReplayBenchmark.log");
+
+	const fs::path outputPath = argc > 1 ? fs::path(argv[1]) : rootPath.value() / "ReplayBenchmark.json";
+	const size_t iterations = argc > 2 ? std::max(std::strtoull(argv[2], nullptr, 10), 1ull) : 5;
+	const fs::path gameFilePath = rootPath.value() / "ReplayVersions";
+
+	std::vector<fs::path> replayPaths;
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(rootPath.value() / "Replays", ec))
+	{
+		if (entry.path().extension() == ".wowsreplay")
+			replayPaths.emplace_back(entry.path());
+	}
+	if (ec)
+	{
+		std::fprintf(stderr, "Failed to list replays: %s\n", ec.message().c_str());
+		return 1;
+	}
+	std::ranges::sort(replayPaths);
+
+	std::vector<ReplayResults> results;
+	for (const fs::path& replayPath : replayPaths)
+	{
+		ReplayResult<ReplayResults> replayResults = RunReplay(replayPath, gameFilePath, iterations);
+		if (!replayResults)
+		{
+			std::fprintf(stderr, "%s: %s\n", replayPath.filename().string().c_str(), replayResults.error().c_str());
+			return 1;
+		}
+
+		for (const StageResult& stage : replayResults->Stages)
+		{
+			std::printf("%-60s %-16s %12lld ns %10zu allocs\n", replayResults->Name.c_str(), std::string(stage.Name).c_str(),
+				static_cast<long long>(*std::ranges::min_element(stage.Nanos)), stage.Allocations);
+		}
+		results.emplace_back(std::move(*replayResults));
+	}
+
+	const File file = File::Open(outputPath, File::Flags::Create | File::Flags::Write | File::Flags::Truncate);
+	if (!file || !file.WriteString(ResultsToJson(results, iterations)))
+	{
+		std::fprintf(stderr, "Failed to write %s: %s\n", outputPath.string().c_str(), File::LastError().c_str());
+		return 1;
+	}
+
+	return 0;
+}
@@ -8,16 +8,26 @@
 #include "Core/Version.hpp"
 
 #include "ReplayParser/GameFiles.hpp"
+#include "ReplayParser/PacketParser.hpp"
+#include "ReplayParser/ReplayCache.hpp"
 #include "ReplayParser/ReplayParser.hpp"
+#include "ReplayParser/ReplayView.hpp"
+#include "ReplayParser/Trajectory.hpp"
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/reporters/catch_reporter_event_listener.hpp>
 #include <catch2/reporters/catch_reporter_registrars.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <memory>
 #include <numeric>
 #include <optional>
+#include <random>
 #include <string>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
 
@@ -39,6 +49,115 @@ static fs::path GetReplay(std::string_view name)
 	PotatoAlert::Core::ExitCurrentProcess(1);
 }
 
+// the size of the files directly in the directory
+static uint64_t DirectorySize(const fs::path& directory)
+{
+	uint64_t size = 0;
+	for (const fs::directory_entry& entry : fs::directory_iterator(directory))
+	{
+		if (entry.is_regular_file())
+			size += entry.file_size();
+	}
+	return size;
+}
+
+static ArgType RandomType(std::mt19937& rng, int depth)
+{
+	const auto pick = [&rng](uint32_t n) { return static_cast<uint32_t>(rng() % n); };
+	const auto subType = [&rng, depth]() { return std::make_shared<ArgType>(RandomType(rng, depth - 1)); };
+
+	switch (depth > 0 ? pick(8) : 0)
+	{
+		case 0:
+		case 1:
+		case 2:
+			return PrimitiveType{ static_cast<BasicType>(pick(static_cast<uint32_t>(BasicType::Blob) + 1)) };
+		case 3:
+			return ArrayType{ subType(), pick(2) == 0 ? std::optional<size_t>(pick(4)) : std::nullopt };
+		case 4:
+		{
+			FixedDictType dict{ pick(2) == 0, {} };
+			const uint32_t count = pick(4);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				dict.Properties.emplace_back(FixedDictProperty{ "p" + std::to_string(i), subType() });
+			}
+			return dict;
+		}
+		case 5:
+			return TupleType{ subType(), pick(4) };
+		case 6:
+			return UserType{ subType(), pick(2) == 0 };
+		default:
+			return pick(4) == 0 ? ArgType(UnknownType{}) : ArgType(PrimitiveType{ BasicType::Int32 });
+	}
+}
+
+// mostly small bytes, so counts and lengths stay in range often enough to decode something
+static std::vector<Byte> RandomPayload(std::mt19937& rng)
+{
+	std::vector<Byte> data(rng() % 48);
+	for (Byte& b : data)
+	{
+		b = static_cast<Byte>(rng() % 2 == 0 ? rng() % 4 : rng());
+	}
+	return data;
+}
+
+// floats are compared by their bytes, random payloads are full of NaNs
+static bool SameValue(const ArgValue& a, const ArgValue& b)
+{
+	if (a.index() != b.index())
+		return false;
+
+	return std::visit([&b]<typename T>(const T& value) -> bool
+	{
+		const T& other = std::get<T>(b);
+		if constexpr (std::is_same_v<T, ArgArray>)
+		{
+			return std::ranges::equal(value, other, SameValue);
+		}
+		else if constexpr (std::is_same_v<T, ArgDict>)
+		{
+			return value.size() == other.size() && std::ranges::all_of(value, [&other](const auto& entry)
+			{
+				const auto it = other.find(entry.first);
+				return it != other.end() && SameValue(entry.second, it->second);
+			});
+		}
+		else if constexpr (std::is_same_v<T, ArgString> || std::is_same_v<T, ArgBlob>)
+		{
+			return value == other;
+		}
+		else
+		{
+			return std::memcmp(&value, &other, sizeof(T)) == 0;
+		}
+	}, static_cast<const ValueVariant&>(a));
+}
+
+static bool SameSlots(const PropertySlots& a, const PropertySlots& b)
+{
+	return std::ranges::equal(a, b, [](const std::optional<ArgValue>& x, const std::optional<ArgValue>& y)
+	{
+		return x.has_value() == y.has_value() && (!x || SameValue(*x, *y));
+	});
+}
+
+static void RequireSameEntities(const EntityTable& actual, const EntityTable& expected)
+{
+	REQUIRE(actual.Size() == expected.Size());
+	for (size_t i = 0; i < actual.Size(); i++)
+	{
+		REQUIRE(actual.Id(i) == expected.Id(i));
+		const Entity& a = actual.Entities()[i];
+		const Entity& b = expected.Entities()[i];
+		REQUIRE(a.Type == b.Type);
+		REQUIRE(SameSlots(a.BasePropertiesValues, b.BasePropertiesValues));
+		REQUIRE(SameSlots(a.ClientPropertiesValues, b.ClientPropertiesValues));
+	}
+}
+
 }
 
 class TestRunListener : public Catch::EventListenerBase
@@ -181,6 +300,347 @@ TEST_CASE( "ReplayTest" )
 	}
 }
 
+TEST_CASE( "ReplayViewTest" )
+{
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+
+	for (const std::string_view name : { "20201107_155356_PISC110-Venezia_19_OC_prey.wowsreplay", "20241108_111729_PBSB503-Dreadnought_10_NE_big_race.wowsreplay" })
+	{
+		ReplayResult<Replay> replay = Replay::FromFile(GetReplay(name), gameFilePath);
+		REQUIRE(replay);
+		ReplayResult<ReplayView> view = ReplayView::FromFile(GetReplay(name), gameFilePath);
+		REQUIRE(view);
+		REQUIRE(view->Index().size() == replay->Packets.size());
+
+		ReplayResult<ReplaySummary> expected = replay->Analyze();
+		REQUIRE(expected);
+		ReplayResult<ReplaySummary> actual = view->Analyze();
+		REQUIRE(actual);
+		REQUIRE(actual->Hash == expected->Hash);
+		REQUIRE(actual->Outcome == expected->Outcome);
+		REQUIRE(actual->DamageDealt == expected->DamageDealt);
+		REQUIRE(actual->DamageTaken == expected->DamageTaken);
+		REQUIRE(actual->Ribbons == expected->Ribbons);
+		REQUIRE(actual->Achievements == expected->Achievements);
+	}
+}
+
+TEST_CASE( "ReplayCacheTest" )
+{
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+	const fs::path directory = GetModuleRootPath().value() / "ReplayCacheTest";
+	std::error_code ec;
+	fs::remove_all(directory, ec);
+
+	const std::vector<PacketIndexEntry> index = { { 12, 4, 1, 0.5f }, { 28, 0, 2, 1.0f } };
+	const std::vector<Byte> data(28, Byte{ 7 });
+	const uint64_t entrySize = 24 + index.size() * sizeof(PacketIndexEntry) + data.size();
+
+	{
+		ReplayCache cache(directory, 2 * entrySize + 64);
+		REQUIRE(cache.Store("aa", index, data));
+		REQUIRE(cache.Store("bb", index, data));
+		REQUIRE(cache.Size() == 2 * entrySize);
+
+		CachedReplay loaded;
+		REQUIRE(cache.Load("aa", loaded));
+		REQUIRE(std::ranges::equal(loaded.Data(), data));
+		REQUIRE(loaded.Index().size() == index.size());
+		REQUIRE(loaded.Index()[1].Offset == 28);
+		REQUIRE(loaded.Index()[1].Clock == 1.0f);
+
+		// bb is the least recently used one now
+		REQUIRE(cache.Store("cc", index, data));
+		REQUIRE(cache.Contains("aa"));
+		REQUIRE_FALSE(cache.Contains("bb"));
+		REQUIRE(cache.Contains("cc"));
+		REQUIRE(cache.Size() == 2 * entrySize);
+
+		// keyframes count towards the entry they belong to and only match their interval
+		const std::vector<Byte> keyframes(8, Byte{ 3 });
+		REQUIRE(cache.StoreKeyframes("aa", 30.0f, keyframes));
+		REQUIRE(cache.Size() == 2 * entrySize + 16 + keyframes.size());
+		std::vector<Byte> loadedKeyframes;
+		REQUIRE(cache.LoadKeyframes("aa", 30.0f, loadedKeyframes));
+		REQUIRE(loadedKeyframes == keyframes);
+		REQUIRE_FALSE(cache.LoadKeyframes("aa", 10.0f, loadedKeyframes));
+		REQUIRE_FALSE(cache.LoadKeyframes("cc", 30.0f, loadedKeyframes));
+		REQUIRE(cache.StoreKeyframes("dd", 30.0f, keyframes));
+		REQUIRE_FALSE(fs::exists(directory / "dd.keyframes"));
+
+		REQUIRE_FALSE(cache.Store("../aa", index, data));
+		REQUIRE_FALSE(cache.Load("dd", loaded));
+	}
+
+	{
+		// the entries survive a restart, a broken one is dropped on load
+		ReplayCache cache(directory, 2 * entrySize + 64);
+		REQUIRE(cache.Contains("aa"));
+		REQUIRE(cache.Contains("cc"));
+		std::vector<Byte> loadedKeyframes;
+		REQUIRE(cache.LoadKeyframes("aa", 30.0f, loadedKeyframes));
+		fs::resize_file(directory / "cc.replaycache", entrySize - 1, ec);
+		REQUIRE_FALSE(ec);
+
+		CachedReplay loaded;
+		REQUIRE_FALSE(cache.Load("cc", loaded));
+		REQUIRE_FALSE(cache.Contains("cc"));
+		REQUIRE(cache.Size() == entrySize + 16 + loadedKeyframes.size());
+	}
+
+	{
+		ReplayCache cache(directory, 1024 * 1024 * 1024);
+		const fs::path file = GetReplay("20201107_155356_PISC110-Venezia_19_OC_prey.wowsreplay");
+
+		ReplayResult<ReplayView> decoded = ReplayView::FromFile(file, gameFilePath, &cache);
+		REQUIRE(decoded);
+		ReplayResult<ReplaySummary> expected = decoded->Analyze();
+		REQUIRE(expected);
+		REQUIRE(cache.Contains(expected->Hash));
+
+		ReplayResult<ReplayView> cached = ReplayView::FromFile(file, gameFilePath, &cache);
+		REQUIRE(cached);
+		REQUIRE(cached->Index().size() == decoded->Index().size());
+		ReplayResult<ReplaySummary> actual = cached->Analyze();
+		REQUIRE(actual);
+		REQUIRE(actual->Hash == expected->Hash);
+		REQUIRE(actual->Outcome == expected->Outcome);
+		REQUIRE(actual->DamageDealt == expected->DamageDealt);
+		REQUIRE(actual->Ribbons == expected->Ribbons);
+
+		// the keyframes built by one view are picked up by the next
+		REQUIRE(decoded->BuildKeyframes(60.0f));
+		REQUIRE(fs::exists(directory / (expected->Hash + ".keyframes")));
+		REQUIRE(cached->BuildKeyframes(60.0f));
+		REQUIRE(cached->Keyframes().size() == decoded->Keyframes().size());
+	}
+
+	{
+		// an entry removed while it is still open only stops counting once its file is gone,
+		// which on some systems is only after it was closed
+		const fs::path inUse = directory / "InUse";
+		ReplayCache cache(inUse, 2 * entrySize + 64);
+		REQUIRE(cache.Store("aa", index, data));
+		CachedReplay loaded;
+		REQUIRE(cache.Load("aa", loaded));
+		REQUIRE(cache.Store("bb", index, data));
+		REQUIRE(cache.Store("cc", index, data));
+		REQUIRE_FALSE(cache.Contains("aa"));
+		REQUIRE(std::ranges::equal(loaded.Data(), data));
+		REQUIRE(cache.Size() == DirectorySize(inUse));
+
+		loaded = CachedReplay();
+		REQUIRE(cache.Store("dd", index, data));
+		REQUIRE_FALSE(fs::exists(inUse / "aa.replaycache"));
+		REQUIRE(cache.Size() == DirectorySize(inUse));
+	}
+
+	fs::remove_all(directory, ec);
+}
+
+TEST_CASE( "ReplayKeyframeTest" )
+{
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+	const fs::path file = GetReplay("20241108_111729_PBSB503-Dreadnought_10_NE_big_race.wowsreplay");
+
+	ReplayResult<ReplayView> view = ReplayView::FromFile(file, gameFilePath);
+	REQUIRE(view);
+
+	// building keyframes and seeking go through the entity packets again without reporting them
+	size_t callbacks = 0;
+	view->AddPacketCallback<EntityCreatePacket>([&callbacks](const EntityCreatePacket&) { callbacks++; });
+	view->AddPacketCallback<EntityPropertyPacket>([&callbacks](const EntityPropertyPacket&) { callbacks++; });
+	view->AddPacketCallback<NestedPropertyUpdatePacket>([&callbacks](const NestedPropertyUpdatePacket&) { callbacks++; });
+	view->AddPacketCallback<EntityLeavePacket>([&callbacks](const EntityLeavePacket&) { callbacks++; });
+
+	REQUIRE(view->BuildKeyframes(60.0f));
+	REQUIRE_FALSE(view->Keyframes().empty());
+	REQUIRE(std::ranges::is_sorted(view->Keyframes(), {}, &Keyframe::Clock));
+	REQUIRE(view->SeekTo(300.0f));
+	REQUIRE(callbacks == 0);
+
+	// a visit still reports them
+	REQUIRE(view->Visit(PacketFilter{}, [](const PacketType&) -> ReplayResult<void> { return {}; }));
+	const size_t visited = callbacks;
+	REQUIRE(visited > 0);
+	REQUIRE(view->SeekTo(90.0f));
+	REQUIRE(callbacks == visited);
+
+	// seeking from a keyframe ends up with the same entities as parsing everything up to that point
+	ReplayResult<ReplayView> reference = ReplayView::FromFile(file, gameFilePath);
+	REQUIRE(reference);
+	for (const float clock : { 0.0f, 90.0f, 300.0f, 100000.0f })
+	{
+		REQUIRE(view->SeekTo(clock));
+		REQUIRE(reference->SeekTo(clock));
+		RequireSameEntities(view->Entities(), reference->Entities());
+	}
+
+	const std::vector<Byte> serialized = view->SerializeKeyframes();
+	REQUIRE(reference->LoadKeyframes(serialized));
+	REQUIRE(reference->Keyframes().size() == view->Keyframes().size());
+	for (size_t i = 0; i < view->Keyframes().size(); i++)
+	{
+		REQUIRE(reference->Keyframes()[i].Clock == view->Keyframes()[i].Clock);
+		REQUIRE(reference->Keyframes()[i].Position == view->Keyframes()[i].Position);
+		RequireSameEntities(reference->Keyframes()[i].Entities, view->Keyframes()[i].Entities);
+	}
+
+	REQUIRE_FALSE(reference->LoadKeyframes(std::span{ serialized }.subspan(0, serialized.size() / 2)));
+	REQUIRE(reference->Keyframes().size() == view->Keyframes().size());
+}
+
+TEST_CASE( "ReplayHeaderTest" )
+{
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+
+	for (const std::string_view name : { "20201107_155356_PISC110-Venezia_19_OC_prey.wowsreplay", "20241108_111729_PBSB503-Dreadnought_10_NE_big_race.wowsreplay" })
+	{
+		const ReplayResult<ReplayHeader> header = ReadReplayHeader(GetReplay(name));
+		REQUIRE(header);
+		const ReplayResult<ReplayView> view = ReplayView::FromFile(GetReplay(name), gameFilePath);
+		REQUIRE(view);
+		REQUIRE(header->MetaString == view->MetaString);
+		REQUIRE(header->Meta.ClientVersionFromExe == view->Meta.ClientVersionFromExe);
+
+		const ReplayResult<ReplaySummary> summary = AnalyzeReplay(GetReplay(name), gameFilePath);
+		REQUIRE(summary);
+		REQUIRE(header->Hash == summary->Hash);
+	}
+
+	REQUIRE_FALSE(ReadReplayHeader(GetReplay("does_not_exist.wowsreplay")));
+}
+
+TEST_CASE( "ReplayFilterTest" )
+{
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+	const fs::path file = GetReplay("20241108_111729_PBSB503-Dreadnought_10_NE_big_race.wowsreplay");
+
+	ReplayResult<Replay> replay = Replay::FromFile(file, gameFilePath);
+	REQUIRE(replay);
+	const size_t expected = std::ranges::count_if(replay->Packets, [](const PacketType& packet)
+	{
+		return std::holds_alternative<EntityMethodPacket>(packet) && std::get<EntityMethodPacket>(packet).MethodName == "onRibbon";
+	});
+	REQUIRE(expected > 0);
+
+	ReplayResult<ReplayView> view = ReplayView::FromFile(file, gameFilePath);
+	REQUIRE(view);
+	const PacketFilter filter
+	{
+		.PacketTypes = { PacketBaseType::EntityMethod },
+		.Methods = { "onRibbon" },
+		.Properties = { "teamId" },
+	};
+	size_t count = 0;
+	REQUIRE(view->Visit(filter, [&count](const PacketType& packet) -> ReplayResult<void>
+	{
+		REQUIRE(std::holds_alternative<EntityMethodPacket>(packet));
+		REQUIRE(std::get<EntityMethodPacket>(packet).Method == WellKnownMethod::OnRibbon);
+		count++;
+		return {};
+	}));
+	REQUIRE(count == expected);
+
+	for (const Entity& entity : view->Entities())
+	{
+		const EntitySpec& spec = entity.Spec;
+		REQUIRE(entity.ClientPropertiesValues.size() == spec.ClientProperties.size());
+		for (size_t i = 0; i < entity.ClientPropertiesValues.size(); i++)
+		{
+			if (entity.ClientPropertiesValues[i])
+			{
+				REQUIRE(spec.ClientProperties[i].get().Name == "teamId");
+			}
+		}
+	}
+}
+
+namespace {
+
+struct RibbonCounter
+{
+	static PacketFilter Filter()
+	{
+		return PacketFilter{ .PacketTypes = { PacketBaseType::EntityMethod }, .Methods = { "onRibbon" }, .Properties = {} };
+	}
+
+	size_t Count = 0;
+
+	void operator()(const EntityMethodPacket& packet)
+	{
+		if (packet.Method == WellKnownMethod::OnRibbon)
+			Count++;
+	}
+};
+
+struct PositionCounter
+{
+	size_t Count = 0;
+
+	ReplayResult<void> operator()(const PlayerPositionPacket&)
+	{
+		Count++;
+		return {};
+	}
+};
+
+}  // namespace
+
+TEST_CASE( "ReplayStaticVisitTest" )
+{
+	REQUIRE(PacketFilterFor<PositionCounter>().PacketTypes == std::vector{ PacketBaseType::PlayerPosition });
+	REQUIRE(PacketFilterFor<RibbonCounter>().Methods == std::vector<std::string_view>{ "onRibbon" });
+	// the loop of a visitor only contains its own packet types and the ones keeping the entities up to date
+	STATIC_REQUIRE(VisitsPacket<PositionCounter, PlayerPositionPacket>());
+	STATIC_REQUIRE(VisitsPacket<PositionCounter, EntityCreatePacket>());
+	STATIC_REQUIRE_FALSE(VisitsPacket<PositionCounter, EntityMethodPacket>());
+	STATIC_REQUIRE_FALSE(VisitsPacket<RibbonCounter, UnknownPacket>());
+
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+	const fs::path file = GetReplay("20241108_111729_PBSB503-Dreadnought_10_NE_big_race.wowsreplay");
+
+	const ReplayResult<Replay> replay = Replay::FromFile(file, gameFilePath);
+	REQUIRE(replay);
+
+	RibbonCounter ribbons;
+	REQUIRE(ParseReplay(file, gameFilePath, ribbons));
+	REQUIRE(ribbons.Count == static_cast<size_t>(std::ranges::count_if(replay->Packets, [](const PacketType& packet)
+	{
+		return std::holds_alternative<EntityMethodPacket>(packet) && std::get<EntityMethodPacket>(packet).Method == WellKnownMethod::OnRibbon;
+	})));
+
+	PositionCounter positions;
+	REQUIRE(ParseReplay(file, gameFilePath, positions));
+	REQUIRE(positions.Count == static_cast<size_t>(std::ranges::count_if(replay->Packets, [](const PacketType& packet)
+	{
+		return std::holds_alternative<PlayerPositionPacket>(packet);
+	})));
+}
+
+TEST_CASE( "ReplayArenaTest" )
+{
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+	const fs::path file = GetReplay("20201107_155356_PISC110-Venezia_19_OC_prey.wowsreplay");
+
+	const ReplayResult<Replay> replay = Replay::FromFile(file, gameFilePath);
+	REQUIRE(replay);
+	const ReplayArena& arena = replay->Arena();
+	WARN("arena served " << arena.Allocations() << " allocations with " << arena.HeapAllocations() << " heap allocations (" << arena.HeapBytes() << " bytes)");
+	REQUIRE(arena.Allocations() > 0);
+	REQUIRE(arena.HeapAllocations() * 100 < arena.Allocations());
+
+	// every visit starts over on a released arena, so the results must not change
+	ReplayResult<ReplayView> view = ReplayView::FromFile(file, gameFilePath);
+	REQUIRE(view);
+	const ReplayResult<ReplaySummary> first = view->Analyze();
+	REQUIRE(first);
+	const ReplayResult<ReplaySummary> second = view->Analyze();
+	REQUIRE(second);
+	REQUIRE(first->DamageDealt == second->DamageDealt);
+	REQUIRE(first->Ribbons == second->Ribbons);
+}
+
 TEST_CASE( "ReplayGameFileTest" )
 {
 	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
@@ -200,3 +660,302 @@ TEST_CASE( "ReplayGameFileTest" )
 	REQUIRE(spec->at(0).BaseProperties.size() == 1);
 	REQUIRE(spec->at(0).Name == "Avatar");
 }
+
+TEST_CASE( "ReplaySpecCacheTest" )
+{
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+
+	const ReplayResult<EntitySpecs> first = GetEntitySpecs(Version(0, 10, 8, 0), gameFilePath, false);
+	REQUIRE(first);
+	const ReplayResult<EntitySpecs> second = GetEntitySpecs(Version(0, 10, 8, 0), gameFilePath, false);
+	REQUIRE(second);
+	REQUIRE(first->get() == second->get());
+
+	const std::vector<Byte> serialized = SerializeSpecs(**first);
+	const ReplayResult<std::vector<EntitySpec>> specs = DeserializeSpecs(serialized);
+	REQUIRE(specs);
+	REQUIRE(specs->size() == (*first)->size());
+	for (size_t i = 0; i < specs->size(); i++)
+	{
+		const EntitySpec& a = specs->at(i);
+		const EntitySpec& b = (*first)->at(i);
+		REQUIRE(a.Name == b.Name);
+		REQUIRE(a.ClientMethods.size() == b.ClientMethods.size());
+		REQUIRE(a.AllProperties.size() == b.AllProperties.size());
+		REQUIRE(a.ClientProperties.size() == b.ClientProperties.size());
+		for (size_t j = 0; j < a.ClientProperties.size(); j++)
+		{
+			REQUIRE(a.ClientProperties[j].get().Name == b.ClientProperties[j].get().Name);
+			REQUIRE(TypeSize(a.ClientProperties[j].get().Type) == TypeSize(b.ClientProperties[j].get().Type));
+		}
+		for (size_t j = 0; j < a.ClientMethods.size(); j++)
+		{
+			REQUIRE(a.ClientMethods[j].Name == b.ClientMethods[j].Name);
+			REQUIRE(a.ClientMethods[j].SortSize() == b.ClientMethods[j].SortSize());
+			REQUIRE(a.ClientMethods[j].Program.Values == a.ClientMethods[j].Args.size());
+			REQUIRE(a.ClientMethods[j].Program.Code.size() == b.ClientMethods[j].Program.Code.size());
+			REQUIRE(a.ClientMethods[j].NameId == b.ClientMethods[j].NameId);
+			REQUIRE(a.ClientMethods[j].Known == b.ClientMethods[j].Known);
+		}
+	}
+
+	REQUIRE_FALSE(DeserializeSpecs(std::span{ serialized }.subspan(0, serialized.size() / 2)));
+}
+
+TEST_CASE( "ReplayNameInternTest" )
+{
+	const TypeNameId ribbon = InternName("onRibbon");
+	REQUIRE(ribbon != 0);
+	REQUIRE(InternName(std::string("onRibbon")) == ribbon);
+	REQUIRE(InternName("onBattleEnd") != ribbon);
+	REQUIRE(InternedName(ribbon) == "onRibbon");
+	REQUIRE(InternedName(0).empty());
+
+	REQUIRE(ResolveWellKnownMethod("onRibbon") == WellKnownMethod::OnRibbon);
+	REQUIRE(ResolveWellKnownMethod("receiveDamageStat") == WellKnownMethod::ReceiveDamageStat);
+	REQUIRE(ResolveWellKnownMethod("onChatMessage") == WellKnownMethod::Unknown);
+}
+
+TEST_CASE( "ReplayDecodeProgramTest" )
+{
+	const auto primitive = [](BasicType type)
+	{
+		return std::make_shared<ArgType>(PrimitiveType{ type });
+	};
+	const std::vector<ArgType> args
+	{
+		PrimitiveType{ BasicType::Int32 },
+		PrimitiveType{ BasicType::Float32 },
+		ArrayType{ std::make_shared<ArgType>(FixedDictType{ false, { { "vehicleID", primitive(BasicType::Int32) }, { "damage", primitive(BasicType::Float32) } } }), std::nullopt },
+		UserType{ primitive(BasicType::String), true },
+		PrimitiveType{ BasicType::Uint8 },
+	};
+
+	const DecodeProgram program = CompileDecodeProgram(args);
+	REQUIRE(program.Values == 5);
+	// the leading int and float end up in one block
+	REQUIRE(program.Code[0].Op == DecodeOp::Fixed);
+	REQUIRE(program.Code[0].Count == 2);
+	REQUIRE(program.Code[0].Size == 8);
+
+	std::vector<Byte> data;
+	const auto append = [&data](const auto& value)
+	{
+		const Byte* bytes = reinterpret_cast<const Byte*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(value));
+	};
+	append(int32_t{ 42 });
+	append(1.5f);
+	append(uint8_t{ 2 });
+	append(int32_t{ 7 });
+	append(10.0f);
+	append(int32_t{ 8 });
+	append(20.0f);
+	append(uint8_t{ 0 });
+	append(uint8_t{ 3 });
+	data.insert(data.end(), { 'a', 'b', 'c' });
+	append(uint8_t{ 9 });
+
+	std::span<const Byte> expectedData = data;
+	ArgArray expected;
+	for (const ArgType& arg : args)
+	{
+		ReplayResult<ArgValue> value = ParseValue(expectedData, arg);
+		REQUIRE(value);
+		expected.emplace_back(std::move(*value));
+	}
+
+	std::span<const Byte> actualData = data;
+	ArgArray actual;
+	REQUIRE(DecodeValues(program, actualData, actual));
+	REQUIRE(actualData.empty());
+	REQUIRE(expectedData.empty());
+	REQUIRE(actual.size() == expected.size());
+	REQUIRE(std::get<int32_t>(actual[0]) == 42);
+	REQUIRE(std::get<float>(actual[1]) == 1.5f);
+	const ArgArray& damages = std::get<ArgArray>(actual[2]);
+	REQUIRE(damages.size() == 2);
+	REQUIRE(std::get<int32_t>(std::get<ArgDict>(damages[1]).at("vehicleID")) == 8);
+	REQUIRE(std::get<float>(std::get<ArgDict>(damages[1]).at("damage")) == 20.0f);
+	REQUIRE(std::get<ArgString>(actual[3]) == std::get<ArgString>(expected[3]));
+	REQUIRE(std::get<uint8_t>(actual[4]) == 9);
+
+	std::span<const Byte> skipped = data;
+	REQUIRE(SkipValues(program, skipped));
+	REQUIRE(skipped.empty());
+
+	std::span<const Byte> truncated = std::span{ data }.subspan(0, 6);
+	ArgArray values;
+	REQUIRE_FALSE(DecodeValues(program, truncated, values));
+}
+
+TEST_CASE( "ReplayDecodeProgramDifferentialTest" )
+{
+	// seeded, so a failure can be reproduced
+	std::mt19937 rng(0x5EED);
+	size_t decoded = 0;
+
+	for (size_t i = 0; i < 5000; i++)
+	{
+		std::vector<ArgType> types(1 + rng() % 3);
+		for (ArgType& type : types)
+		{
+			type = RandomType(rng, 3);
+		}
+		const std::vector<Byte> data = RandomPayload(rng);
+		const DecodeProgram program = CompileDecodeProgram(types);
+
+		std::span<const Byte> expectedData = data;
+		ArgArray expected;
+		bool expectedOk = true;
+		for (const ArgType& type : types)
+		{
+			ReplayResult<ArgValue> value = ParseValue(expectedData, type);
+			if (!value)
+			{
+				expectedOk = false;
+				break;
+			}
+			expected.emplace_back(std::move(*value));
+		}
+
+		std::span<const Byte> actualData = data;
+		ArgArray actual;
+		const bool actualOk = DecodeValues(program, actualData, actual).has_value();
+		INFO("case " << i);
+		REQUIRE(actualOk == expectedOk);
+
+		std::span<const Byte> expectedSkip = data;
+		bool expectedSkipOk = true;
+		for (const ArgType& type : types)
+		{
+			if (!SkipValue(expectedSkip, type))
+			{
+				expectedSkipOk = false;
+				break;
+			}
+		}
+		std::span<const Byte> actualSkip = data;
+		REQUIRE(SkipValues(program, actualSkip).has_value() == expectedSkipOk);
+
+		if (expectedOk)
+		{
+			REQUIRE(actualData.size() == expectedData.size());
+			REQUIRE(std::ranges::equal(actual, expected, SameValue));
+			decoded++;
+		}
+		if (expectedSkipOk)
+		{
+			REQUIRE(actualSkip.size() == expectedSkip.size());
+		}
+	}
+
+	// the payloads have to decode often enough for the comparison to mean anything
+	REQUIRE(decoded > 500);
+}
+
+TEST_CASE( "ReplayEntityTableTest" )
+{
+	const EntitySpec spec{ "Avatar" };
+	const auto makeEntity = [&spec](uint16_t type)
+	{
+		return Entity{ type, spec, {}, {} };
+	};
+
+	EntityTable entities;
+	entities.InsertOrAssign(30, makeEntity(1));
+	entities.InsertOrAssign(10, makeEntity(2));
+	entities.TryEmplace(20, makeEntity(3));
+	REQUIRE(entities.Size() == 3);
+
+	// entities stay in creation order while lookups go through the id
+	REQUIRE(entities.Id(0) == 30);
+	REQUIRE(entities.Id(1) == 10);
+	REQUIRE(entities.Find(10)->Type == 2);
+	REQUIRE(entities.Find(20)->Type == 3);
+	REQUIRE(entities.Find(15) == nullptr);
+	REQUIRE_FALSE(entities.Contains(40));
+
+	REQUIRE(entities.TryEmplace(10, makeEntity(4)).Type == 2);
+	REQUIRE(entities.InsertOrAssign(10, makeEntity(5)).Type == 5);
+	REQUIRE(entities.Size() == 3);
+
+	entities.Clear();
+	REQUIRE(entities.Size() == 0);
+	REQUIRE(entities.Find(30) == nullptr);
+}
+
+TEST_CASE( "ReplayPacketDispatchTest" )
+{
+	for (const Version version : { Version(0, 10, 8), Version(12, 5, 0), Version(12, 6, 0), Version(13, 0, 0) })
+	{
+		const PacketDispatchTable dispatch(version);
+		REQUIRE(dispatch.GameVersion() == version);
+		for (uint32_t id = 0; id < PacketDispatchTable::Size; id++)
+		{
+			const std::optional<PacketBaseType> type = GetPacketBaseType(id, version);
+			const PacketDispatchTable::Entry* entry = dispatch.Find(id);
+			REQUIRE(type.has_value() == (entry != nullptr));
+			if (entry)
+			{
+				REQUIRE(entry->Type == *type);
+			}
+		}
+	}
+
+	REQUIRE(PacketDispatchTable(Version(12, 5, 0)).Find(0x22)->Type == PacketBaseType::NestedPropertyUpdate);
+	REQUIRE(PacketDispatchTable(Version(12, 6, 0)).Find(0x23)->Type == PacketBaseType::NestedPropertyUpdate);
+	REQUIRE(PacketDispatchTable(Version(12, 6, 0)).Find(0xFFFFFFFF) == nullptr);
+}
+
+TEST_CASE( "ReplayTrajectoryTest" )
+{
+	TrajectoryStore store(0.5f);
+	// a straight line and then a turn, only the corners are kept
+	for (int i = 0; i <= 10; i++)
+	{
+		store.Add(1, static_cast<float>(i), Vec3{ static_cast<float>(i) * 10.0f, 0.0f, 0.0f }, 0.0f);
+	}
+	for (int i = 1; i <= 10; i++)
+	{
+		store.Add(1, static_cast<float>(10 + i), Vec3{ 100.0f, 0.0f, static_cast<float>(i) * 10.0f }, 1.5f);
+	}
+	store.Add(2, 3.0f, Vec3{ 1.0f, 2.0f, 3.0f }, -0.25f);
+
+	const Trajectory* track = store.Find(1);
+	REQUIRE(track);
+	REQUIRE(track->Size() == 3);
+	REQUIRE(track->Clock == std::vector<float>{ 0.0f, 10.0f, 20.0f });
+	REQUIRE(track->X == std::vector<float>{ 0.0f, 100.0f, 100.0f });
+	REQUIRE(track->Z == std::vector<float>{ 0.0f, 0.0f, 100.0f });
+	REQUIRE(store.Find(3) == nullptr);
+
+	TrajectoryStore full;
+	for (int i = 0; i <= 10; i++)
+	{
+		full.Add(1, static_cast<float>(i), Vec3{ static_cast<float>(i) * 10.0f, 0.0f, 0.0f }, 0.0f);
+	}
+	REQUIRE(full.Find(1)->Size() == 11);
+
+	const std::vector<Byte> serialized = store.Serialize();
+	const ReplayResult<TrajectoryStore> loaded = TrajectoryStore::Deserialize(serialized);
+	REQUIRE(loaded);
+	REQUIRE(loaded->Trajectories().size() == 2);
+	REQUIRE(loaded->Find(1)->X == track->X);
+	REQUIRE(loaded->Find(2)->Yaw == std::vector<float>{ -0.25f });
+	REQUIRE(loaded->Serialize() == serialized);
+	REQUIRE_FALSE(TrajectoryStore::Deserialize(std::span{ serialized }.subspan(0, serialized.size() - 1)));
+
+	const fs::path gameFilePath = GetModuleRootPath().value() / "ReplayVersions";
+	const fs::path file = GetReplay("20241108_111729_PBSB503-Dreadnought_10_NE_big_race.wowsreplay");
+	const ReplayResult<Replay> replay = Replay::FromFile(file, gameFilePath);
+	REQUIRE(replay);
+	ReplayResult<ReplayView> view = ReplayView::FromFile(file, gameFilePath);
+	REQUIRE(view);
+
+	const TrajectoryStore expected = CollectTrajectories(replay->Packets);
+	const ReplayResult<TrajectoryStore> actual = CollectTrajectories(*view);
+	REQUIRE(actual);
+	REQUIRE_FALSE(expected.Trajectories().empty());
+	REQUIRE(actual->Serialize() == expected.Serialize());
+}